@@ -20,20 +20,22 @@
 #include "string_utils.hxx"
 
 #include <algorithm>
+#include <future>
 #include <iostream>
-#include <sstream>
+#include <limits>
+#include <numeric>
+#include <thread>
 #include <unordered_map>
 
-#include <clocale>
+#include <cstdlib>
+#include <cstring>
 
-#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) ||               \
-                         (defined(__APPLE__) && defined(__MACH__)))
-#include <unistd.h>
-#endif
-
-#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/range/adaptors.hpp>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 /*
  * Aff_Data class and the method parse() should be structured in the following
  * way. The data members of the class should be data structures that are
@@ -97,25 +99,198 @@ struct Compound_Check_Pattern {
 	char16_t second_word_flag;
 };
 
-auto Word_List::equal_range(const std::wstring& word) const
-    -> std::pair<Word_List_Base::local_const_iterator,
-                 Word_List_Base::local_const_iterator>
+/**
+ * @brief Parses a decimal number at the front of @p s, like strtoul().
+ *
+ * Unlike strtoul() it does not need a null terminated string and it does not
+ * depend on the C locale.
+ *
+ * @param[in,out] s the parsed characters are removed from its front.
+ * @param[out] x the value, the max of unsigned long on overflow.
+ * @return false if there are no digits, @p s is left unchanged then.
+ */
+auto parse_decimal(string_view& s, unsigned long& x) -> bool
 {
-	// auto static thread_local u8buf = string();
-	auto u8buf = boost::container::small_vector<char, 64>();
-	wide_to_utf8(word, u8buf);
-	return equal_range(string_view(u8buf.data(), u8buf.size()));
+	auto constexpr max = numeric_limits<unsigned long>::max();
+	auto i = size_t(0);
+	auto negative = false;
+	x = 0;
+	if (i != s.size() && (s[i] == '+' || s[i] == '-'))
+		negative = s[i++] == '-';
+	auto digits_begin = i;
+	auto overflow = false;
+	for (; i != s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+		auto d = static_cast<unsigned long>(s[i] - '0');
+		if (x > (max - d) / 10)
+			overflow = true;
+		else
+			x = x * 10 + d;
+	}
+	if (i == digits_begin) {
+		x = 0;
+		return false;
+	}
+	s.remove_prefix(i);
+	if (overflow)
+		x = max;
+	else if (negative)
+		x = -x;
+	return true;
 }
 
-void reset_failbit_istream(std::istream& in)
+/**
+ * @brief Splits a line of the affix or the dictionary file into tokens.
+ *
+ * It works directly on the line, without copying it into a string stream.
+ * The extractions behave like the ones of std::istream imbued with the
+ * classic locale, including the fail and the eof state, so the parsers
+ * written for streams keep reporting exactly the same errors.
+ */
+class Line_Tokenizer {
+	string_view line;
+	size_t i = 0;
+	bool failed = false;
+	bool at_eof = false;
+
+	auto static is_space(char c) -> bool
+	{
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	// Like istream::sentry, skips white space and checks the state.
+	auto begin_extraction() -> bool
+	{
+		skip_ws();
+		if (at_eof)
+			failed = true;
+		return !failed;
+	}
+
+	template <class T>
+	auto extract_unsigned(T& x) -> Line_Tokenizer&
+	{
+		if (!begin_extraction())
+			return *this;
+		auto constexpr max = numeric_limits<T>::max();
+		auto negative = false;
+		if (line[i] == '+' || line[i] == '-')
+			negative = line[i++] == '-';
+		auto digits_begin = i;
+		auto overflow = false;
+		x = 0;
+		for (; i != line.size() && line[i] >= '0' && line[i] <= '9';
+		     ++i) {
+			auto d = static_cast<T>(line[i] - '0');
+			if (x > (max - d) / 10)
+				overflow = true;
+			else
+				x = x * 10 + d;
+		}
+		at_eof = i == line.size();
+		if (i == digits_begin) {
+			failed = true;
+		}
+		else if (overflow) {
+			x = max;
+			failed = true;
+		}
+		else if (negative) {
+			x = -x;
+		}
+		return *this;
+	}
+
+      public:
+	Line_Tokenizer(string_view line) : line(line) {}
+	auto fail() const { return failed; }
+	auto eof() const { return at_eof; }
+	auto good() const { return !failed && !at_eof; }
+	explicit operator bool() const { return !failed; }
+	auto set_fail() -> void { failed = true; }
+	auto clear_fail() -> void { failed = false; }
+
+	/**
+	 * @brief Skips white space, same as the manipulator std::ws.
+	 */
+	auto skip_ws() -> Line_Tokenizer&
+	{
+		if (failed || at_eof) {
+			failed = true;
+			return *this;
+		}
+		while (i != line.size() && is_space(line[i]))
+			++i;
+		if (i == line.size())
+			at_eof = true;
+		return *this;
+	}
+
+	/**
+	 * @brief Returns the next character, or -1 at the end of the line.
+	 */
+	auto peek() const -> int
+	{
+		if (i == line.size())
+			return -1;
+		return static_cast<unsigned char>(line[i]);
+	}
+
+	/**
+	 * @brief Extracts a token without copying it.
+	 *
+	 * On failure @p token is left unchanged. The view points into the
+	 * line.
+	 */
+	auto operator>>(string_view& token) -> Line_Tokenizer&
+	{
+		if (!begin_extraction())
+			return *this;
+		auto j = i;
+		while (j != line.size() && !is_space(line[j]))
+			++j;
+		token = line.substr(i, j - i);
+		i = j;
+		at_eof = i == line.size();
+		return *this;
+	}
+	auto operator>>(string& token) -> Line_Tokenizer&
+	{
+		auto t = string_view();
+		*this >> t;
+		if (!failed)
+			token.assign(t.data(), t.size());
+		return *this;
+	}
+	auto operator>>(char& c) -> Line_Tokenizer&
+	{
+		if (begin_extraction())
+			c = line[i++];
+		return *this;
+	}
+	auto operator>>(unsigned short& x) -> Line_Tokenizer&
+	{
+		return extract_unsigned(x);
+	}
+	auto operator>>(size_t& x) -> Line_Tokenizer&
+	{
+		return extract_unsigned(x);
+	}
+};
+
+/**
+ * @brief Converts ASCII letters to uppercase, leaves all other bytes as is.
+ */
+auto to_upper_ascii(string& s) -> void
 {
-	in.clear(in.rdstate() & ~in.failbit);
+	for (auto& c : s)
+		if (c >= 'a' && c <= 'z')
+			c -= 'a' - 'A';
 }
 
 /**
- * Parses vector of class T from an input stream.
+ * Parses vector of class T from a line of the affix file.
  *
- * @param in input stream to decode from.
+ * @param in tokenizer of the line to decode from.
  * @param line_num
  * @param command
  * @param[in,out] counts
@@ -123,7 +298,8 @@ void reset_failbit_istream(std::istream& in)
  * @param parseLineFunc
  */
 template <class T, class Func>
-auto parse_vector_of_T(istream& in, size_t line_num, const string& command,
+auto parse_vector_of_T(Line_Tokenizer& in, size_t line_num,
+                       const string& command,
                        unordered_map<string, int>& counts, vector<T>& vec,
                        Func parseLineFunc) -> void
 {
@@ -172,7 +348,24 @@ enum class Flag_Parsing_Error {
 	COMPOUND_RULE_INVALID_FORMAT
 };
 
-auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
+/**
+ * @brief Parses one numeric flag at the front of @p s.
+ *
+ * @param[in,out] s the parsed characters are removed from its front.
+ * @param[out] out the flag is appended here.
+ */
+auto decode_numeric_flag(string_view& s, u16string& out) -> Flag_Parsing_Error
+{
+	auto flag = 0ul;
+	if (!parse_decimal(s, flag))
+		return Flag_Parsing_Error::INVALID_NUMERIC_FLAG;
+	if (flag > 0xFFFF)
+		return Flag_Parsing_Error::FLAG_ABOVE_65535;
+	out.push_back(flag);
+	return {};
+}
+
+auto decode_flags(string_view s, Flag_Type t, const Encoding& enc,
                   u16string& out) -> Flag_Parsing_Error
 {
 	using Err = Flag_Parsing_Error;
@@ -211,33 +404,14 @@ auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
 		break;
 	}
 	case Ft::NUMBER: {
-		auto p = s.c_str();
-		char* p2 = nullptr;
-		errno = 0;
-		auto flag = strtoul(p, &p2, 10);
-		if (p2 == p)
-			return Err::INVALID_NUMERIC_FLAG;
-		if (flag == numeric_limits<decltype(flag)>::max() &&
-		    errno == ERANGE) {
-			errno = 0;
-			return Err::FLAG_ABOVE_65535;
-		}
-		if (flag > 0xFFFF)
-			return Err::FLAG_ABOVE_65535;
-		out.push_back(flag);
-		while (p2 != &s[s.size()] && *p2 == ',') {
-			p = p2 + 1;
-			flag = strtoul(p, &p2, 10);
-			if (p2 == p)
-				return Err::INVALID_NUMERIC_FLAG;
-			if (flag == numeric_limits<decltype(flag)>::max() &&
-			    errno == ERANGE) {
-				errno = 0;
-				return Err::FLAG_ABOVE_65535;
-			}
-			if (flag > 0xFFFF)
-				return Err::FLAG_ABOVE_65535;
-			out.push_back(flag);
+		auto err = decode_numeric_flag(s, out);
+		if (err != Err::NO_ERROR)
+			return err;
+		while (!s.empty() && s[0] == ',') {
+			s.remove_prefix(1);
+			err = decode_numeric_flag(s, out);
+			if (err != Err::NO_ERROR)
+				return err;
 		}
 		break;
 	}
@@ -261,7 +435,7 @@ auto decode_flags(const string& s, Flag_Type t, const Encoding& enc,
 	return warn;
 }
 
-auto decode_flags_possible_alias(const string& s, Flag_Type t,
+auto decode_flags_possible_alias(string_view s, Flag_Type t,
                                  const Encoding& enc,
                                  const vector<Flag_Set>& flag_aliases,
                                  u16string& out) -> Flag_Parsing_Error
@@ -269,14 +443,9 @@ auto decode_flags_possible_alias(const string& s, Flag_Type t,
 	if (flag_aliases.empty())
 		return decode_flags(s, t, enc, out);
 
-	char* p;
-	errno = 0;
 	out.clear();
-	auto i = strtoul(s.c_str(), &p, 10);
-	if (p == s.c_str())
-		return Flag_Parsing_Error::INVALID_NUMERIC_ALIAS;
-
-	if (i == numeric_limits<decltype(i)>::max() && errno == ERANGE)
+	auto i = 0ul;
+	if (!parse_decimal(s, i))
 		return Flag_Parsing_Error::INVALID_NUMERIC_ALIAS;
 
 	if (0 < i && i <= flag_aliases.size()) {
@@ -341,46 +510,32 @@ auto report_flag_parsing_error(Flag_Parsing_Error err, size_t line_num)
 /**
  * Decodes flags.
  *
- * Expects that there are flags in the stream.
- * If there are no flags in the stream (eg, stream is at eof)
- * or if the format of the flags is incorrect the stream failbit will be set.
+ * Expects that there are flags in the line.
+ * If there are no flags in the line (eg, tokenizer is at eof)
+ * or if the format of the flags is incorrect the fail state will be set.
  */
-auto decode_flags(istream& in, size_t line_num, Flag_Type t,
-                  const Encoding& enc, u16string& out) -> istream&
+auto decode_flags(Line_Tokenizer& in, size_t line_num, Flag_Type t,
+                  const Encoding& enc, u16string& out) -> Line_Tokenizer&
 {
-	string s;
+	auto s = string_view();
 	in >> s;
 	auto err = decode_flags(s, t, enc, out);
 	if (static_cast<int>(err) > 0)
-		in.setstate(in.failbit);
-	report_flag_parsing_error(err, line_num);
-	return in;
-}
-
-auto decode_flags_possible_alias(istream& in, size_t line_num, Flag_Type t,
-                                 const Encoding& enc,
-                                 const vector<Flag_Set>& flag_aliases,
-                                 u16string& out) -> istream&
-{
-	string s;
-	in >> s;
-	auto err = decode_flags_possible_alias(s, t, enc, flag_aliases, out);
-	if (static_cast<int>(err) > 0)
-		in.setstate(in.failbit);
+		in.set_fail();
 	report_flag_parsing_error(err, line_num);
 	return in;
 }
 
 /**
- * Decodes a single flag from an input stream.
+ * Decodes a single flag from a line.
  *
- * @param in input stream to decode from.
+ * @param in tokenizer of the line to decode from.
  * @param line_num
  * @param t
- * @param enc encoding of the stream.
+ * @param enc encoding of the line.
  * @return The value of the first decoded flag or 0 when no flag was decoded.
  */
-auto decode_single_flag(istream& in, size_t line_num, Flag_Type t,
+auto decode_single_flag(Line_Tokenizer& in, size_t line_num, Flag_Type t,
                         const Encoding& enc) -> char16_t
 {
 	auto flags = u16string();
@@ -391,45 +546,48 @@ auto decode_single_flag(istream& in, size_t line_num, Flag_Type t,
 	return 0;
 }
 
-auto parse_word_slash_flags(istream& in, size_t line_num, Flag_Type t,
+auto parse_word_slash_flags(Line_Tokenizer& in, size_t line_num, Flag_Type t,
                             const Encoding& enc,
                             const vector<Flag_Set>& flag_aliases, string& word,
-                            u16string& flags) -> istream&
+                            u16string& flags) -> Line_Tokenizer&
 {
-	in >> word;
-	auto slash_pos = word.find('/');
-	if (slash_pos == word.npos) {
+	auto token = string_view();
+	in >> token;
+	auto slash_pos = token.find('/');
+	word.assign(token.data(), min(slash_pos, token.size()));
+	if (slash_pos == token.npos) {
 		flags.clear();
 		return in;
 	}
 
-	auto flag_str = word.substr(slash_pos + 1);
-	word.erase(slash_pos);
+	auto flag_str = token.substr(slash_pos + 1);
 	auto err =
 	    decode_flags_possible_alias(flag_str, t, enc, flag_aliases, flags);
 	if (static_cast<int>(err) > 0)
-		in.setstate(in.failbit);
+		in.set_fail();
 	report_flag_parsing_error(err, line_num);
 	return in;
 }
 
-auto parse_word_slash_single_flag(istream& in, size_t line_num, Flag_Type t,
-                                  const Encoding& enc, string& word,
-                                  char16_t& flag) -> istream&
+auto parse_word_slash_single_flag(Line_Tokenizer& in, size_t line_num,
+                                  Flag_Type t, const Encoding& enc,
+                                  string& word, char16_t& flag)
+    -> Line_Tokenizer&
 {
-	in >> word;
-	auto slash_pos = word.find('/');
-	if (slash_pos == word.npos) {
+	auto token = string_view();
+	in >> token;
+	auto slash_pos = token.find('/');
+	word.assign(token.data(), min(slash_pos, token.size()));
+	if (slash_pos == token.npos) {
 		flag = 0;
 		return in;
 	}
 
 	auto flags = u16string();
-	auto flag_str = word.substr(slash_pos + 1);
-	word.erase(slash_pos);
+	auto flag_str = token.substr(slash_pos + 1);
 	auto err = decode_flags(flag_str, t, enc, flags);
 	if (static_cast<int>(err) > 0)
-		in.setstate(in.failbit);
+		in.set_fail();
 	report_flag_parsing_error(err, line_num);
 	if (flags.empty())
 		flag = 0;
@@ -441,10 +599,11 @@ auto parse_word_slash_single_flag(istream& in, size_t line_num, Flag_Type t,
 /**
  * Parses morhological fields.
  *
- * @param in input stream to parse from.
+ * @param in tokenizer of the line to parse from.
  * @param[in,out] vecOut
  */
-auto parse_morhological_fields(istream& in, vector<string>& vecOut) -> void
+auto parse_morhological_fields(Line_Tokenizer& in, vector<string>& vecOut)
+    -> void
 {
 	if (!in.good()) {
 		return;
@@ -454,13 +613,13 @@ auto parse_morhological_fields(istream& in, vector<string>& vecOut) -> void
 	while (in >> morph) {
 		vecOut.push_back(morph);
 	}
-	reset_failbit_istream(in);
+	in.clear_fail();
 }
 
 /**
- * Parses an affix from an input stream.
+ * Parses an affix from a line of the affix file.
  *
- * @param in input stream to parse from.
+ * @param in tokenizer of the line to parse from.
  * @param line_num
  * @param[in,out] command
  * @param t
@@ -469,9 +628,9 @@ auto parse_morhological_fields(istream& in, vector<string>& vecOut) -> void
  * @param[in,out] vec
  * @param[in,out] cmd_affix
  */
-auto parse_affix(istream& in, size_t line_num, string& command, Flag_Type t,
-                 const Encoding& enc, const vector<Flag_Set>& flag_aliases,
-                 vector<Affix>& vec,
+auto parse_affix(Line_Tokenizer& in, size_t line_num, string& command,
+                 Flag_Type t, const Encoding& enc,
+                 const vector<Flag_Set>& flag_aliases, vector<Affix>& vec,
                  unordered_map<string, pair<bool, int>>& cmd_affix) -> void
 {
 	char16_t f = decode_single_flag(in, line_num, t, enc);
@@ -488,7 +647,7 @@ auto parse_affix(istream& in, size_t line_num, string& command, Flag_Type t,
 	// to be used once with cross product and again witohut
 	// one flag is tied to one cross product value
 	if (dat == cmd_affix.end()) {
-		char cross_char; // 'Y' or 'N'
+		char cross_char = 0; // 'Y' or 'N'
 		size_t cnt;
 		in >> cross_char >> cnt;
 		bool cross = cross_char == 'Y';
@@ -521,7 +680,7 @@ auto parse_affix(istream& in, size_t line_num, string& command, Flag_Type t,
 		if (elem.condition.empty())
 			elem.condition = '.';
 		if (in.fail())
-			reset_failbit_istream(in);
+			in.clear_fail();
 		else
 			parse_morhological_fields(in,
 			                          elem.morphological_fields);
@@ -537,17 +696,18 @@ auto parse_affix(istream& in, size_t line_num, string& command, Flag_Type t,
 /**
  * Parses flag type.
  *
- * @param in input stream to parse from.
+ * @param in tokenizer of the line to parse from.
  * @param line_num
  * @param[out] flag_type
  */
-auto parse_flag_type(istream& in, size_t line_num, Flag_Type& flag_type) -> void
+auto parse_flag_type(Line_Tokenizer& in, size_t line_num, Flag_Type& flag_type)
+    -> void
 {
 	using Ft = Flag_Type;
 	(void)line_num;
 	string p;
 	in >> p;
-	boost::algorithm::to_upper(p, in.getloc());
+	to_upper_ascii(p);
 	if (p == "LONG")
 		flag_type = Ft::DOUBLE_CHAR;
 	else if (p == "NUM")
@@ -558,7 +718,7 @@ auto parse_flag_type(istream& in, size_t line_num, Flag_Type& flag_type) -> void
 		cerr << "Nuspell error: unknown FLAG type" << endl;
 }
 
-auto parse_compound_rule(const string& s, Flag_Type t, const Encoding& enc,
+auto parse_compound_rule(string_view s, Flag_Type t, const Encoding& enc,
                          u16string& out) -> Flag_Parsing_Error
 {
 	using Ft = Flag_Type;
@@ -593,31 +753,19 @@ auto parse_compound_rule(const string& s, Flag_Type t, const Encoding& enc,
 		out.clear();
 		if (s.empty())
 			return Err::MISSING_FLAGS;
-		errno = 0;
-		for (auto p = s.c_str(); *p != 0;) {
-			if (*p != '(')
+		while (!s.empty()) {
+			if (s[0] != '(')
 				return Err::COMPOUND_RULE_INVALID_FORMAT;
-			++p;
-			char* p2;
-			auto flag = strtoul(p, &p2, 10);
-			flag = strtoul(p, &p2, 10);
-			if (p2 == p)
-				return Err::INVALID_NUMERIC_FLAG;
-			if (flag == numeric_limits<decltype(flag)>::max() &&
-			    errno == ERANGE) {
-				errno = 0;
-				return Err::FLAG_ABOVE_65535;
-			}
-			if (flag > 0xFFFF)
-				return Err::FLAG_ABOVE_65535;
-			p = p2;
-			if (*p != ')')
+			s.remove_prefix(1);
+			auto err = decode_numeric_flag(s, out);
+			if (err != Err::NO_ERROR)
+				return err;
+			if (s.empty() || s[0] != ')')
 				return Err::COMPOUND_RULE_INVALID_FORMAT;
-			out.push_back(flag);
-			++p;
-			if (*p == '?' || *p == '*') {
-				out.push_back(*p);
-				++p;
+			s.remove_prefix(1);
+			if (!s.empty() && (s[0] == '?' || s[0] == '*')) {
+				out.push_back(s[0]);
+				s.remove_prefix(1);
 			}
 		}
 		break;
@@ -625,82 +773,692 @@ auto parse_compound_rule(const string& s, Flag_Type t, const Encoding& enc,
 	return {};
 }
 
-auto parse_compound_rule(istream& in, size_t line_num, Flag_Type t,
-                         const Encoding& enc, u16string& out) -> istream&
+auto parse_compound_rule(Line_Tokenizer& in, size_t line_num, Flag_Type t,
+                         const Encoding& enc, u16string& out)
+    -> Line_Tokenizer&
 {
-	string s;
+	auto s = string_view();
 	in >> s;
 	auto err = parse_compound_rule(s, t, enc, out);
 	if (static_cast<int>(err) > 0)
-		in.setstate(in.failbit);
+		in.set_fail();
 	report_flag_parsing_error(err, line_num);
 	return in;
 }
 
-auto strip_utf8_bom(std::istream& in) -> void
+auto strip_utf8_bom(string_view& in) -> void
 {
-	if (!in.good())
-		return;
-	string bom(3, '\0');
-	in.read(&bom[0], 3);
-	auto cnt = in.gcount();
-	if (cnt == 3 && bom == "\xEF\xBB\xBF")
-		return;
-	if (cnt < 3)
-		reset_failbit_istream(in);
-	for (auto i = cnt - 1; i >= 0; --i) {
-		in.putback(bom[i]);
+	if (in.substr(0, 3) == "\xEF\xBB\xBF")
+		in.remove_prefix(3);
+}
+
+/**
+ * @brief Reads the whole stream into @p out.
+ *
+ * @return true if the end of the stream was reached without error.
+ */
+auto read_whole_stream(istream& in, string& out) -> bool
+{
+	char block[1 << 14];
+	while (in.read(block, sizeof block) || in.gcount())
+		out.append(block, in.gcount());
+	return in.eof() && !in.bad();
+}
+
+/**
+ * @brief Gets the next line from @p in, like getline().
+ *
+ * @param[in,out] in the line and its newline are removed from its front.
+ * @param[out] line view into @p in.
+ * @return false if @p in is empty.
+ */
+auto get_line(string_view& in, string_view& line) -> bool
+{
+	if (in.empty())
+		return false;
+	auto end = min(in.find('\n'), in.size());
+	line = in.substr(0, end);
+	in.remove_prefix(min(end + 1, in.size()));
+	return true;
+}
+
+/**
+ * @brief Adds a flag set to the pool if it is not already there.
+ *
+ * @param flags set to intern.
+ * @return handle of the stored set, equal sets get equal handles.
+ */
+auto Flag_Set_Pool::insert(const Flag_Set& flags) -> Handle
+{
+	if (flags.empty())
+		return 0;
+	auto h = Handle(sets.size());
+	auto ins = index.emplace(flags.data(), h);
+	if (!ins.second)
+		return ins.first->second;
+	sets.push_back(flags);
+	attrs.push_back(flag_attributes(flags, special_flags));
+	return h;
+}
+
+/**
+ * @brief Sets the special flags and recomputes the attributes of all sets.
+ */
+auto Flag_Set_Pool::set_attribute_flags(const Special_Flags& sf) const
+    -> void
+{
+	special_flags = sf;
+	for (size_t i = 0; i != sets.size(); ++i)
+		attrs[i] = flag_attributes(sets[i], sf);
+}
+
+auto String_Arena::Block_Deleter::operator()(char* p) const -> void
+{
+	free(p);
+}
+
+auto String_Arena::add_block(size_t n) -> void
+{
+	void* p = nullptr;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	const size_t huge_page_size = 2 * 1024 * 1024;
+	if (n >= huge_page_size) {
+		if (posix_memalign(&p, huge_page_size, n) == 0)
+			madvise(p, n, MADV_HUGEPAGE);
+		else
+			p = nullptr;
 	}
+#endif
+	if (!p)
+		p = malloc(n ? n : 1);
+	if (!p)
+		throw std::bad_alloc();
+	auto b = Block();
+	b.data.reset(static_cast<char*>(p));
+	b.size = n;
+	blocks.push_back(move(b));
 }
 
-//#if _POSIX_VERSION >= 200809L
-#ifdef _POSIX_VERSION
-class Setlocale_To_C_In_Scope {
-	locale_t old_loc = nullptr;
+/**
+ * @brief Makes sure the next n bytes fit in the current block.
+ */
+auto String_Arena::reserve(size_t n) -> void
+{
+	auto room =
+	    blocks.empty() ? 0 : blocks.back().size - blocks.back().used;
+	if (room < n)
+		add_block(n);
+}
 
-      public:
-	Setlocale_To_C_In_Scope()
-	    : old_loc{uselocale(newlocale(0, "C", nullptr))}
-	{
+/**
+ * @brief Copies a string in the arena.
+ *
+ * A string equal to the one stored just before it is not copied again,
+ * e.g. homonyms that are next to each other in a .dic file share the bytes.
+ *
+ * @return view of the stored copy.
+ */
+auto String_Arena::store(string_view s) -> string_view
+{
+	if (!blocks.empty() && s == last)
+		return last;
+	auto room =
+	    blocks.empty() ? 0 : blocks.back().size - blocks.back().used;
+	if (blocks.empty() || room < s.size()) {
+		// blocks grow from 64 KiB to 16 MiB
+		auto n = size_t(64 * 1024) << min(blocks.size(), size_t(8));
+		add_block(max(s.size(), n));
 	}
-	~Setlocale_To_C_In_Scope()
-	{
-		auto new_loc = uselocale(old_loc);
-		if (new_loc != old_loc)
-			freelocale(new_loc);
+	auto& b = blocks.back();
+	auto p = b.data.get() + b.used;
+	copy(begin(s), end(s), p);
+	b.used += s.size();
+	last = string_view(p, s.size());
+	return last;
+}
+
+/**
+ * @brief Builds the minimal automaton incrementally.
+ *
+ * The algorithm of Daciuk et al. for sorted input. The states on the path of
+ * the previous word are not final yet. When the next word leaves that path,
+ * the states below the split are replaced by an equivalent registered state
+ * or are registered themselves. States are registered bottom-up, so the
+ * root is the last.
+ */
+Word_Dawg::Word_Dawg(const std::vector<std::pair<string_view, Handle>>& words)
+{
+	struct Node {
+		uint32_t final_count = 0;
+		std::vector<std::pair<unsigned char, uint32_t>> arcs;
+	};
+	auto states = vector<State>();
+	auto labels = vector<unsigned char>();
+	auto targets = vector<uint32_t>();
+	auto skips = vector<uint32_t>();
+	auto vals = vector<Handle>();
+	auto counts = vector<uint32_t>(); // number of words below a state
+	auto registry = unordered_map<string, uint32_t>();
+	auto signature = string();
+	auto add_raw = [&](uint32_t x) {
+		signature.append(reinterpret_cast<const char*>(&x), sizeof x);
+	};
+	auto register_node = [&](const Node& n) {
+		signature.clear();
+		add_raw(n.final_count);
+		for (auto& a : n.arcs) {
+			signature += char(a.first);
+			add_raw(a.second);
+		}
+		auto it = registry.find(signature);
+		if (it != end(registry))
+			return it->second;
+		auto id = uint32_t(states.size());
+		auto st = State();
+		st.first_arc = labels.size();
+		st.final_count = n.final_count;
+		states.push_back(st);
+		auto count = n.final_count;
+		for (auto& a : n.arcs) {
+			labels.push_back(a.first);
+			targets.push_back(a.second);
+			skips.push_back(count);
+			count += counts[a.second];
+		}
+		counts.push_back(count);
+		registry.emplace(signature, id);
+		return id;
+	};
+	auto path = vector<Node>(1);
+	auto prev = string_view();
+	// registers the states on the path below depth len
+	auto minimize = [&](size_t len) {
+		for (auto i = prev.size(); i != len; --i) {
+			auto id = register_node(path[i]);
+			path.pop_back();
+			path.back().arcs.emplace_back(prev[i - 1], id);
+		}
+	};
+	vals.reserve(words.size());
+	for (auto& wf : words) {
+		auto& word = wf.first;
+		auto p = size_t(mismatch(begin(prev), end(prev), begin(word),
+		                         end(word))
+		                    .first -
+		                begin(prev));
+		minimize(p);
+		for (auto i = p; i != word.size(); ++i)
+			path.emplace_back();
+		++path.back().final_count;
+		vals.push_back(wf.second);
+		prev = word;
 	}
-	Setlocale_To_C_In_Scope(const Setlocale_To_C_In_Scope&) = delete;
-};
-#else
-class Setlocale_To_C_In_Scope {
-	std::string old_name;
-#ifdef _WIN32
-	int old_per_thread;
-#endif
-      public:
-	Setlocale_To_C_In_Scope() : old_name(setlocale(LC_ALL, nullptr))
-	{
-#ifdef _WIN32
-		old_per_thread = _configthreadlocale(_ENABLE_PER_THREAD_LOCALE);
-#endif
-		auto x = setlocale(LC_ALL, "C");
-		if (!x)
-			old_name.clear();
+	minimize(0);
+	root = register_node(path[0]);
+	auto sentinel = State();
+	sentinel.first_arc = labels.size();
+	states.push_back(sentinel);
+	states.shrink_to_fit();
+	labels.shrink_to_fit();
+	targets.shrink_to_fit();
+	skips.shrink_to_fit();
+	this->states = move(states);
+	this->labels = move(labels);
+	this->targets = move(targets);
+	this->skips = move(skips);
+	this->vals = move(vals);
+}
+
+auto Word_Dawg::find_arc(uint32_t s, unsigned char c) const -> size_t
+{
+	auto first = begin(labels) + states[s].first_arc;
+	auto last = begin(labels) + states[s + 1].first_arc;
+	auto it = lower_bound(first, last, c);
+	if (it == last || *it != c)
+		return -1;
+	return it - begin(labels);
+}
+
+auto Word_Dawg::equal_range(string_view word) const
+    -> std::pair<const Handle*, const Handle*>
+{
+	if (empty())
+		return {};
+	auto s = root;
+	size_t idx = 0;
+	for (auto c : word) {
+		auto a = find_arc(s, c);
+		if (a == size_t(-1))
+			return {};
+		idx += skips[a];
+		s = targets[a];
 	}
-	~Setlocale_To_C_In_Scope()
-	{
-#ifdef _WIN32
-		_configthreadlocale(old_per_thread);
-		if (old_per_thread == _ENABLE_PER_THREAD_LOCALE)
-#endif
-		{
-			if (!old_name.empty())
-				setlocale(LC_ALL, old_name.c_str());
+	auto p = vals.data() + idx;
+	return {p, p + states[s].final_count};
+}
+
+/**
+ * @brief Looks up a word in the internal wide encoding.
+ *
+ * The word is encoded to UTF-8 while walking, like in Word_Hash.
+ */
+auto Word_Dawg::equal_range(wstring_view word) const
+    -> std::pair<const Handle*, const Handle*>
+{
+	using utf8 = boost::locale::utf::utf_traits<char>;
+	using utfw = boost::locale::utf::utf_traits<wchar_t>;
+	if (empty())
+		return {};
+	auto s = root;
+	size_t idx = 0;
+	char buf[utf8::max_width];
+	for (auto it = begin(word), last = end(word); it != last;) {
+		auto buf_end = buf;
+		if (*it < 0x80) {
+			*buf_end++ = char(*it++);
+		}
+		else {
+			auto cp = utfw::decode_valid(it);
+			buf_end = utf8::encode(cp, buf);
+		}
+		for (auto p = buf; p != buf_end; ++p) {
+			auto a = find_arc(s, *p);
+			if (a == size_t(-1))
+				return {};
+			idx += skips[a];
+			s = targets[a];
 		}
 	}
-	Setlocale_To_C_In_Scope(const Setlocale_To_C_In_Scope&) = delete;
-};
-#endif
+	auto p = vals.data() + idx;
+	return {p, p + states[s].final_count};
+}
+
+/**
+ * @brief Checks that lookups stay within the arrays.
+ *
+ * Needed for arrays loaded from a file. As built, the targets of the arcs
+ * of a state are states registered before it, the arcs of a state are
+ * sorted by label and the skips of the arcs count the words below the
+ * previous arcs. Those are checked, so every walk ends and every range of
+ * handles it returns is within vals.
+ *
+ * @param handle_count handles must be less than it.
+ */
+auto Word_Dawg::is_valid(size_t handle_count) const -> bool
+{
+	if (states.empty())
+		return labels.empty() && targets.empty() && skips.empty() &&
+		       vals.empty();
+	auto n = states.size() - 1; // without the sentinel
+	if (labels.size() != targets.size() || labels.size() != skips.size() ||
+	    states[0].first_arc != 0 || states[n].first_arc != labels.size() ||
+	    root >= n)
+		return false;
+	// number of words below each state
+	auto counts = vector<uint64_t>(n);
+	for (size_t s = 0; s != n; ++s) {
+		auto a = states[s].first_arc;
+		auto a_end = states[s + 1].first_arc;
+		if (a > a_end)
+			return false;
+		uint64_t count = states[s].final_count;
+		for (; a != a_end; ++a) {
+			if (targets[a] >= s || skips[a] != count)
+				return false;
+			if (a != states[s].first_arc &&
+			    labels[a - 1] >= labels[a])
+				return false;
+			count += counts[targets[a]];
+			if (count > vals.size())
+				return false;
+		}
+		counts[s] = count;
+	}
+	if (counts[root] != vals.size())
+		return false;
+	return all_of(begin(vals), end(vals),
+	              [&](auto h) { return h < handle_count; });
+}
+
+/**
+ * @brief Returns the word with number i, 0 <= i < size().
+ */
+auto Word_Dawg::word_at(size_t i) const -> std::string
+{
+	auto word = string();
+	auto s = root;
+	size_t idx = 0;
+	while (i >= idx + states[s].final_count) {
+		// skips grow within a state, the arc is the last one <= i
+		auto first = begin(skips) + states[s].first_arc;
+		auto last = begin(skips) + states[s + 1].first_arc;
+		auto a = upper_bound(first, last, i - idx) - 1 - begin(skips);
+		word += char(labels[a]);
+		idx += skips[a];
+		s = targets[a];
+	}
+	return word;
+}
+
+/**
+ * @brief Fills the words and the handles in slot order.
+ *
+ * @param words homonyms next to each other.
+ * @param firsts index in words of the first of each group of homonyms.
+ * @param order for each slot, the index in firsts of its word.
+ */
+auto Word_Perfect_Hash::fill(
+    const std::vector<std::pair<string_view, Handle>>& words,
+    const std::vector<size_t>& firsts, const std::vector<size_t>& order)
+    -> void
+{
+	auto n = firsts.size();
+	auto word_ends = vector<uint32_t>(1);
+	word_ends.reserve(n + 1);
+	auto val_ends = vector<uint32_t>(1);
+	val_ends.reserve(n + 1);
+	auto vals = vector<Handle>();
+	vals.reserve(words.size());
+	auto chars = vector<char>();
+	for (auto i : order) {
+		auto first = firsts[i];
+		auto last = i + 1 != n ? firsts[i + 1] : words.size();
+		auto& w = words[first].first;
+		chars.insert(end(chars), begin(w), end(w));
+		word_ends.push_back(chars.size());
+		for (auto j = first; j != last; ++j)
+			vals.push_back(words[j].second);
+		val_ends.push_back(vals.size());
+	}
+	chars.shrink_to_fit();
+	this->chars = move(chars);
+	this->word_ends = move(word_ends);
+	this->val_ends = move(val_ends);
+	this->vals = move(vals);
+}
+
+auto static group_homonyms(
+    const std::vector<std::pair<string_view, Flag_Set_Pool::Handle>>& words)
+{
+	auto firsts = vector<size_t>();
+	for (size_t i = 0; i != words.size(); ++i)
+		if (i == 0 || words[i].first != words[i - 1].first)
+			firsts.push_back(i);
+	return firsts;
+}
+
+auto Word_Perfect_Hash::build(
+    const std::vector<std::pair<string_view, Handle>>& words) -> bool
+{
+	*this = Word_Perfect_Hash();
+	auto firsts = group_homonyms(words);
+	auto n = firsts.size();
+	if (n == 0)
+		return true;
+	auto nb = bucket_count(n);
+	auto pilots = vector<uint32_t>(nb);
+
+	// sort the words by bucket with counting sort
+	auto hashes = vector<size_t>(n);
+	auto bucket_starts = vector<size_t>(nb + 1);
+	for (size_t i = 0; i != n; ++i) {
+		hashes[i] = Word_Hash()(words[firsts[i]].first);
+		++bucket_starts[hashes[i] % nb + 1];
+	}
+	partial_sum(begin(bucket_starts), end(bucket_starts),
+	            begin(bucket_starts));
+	auto by_bucket = vector<size_t>(n);
+	auto pos = bucket_starts;
+	for (size_t i = 0; i != n; ++i)
+		by_bucket[pos[hashes[i] % nb]++] = i;
+
+	// place the largest buckets first, while most slots are free
+	auto buckets = vector<size_t>(nb);
+	iota(begin(buckets), end(buckets), 0);
+	auto bucket_size = [&](size_t b) {
+		return bucket_starts[b + 1] - bucket_starts[b];
+	};
+	stable_sort(begin(buckets), end(buckets), [&](auto a, auto b) {
+		return bucket_size(a) > bucket_size(b);
+	});
+	auto taken = vector<bool>(n);
+	auto order = vector<size_t>(n);
+	auto bucket_slots = vector<size_t>();
+	auto bucket_hashes = vector<size_t>();
+	for (auto b : buckets) {
+		auto first = begin(by_bucket) + bucket_starts[b];
+		auto last = begin(by_bucket) + bucket_starts[b + 1];
+		if (first == last)
+			break;
+		bucket_hashes.clear();
+		for (auto it = first; it != last; ++it)
+			bucket_hashes.push_back(hashes[*it]);
+		sort(begin(bucket_hashes), end(bucket_hashes));
+		if (adjacent_find(begin(bucket_hashes), end(bucket_hashes)) !=
+		    end(bucket_hashes)) {
+			*this = Word_Perfect_Hash();
+			return false;
+		}
+		for (uint32_t pilot = 0;; ++pilot) {
+			bucket_slots.clear();
+			for (auto it = first; it != last; ++it) {
+				auto s = slot_of(hashes[*it], pilot, n);
+				if (taken[s] ||
+				    find(begin(bucket_slots), end(bucket_slots),
+				         s) != end(bucket_slots))
+					break;
+				bucket_slots.push_back(s);
+			}
+			if (bucket_slots.size() == size_t(last - first)) {
+				pilots[b] = pilot;
+				break;
+			}
+			if (pilot == UINT32_MAX) {
+				*this = Word_Perfect_Hash();
+				return false;
+			}
+		}
+		for (auto it = first; it != last; ++it) {
+			auto s = bucket_slots[it - first];
+			taken[s] = true;
+			order[s] = *it;
+		}
+	}
+	this->pilots = move(pilots);
+	fill(words, firsts, order);
+	return true;
+}
+
+auto Word_Perfect_Hash::build(
+    const std::vector<std::pair<string_view, Handle>>& words,
+    std::vector<uint32_t> p) -> bool
+{
+	*this = Word_Perfect_Hash();
+	auto firsts = group_homonyms(words);
+	auto n = firsts.size();
+	if (p.size() != bucket_count(n))
+		return false;
+	pilots = move(p);
+	for (size_t i = 0; i != n; ++i) {
+		auto h = Word_Hash()(words[firsts[i]].first);
+		if (slot_of(h, pilots[bucket_of(h)], n) != i) {
+			*this = Word_Perfect_Hash();
+			return false;
+		}
+	}
+	auto order = vector<size_t>(n);
+	iota(begin(order), end(order), 0);
+	fill(words, firsts, order);
+	return true;
+}
+
+/**
+ * @brief Checks that lookups stay within the arrays.
+ *
+ * Needed for arrays loaded from a file. The ends of the words and of their
+ * handles must not decrease and must end at the sizes of the arrays.
+ *
+ * @param handle_count handles must be less than it.
+ */
+auto Word_Perfect_Hash::is_valid(size_t handle_count) const -> bool
+{
+	if (word_ends.empty() || word_ends.size() != val_ends.size())
+		return false;
+	auto n = word_ends.size() - 1;
+	if (pilots.size() != bucket_count(n) || word_ends[0] != 0 ||
+	    val_ends[0] != 0 || word_ends[n] != chars.size() ||
+	    val_ends[n] != vals.size())
+		return false;
+	if (!is_sorted(begin(word_ends), end(word_ends)) ||
+	    !is_sorted(begin(val_ends), end(val_ends)))
+		return false;
+	return all_of(begin(vals), end(vals),
+	              [&](auto h) { return h < handle_count; });
+}
+
+auto Word_Perfect_Hash::slot_of_handle(const Handle& h) const -> size_t
+{
+	auto i = uint32_t(&h - vals.data());
+	return upper_bound(begin(val_ends), end(val_ends), i) -
+	       begin(val_ends) - 1;
+}
+
+Word_Table::Word_Table(const Word_Table& other)
+{
+	table.reserve(other.size());
+	other.for_each([&](auto& e) { emplace(e.word(), e.flags); });
+}
+
+auto Word_Table::operator=(const Word_Table& other) -> Word_Table&
+{
+	auto tmp = other;
+	return *this = move(tmp);
+}
+
+auto Word_List::emplace(string_view word, Flag_Set_Pool::Handle flags)
+    -> const_pointer
+{
+	if (store != Word_Store::HASH_TABLE)
+		set_word_store(Word_Store::HASH_TABLE);
+	return &table.emplace(word, flags)->flags;
+}
+
+/**
+ * @brief Moves the words to the other store.
+ *
+ * The old store is freed. Addresses of the elements are not kept. If the
+ * perfect hash can not be built, the words stay in the hash table.
+ */
+auto Word_List::set_word_store(Word_Store s) -> void
+{
+	if (s == store)
+		return;
+	if (store != Word_Store::HASH_TABLE) {
+		auto old_dawg = move(dawg);
+		auto old_ph = move(perfect_hash);
+		dawg = Word_Dawg();
+		perfect_hash = Word_Perfect_Hash();
+		auto add = [&](string_view w, auto first, auto last) {
+			for (; first != last; ++first)
+				table.emplace(w, *first);
+		};
+		if (store == Word_Store::DAWG) {
+			table.reserve(old_dawg.size());
+			old_dawg.for_each(add);
+		}
+		else {
+			table.reserve(old_ph.size());
+			old_ph.for_each(add);
+		}
+		store = Word_Store::HASH_TABLE;
+	}
+	if (s == Word_Store::HASH_TABLE)
+		return;
+	auto words = vector<pair<string_view, Flag_Set_Pool::Handle>>();
+	words.reserve(table.size());
+	table.for_each([&](auto& e) { words.emplace_back(e.word(), e.flags); });
+	if (s == Word_Store::DAWG) {
+		stable_sort(begin(words), end(words), [](auto& a, auto& b) {
+			return a.first < b.first;
+		});
+		dawg = Word_Dawg(words);
+	}
+	else if (!perfect_hash.build(words)) {
+		return;
+	}
+	words = {};
+	table = Word_Table();
+	store = s;
+}
+
+/**
+ * @brief Replaces the words with an automaton built elsewhere.
+ *
+ * The handles in it must be from flag_set_pool() of this list.
+ */
+auto Word_List::set_dawg(Word_Dawg&& d) -> void
+{
+	table = Word_Table();
+	perfect_hash = Word_Perfect_Hash();
+	dawg = move(d);
+	store = Word_Store::DAWG;
+}
+
+/**
+ * @brief Replaces the words with a perfect hash built elsewhere.
+ *
+ * The handles in it must be from flag_set_pool() of this list.
+ */
+auto Word_List::set_perfect_hash(Word_Perfect_Hash&& ph) -> void
+{
+	table = Word_Table();
+	dawg = Word_Dawg();
+	perfect_hash = move(ph);
+	store = Word_Store::PERFECT_HASH;
+}
+
+/**
+ * @brief Collects the flags with special meaning, see Flag_Attribute.
+ */
+auto Aff_Data::special_flags() const -> Special_Flags
+{
+	auto sf = Special_Flags();
+	sf.forbiddenword = forbiddenword_flag;
+	sf.nosuggest = nosuggest_flag;
+	sf.need_affix = need_affix_flag;
+	sf.compound_onlyin = compound_onlyin_flag;
+	sf.keepcase = keepcase_flag;
+	sf.warn = warn_flag;
+	sf.circumfix = circumfix_flag;
+	sf.compound = compound_flag;
+	sf.compound_begin = compound_begin_flag;
+	sf.compound_middle = compound_middle_flag;
+	sf.compound_last = compound_last_flag;
+	sf.compound_permit = compound_permit_flag;
+	sf.compound_forbid = compound_forbid_flag;
+	return sf;
+}
+
+/**
+ * @brief Brings the attributes of the flags of words and affixes up to date
+ * with the special flags.
+ *
+ * Flag sets and affixes added later get their attributes when they are
+ * added, so the attributes are computed again only if any of the special
+ * flags changed since the last call. That check is cheap, Dict_Base does it
+ * on every check_word(). The attributes are kept next to the flags they
+ * are derived from, so this is const. It writes them only when the special
+ * flags changed, thus after loading it only reads.
+ */
+auto Aff_Data::update_flag_attributes() const -> void
+{
+	auto sf = special_flags();
+	if (sf == words.flag_set_pool().attribute_flags())
+		return;
+	words.flag_set_pool().set_attribute_flags(sf);
+	prefixes.set_attribute_flags(sf);
+	suffixes.set_attribute_flags(sf);
+}
 
 /**
  * Parses an input stream offering affix information.
@@ -709,6 +1467,20 @@ class Setlocale_To_C_In_Scope {
  * @return true on success.
  */
 auto Aff_Data::parse_aff(istream& in) -> bool
+{
+	auto data = string();
+	if (!read_whole_stream(in, data))
+		return false;
+	return parse_aff(string_view(data));
+}
+
+/**
+ * Parses the contents of an affix file.
+ *
+ * @param in the whole file, e.g. memory mapped.
+ * @return true on success.
+ */
+auto Aff_Data::parse_aff(string_view in) -> bool
 {
 	string language_code;
 	string ignore_chars;
@@ -729,6 +1501,8 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	auto flags = u16string();
 
 	flag_type = Flag_Type::SINGLE_CHAR;
+	max_ngram_suggestions = 4;
+	max_diff_factor = 5;
 
 	unordered_map<string, string*> command_strings = {
 	    {"LANG", &language_code},
@@ -797,20 +1571,11 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	// keeps count for each vector
 	auto cmd_with_vec_cnt = unordered_map<string, int>();
 	auto cmd_affix = unordered_map<string, pair<bool, int>>();
-	auto line = string();
+	auto line = string_view();
 	auto command = string();
 	size_t line_num = 0;
-	auto ss = istringstream();
-	auto loc = locale::classic();
-	Setlocale_To_C_In_Scope setlocale_to_C;
-	// while parsing, the streams must have plain ascii locale without
-	// any special number separator otherwise istream >> int might fail
-	// due to thousands separator.
-	// "C" locale can be used assuming it is US-ASCII
-	in.imbue(loc);
-	ss.imbue(loc);
 	strip_utf8_bom(in);
-	while (getline(in, line)) {
+	while (get_line(in, line)) {
 		line_num++;
 
 		if (encoding.is_utf8() && !validate_utf8(line)) {
@@ -820,15 +1585,14 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 			// utf-8 and latin2. See note in decode_flags().
 		}
 
-		ss.str(line);
-		ss.clear();
-		ss >> ws;
+		auto ss = Line_Tokenizer(line);
+		ss.skip_ws();
 		if (ss.eof() || ss.peek() == '#') {
 			continue; // skip comment or empty lines
 		}
 		ss >> command;
-		boost::algorithm::to_upper(command, ss.getloc());
-		ss >> ws;
+		to_upper_ascii(command);
+		ss.skip_ws();
 		if (command == "PFX" || command == "SFX") {
 			auto& vec = command[0] == 'P' ? prefixes : suffixes;
 			parse_affix(ss, line_num, command, flag_type, encoding,
@@ -861,13 +1625,16 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 		}
 		else if (command_vec_str.count(command)) {
 			auto& vec = *command_vec_str[command];
-			auto func = [&](istream& in, string& p) { in >> p; };
+			auto func = [&](Line_Tokenizer& in, string& p) {
+				in >> p;
+			};
 			parse_vector_of_T(ss, line_num, command,
 			                  cmd_with_vec_cnt, vec, func);
 		}
 		else if (command_vec_pair.count(command)) {
 			auto& vec = *command_vec_pair[command];
-			auto func = [&](istream& in, pair<string, string>& p) {
+			auto func = [&](Line_Tokenizer& in,
+			                pair<string, string>& p) {
 				in >> p.first >> p.second;
 			};
 			parse_vector_of_T(ss, line_num, command,
@@ -892,7 +1659,7 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 		}
 		else if (command == "AF") {
 			auto& vec = flag_aliases;
-			auto func = [&](istream& inn, Flag_Set& p) {
+			auto func = [&](Line_Tokenizer& inn, Flag_Set& p) {
 				decode_flags(inn, line_num, flag_type, encoding,
 				             flags);
 				p = flags;
@@ -908,14 +1675,16 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 		}
 		else if (command == "BREAK") {
 			auto& vec = break_patterns;
-			auto func = [&](istream& in, string& p) { in >> p; };
+			auto func = [&](Line_Tokenizer& in, string& p) {
+				in >> p;
+			};
 			parse_vector_of_T(ss, line_num, command,
 			                  cmd_with_vec_cnt, vec, func);
 			break_exists = true;
 		}
 		else if (command == "CHECKCOMPOUNDPATTERN") {
 			auto& vec = compound_check_patterns;
-			auto func = [&](istream& in,
+			auto func = [&](Line_Tokenizer& in,
 			                Compound_Check_Pattern& p) {
 				parse_word_slash_single_flag(
 				    in, line_num, flag_type, encoding,
@@ -927,13 +1696,13 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 					return;
 				}
 				in >> p.replacement;
-				reset_failbit_istream(in);
+				in.clear_fail();
 			};
 			parse_vector_of_T(ss, line_num, command,
 			                  cmd_with_vec_cnt, vec, func);
 		}
 		else if (command == "COMPOUNDRULE") {
-			auto func = [&](istream& in, u16string& rule) {
+			auto func = [&](Line_Tokenizer& in, u16string& rule) {
 				parse_compound_rule(in, line_num, flag_type,
 				                    encoding, rule);
 			};
@@ -1089,9 +1858,10 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 		// 2) We will later use only the wide facets which are Unicode
 		//    anyway.
 	}
+	update_flag_attributes();
 
 	cerr.flush();
-	return in.eof(); // success when eof is reached
+	return true;
 }
 
 /**
@@ -1100,7 +1870,7 @@ auto Aff_Data::parse_aff(istream& in) -> bool
  *
  * @returns the end of the word before the morph field, or npos
  */
-auto dic_find_end_of_word_heuristics(const string& line)
+auto dic_find_end_of_word_heuristics(string_view line)
 {
 	if (line.size() < 4)
 		return line.npos;
@@ -1122,6 +1892,143 @@ auto dic_find_end_of_word_heuristics(const string& line)
 	return line.npos;
 }
 
+/**
+ * @brief Word of the .dic file parsed, but not yet added to the word list.
+ */
+struct Dic_Chunk_Entry {
+	string word;
+	Flag_Set flags;
+	Casing casing;
+};
+
+/**
+ * @brief Problem found in a line of the .dic file, reported when merging.
+ */
+struct Dic_Chunk_Diagnostic {
+	size_t line; // relative to the start of the chunk
+	bool invalid_utf8;
+	Flag_Parsing_Error flag_error;
+};
+
+/**
+ * @brief Result of parsing a chunk of lines of the .dic file.
+ */
+struct Dic_Chunk {
+	vector<Dic_Chunk_Entry> entries;
+	vector<Dic_Chunk_Diagnostic> diagnostics;
+	size_t line_count = 0;
+};
+
+/**
+ * @brief Parses one line of the .dic file.
+ *
+ * The line is copied into @p unescaped only if it has escaped slashes.
+ *
+ * @return true if the line holds a word.
+ */
+auto parse_dic_line(string_view line, const Aff_Data& aff,
+                    Encoding_Converter& conv, Dic_Chunk_Entry& out,
+                    Dic_Chunk_Diagnostic& diag, u16string& flags,
+                    wstring& wide_word, string& unescaped) -> bool
+{
+	auto& enc = aff.encoding;
+	auto& word = out.word;
+	word.clear();
+	flags.clear();
+
+	if (enc.is_utf8() && !validate_utf8(line))
+		diag.invalid_utf8 = true;
+	size_t slash_pos = 0;
+	auto copied = false;
+	for (;;) {
+		slash_pos = line.find('/', slash_pos);
+		if (slash_pos == line.npos)
+			break;
+		if (slash_pos == 0)
+			break;
+		if (line[slash_pos - 1] != '\\')
+			break;
+
+		if (!copied) {
+			unescaped.assign(line.data(), line.size());
+			copied = true;
+		}
+		unescaped.erase(slash_pos - 1, 1);
+		line = unescaped;
+	}
+	if (slash_pos != line.npos && slash_pos != 0) {
+		// slash found, word until slash, then the flags up to the
+		// next white space
+		word.assign(line.data(), slash_pos);
+		auto ws = " \t\n\v\f\r";
+		auto a = min(line.find_first_not_of(ws, slash_pos + 1),
+		             line.size());
+		auto b = min(line.find_first_of(ws, a), line.size());
+		auto err = decode_flags_possible_alias(
+		    line.substr(a, b - a), aff.flag_type, enc, aff.flag_aliases,
+		    flags);
+		diag.flag_error = err;
+		if (static_cast<int>(err) > 0)
+			return false;
+	}
+	else if (line.find('\t') != line.npos) {
+		// Tab found, word until tab. No flags.
+		// After tab follow morphological fields
+		word.assign(line.data(), line.find('\t'));
+	}
+	else {
+		auto end = dic_find_end_of_word_heuristics(line);
+		word.assign(line.data(), min(end, line.size()));
+	}
+	if (word.empty())
+		return false;
+
+	auto ok = false;
+	if (enc.is_utf8()) {
+		ok = utf8_to_wide(word, wide_word);
+	}
+	else {
+		ok = conv.to_wide(word, wide_word);
+		wide_to_utf8(wide_word, word);
+	}
+	if (!ok)
+		return false;
+	if (!aff.ignored_chars.empty()) {
+		erase_chars(wide_word, aff.ignored_chars);
+		wide_to_utf8(wide_word, word);
+	}
+	out.casing = classify_casing(wide_word);
+	out.flags = flags;
+	return true;
+}
+
+/**
+ * @brief Parses a chunk of whole lines of the .dic file.
+ *
+ * Chunks are independent, so they can be parsed in parallel. Problems are
+ * collected and not printed, see Dic_Chunk_Diagnostic.
+ */
+auto parse_dic_chunk(string_view chunk, const Aff_Data& aff) -> Dic_Chunk
+{
+	auto ret = Dic_Chunk();
+	auto conv = Encoding_Converter(aff.encoding.value_or_default());
+	auto line = string_view();
+	auto flags = u16string();
+	auto wide_word = wstring();
+	auto unescaped = string();
+	auto entry = Dic_Chunk_Entry();
+	while (get_line(chunk, line)) {
+		auto diag = Dic_Chunk_Diagnostic{ret.line_count++, false, {}};
+		if (parse_dic_line(line, aff, conv, entry, diag, flags,
+		                   wide_word, unescaped))
+			ret.entries.push_back(move(entry));
+		if (diag.invalid_utf8 ||
+		    diag.flag_error != Flag_Parsing_Error::NO_ERROR)
+			ret.diagnostics.push_back(diag);
+	}
+	return ret;
+}
+
 /**
  * Parses an input stream offering dictionary information.
  *
@@ -1129,26 +2036,33 @@ auto dic_find_end_of_word_heuristics(const string& line)
  * @return true on success.
  */
 auto Aff_Data::parse_dic(istream& in) -> bool
+{
+	auto data = string();
+	if (!read_whole_stream(in, data))
+		return false;
+	return parse_dic(string_view(data));
+}
+
+/**
+ * Parses the contents of a dictionary file.
+ *
+ * @param in the whole file, e.g. memory mapped.
+ * @return true on success.
+ */
+auto Aff_Data::parse_dic(string_view in) -> bool
 {
 	size_t line_number = 1;
 	size_t approximate_size;
-	istringstream ss;
-	string line;
-
-	// locale must be without thousands separator.
-	auto loc = locale::classic();
-	Setlocale_To_C_In_Scope setlocale_to_C;
-	in.imbue(loc);
-	ss.imbue(loc);
+	auto line = string_view();
+
 	strip_utf8_bom(in);
-	if (!getline(in, line)) {
+	if (!get_line(in, line)) {
 		return false;
 	}
-	auto enc_conv = Encoding_Converter(encoding.value_or_default());
 	if (encoding.is_utf8() && !validate_utf8(line)) {
 		cerr << "Invalid utf in dic file" << endl;
 	}
-	ss.str(line);
+	auto ss = Line_Tokenizer(line);
 	if (ss >> approximate_size) {
 		words.reserve(approximate_size);
 	}
@@ -1156,121 +2070,656 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 		return false;
 	}
 
-	string word;
-	string morph;
-	vector<string> morphs;
-	u16string flags;
-	wstring wide_word;
-
-	while (getline(in, line)) {
-		line_number++;
-		ss.str(line);
-		ss.clear();
-		word.clear();
-		morph.clear();
-		flags.clear();
-		morphs.clear();
-
-		if (encoding.is_utf8() && !validate_utf8(line)) {
-			cerr << "Invalid utf in dic file" << endl;
+	// The body is parsed in chunks on multiple threads. Only the insertion
+	// into the word list is serial, in the order of the lines, because of
+	// the hidden homonyms.
+	auto body = in;
+	auto const min_chunk_size = size_t(1) << 20;
+	auto n_chunks = min(size_t(thread::hardware_concurrency()),
+	                    body.size() / min_chunk_size);
+	n_chunks = max(n_chunks, size_t(1));
+	auto chunks = vector<string_view>();
+	for (size_t i = 0, k = 1; i != body.size(); ++k) {
+		auto j = body.size();
+		if (k < n_chunks) {
+			j = body.find('\n', max(i, k * body.size() / n_chunks));
+			j = j == body.npos ? body.size() : j + 1;
 		}
-		size_t slash_pos = 0;
-		for (;;) {
-			slash_pos = line.find('/', slash_pos);
-			if (slash_pos == line.npos)
+		chunks.push_back(body.substr(i, j - i));
+		i = j;
+	}
+	auto futures = vector<future<Dic_Chunk>>();
+	for (size_t k = 1; k < chunks.size(); ++k)
+		futures.push_back(async(launch::async, parse_dic_chunk,
+		                        chunks[k], cref(*this)));
+	auto parsed = vector<Dic_Chunk>();
+	if (!chunks.empty())
+		parsed.push_back(parse_dic_chunk(chunks[0], *this));
+	for (auto& f : futures)
+		parsed.push_back(f.get());
+
+	// all the words go in one block of the arena
+	auto word_bytes = size_t(0);
+	for (auto& chunk : parsed)
+		for (auto& e : chunk.entries)
+			word_bytes += e.word.size();
+	words.reserve_bytes(word_bytes);
+
+	const char16_t HIDDEN_HOMONYM_FLAG = -1;
+	auto is_hidden_homonym = [&](auto& w) {
+		return (words.attributes(w) & HIDDEN_HOMONYM_ATTR) != 0;
+	};
+	for (auto& chunk : parsed) {
+		for (auto& d : chunk.diagnostics) {
+			if (d.invalid_utf8)
+				cerr << "Invalid utf in dic file" << endl;
+			report_flag_parsing_error(d.flag_error,
+			                          line_number + 1 + d.line);
+		}
+		line_number += chunk.line_count;
+
+		for (auto& e : chunk.entries) {
+			auto& word = e.word;
+			auto& flags = e.flags;
+			switch (e.casing) {
+			case Casing::ALL_CAPITAL: {
+				// check for hidden homonym
+				auto hom = words.equal_range(word);
+				auto h = std::find_if(hom.first, hom.second,
+				                      is_hidden_homonym);
+
+				if (h != hom.second) {
+					// replace if found
+					auto fs = words.intern(flags);
+					words.set_flags(*h, fs);
+				}
+				else {
+					words.emplace(word, flags);
+				}
 				break;
-			if (slash_pos == 0)
+			}
+			case Casing::PASCAL:
+			case Casing::CAMEL: {
+				words.emplace(word, flags);
+
+				// add the hidden homonym directly in uppercase
+				auto& up = word;
+				auto hom = words.equal_range(up);
+				auto h = none_of(hom.first, hom.second,
+				                 is_hidden_homonym);
+				if (h) { // if not found
+					flags.insert(HIDDEN_HOMONYM_FLAG);
+					words.emplace(up, flags);
+				}
 				break;
-			if (line[slash_pos - 1] != '\\')
+			}
+			default:
+				words.emplace(word, flags);
 				break;
-
-			line.erase(slash_pos - 1, 1);
+			}
 		}
-		if (slash_pos != line.npos && slash_pos != 0) {
-			// slash found, word until slash
-			word.assign(line, 0, slash_pos);
-			ss.ignore(slash_pos + 1);
-			decode_flags_possible_alias(ss, line_number, flag_type,
-			                            encoding, flag_aliases,
-			                            flags);
-			if (ss.fail())
-				continue;
+	}
+	return true;
+}
+namespace {
+/*
+ * Layout of the binary format. All integers are stored in the native byte
+ * order, the header records enough to reject files made on incompatible
+ * platforms. Strings are stored as 32-bit length followed by the code units.
+ * Sequences are stored as 32-bit count followed by the elements. The tables
+ * are stored in their final, already processed, form so loading does no text
+ * parsing and no flag decoding.
+ *
+ * The word list is stored as the distinct flag sets, then the kind of the
+ * word store and its arrays, see Word_Dawg::save() and
+ * Word_Perfect_Hash::save(). Each array starts at an offset aligned to
+ * BINARY_ALIGNMENT and is stored exactly as it is in memory, so the loaded
+ * store uses it in place and loading only checks it, see
+ * Word_Dawg::is_valid() and Word_Perfect_Hash::is_valid(). A word list in
+ * the hash table is saved as a perfect hash.
+ */
+const char BINARY_MAGIC[8] = {'N', 'U', 'S', 'P', 'E', 'L', 'L', 'B'};
+const uint32_t BINARY_VERSION = 1;
+const uint32_t BINARY_BYTE_ORDER_MARK = 0x01020304;
+const size_t BINARY_ALIGNMENT = 8;
+
+class Binary_Writer {
+	ostream& out;
+	size_t pos = 0;
+
+	auto put(const void* data, size_t n) -> void
+	{
+		out.write(static_cast<const char*>(data), n);
+		pos += n;
+	}
+
+      public:
+	Binary_Writer(ostream& out) : out(out) {}
+	template <class T>
+	auto write(const T& x) -> void
+	{
+		static_assert(is_trivially_copyable<T>::value,
+		              "only trivial types can be written");
+		put(&x, sizeof(x));
+	}
+	auto write(bool x) -> void { write(uint8_t(x)); }
+	auto write_size(size_t n) -> void { write(uint32_t(n)); }
+	template <class CharT>
+	auto write(const basic_string<CharT>& s) -> void
+	{
+		write_size(s.size());
+		put(s.data(), s.size() * sizeof(CharT));
+	}
+	auto write(const Flag_Set& s) -> void { write(s.data()); }
+	auto write_bytes(string_view s) -> void { put(s.data(), s.size()); }
+	template <class T>
+	auto write_array(const Flat_Array<T>& a) -> void
+	{
+		static_assert(is_trivially_copyable<T>::value,
+		              "only trivial types can be written");
+		write_size(a.size());
+		while (pos % BINARY_ALIGNMENT != 0)
+			write(uint8_t(0));
+		put(a.data(), a.size() * sizeof(T));
+	}
+	template <class T, class U>
+	auto write(const pair<T, U>& p) -> void
+	{
+		write(p.first);
+		write(p.second);
+	}
+	template <class T>
+	auto write(const vector<T>& v) -> void
+	{
+		write_size(v.size());
+		for (auto& x : v)
+			write(x);
+	}
+	template <class AffixT>
+	auto write(const Affix_Table<wchar_t, AffixT>& t) -> void
+	{
+		write_size(t.size());
+		t.for_each([&](auto& a) {
+			write(a.flag);
+			write(a.cross_product);
+			write(a.stripping);
+			write(a.appending);
+			write(a.cont_flags);
+			write(a.condition.str());
+		});
+	}
+};
+
+class Binary_Reader {
+	const char* first;
+	const char* p;
+	const char* last;
+	bool ok = true;
+
+	auto fail() -> void
+	{
+		ok = false;
+		p = last;
+	}
+
+      public:
+	Binary_Reader(const char* data, size_t size)
+	    : first(data), p(data), last(data + size)
+	{
+	}
+	explicit operator bool() const { return ok; }
+	auto at_end() const { return p == last; }
+	template <class T>
+	auto read(T& x) -> void
+	{
+		static_assert(is_trivially_copyable<T>::value,
+		              "only trivial types can be read");
+		if (size_t(last - p) < sizeof(x))
+			return fail();
+		memcpy(&x, p, sizeof(x));
+		p += sizeof(x);
+	}
+	auto read(bool& x) -> void
+	{
+		auto b = uint8_t();
+		read(b);
+		if (b > 1)
+			return fail();
+		x = b;
+	}
+	auto read_size() -> size_t
+	{
+		auto n = uint32_t();
+		read(n);
+		return n;
+	}
+	template <class CharT>
+	auto read(basic_string<CharT>& s) -> void
+	{
+		auto n = read_size();
+		if (size_t(last - p) / sizeof(CharT) < n)
+			return fail();
+		s.resize(n);
+		memcpy(&s[0], p, n * sizeof(CharT));
+		p += n * sizeof(CharT);
+	}
+	auto bytes_left() const { return size_t(last - p); }
+	auto read_bytes(size_t n) -> string_view
+	{
+		if (bytes_left() < n) {
+			fail();
+			return {};
 		}
-		else if (line.find('\t') != line.npos) {
-			// Tab found, word until tab. No flags.
-			// After tab follow morphological fields
-			getline(ss, word, '\t');
+		auto s = string_view(p, n);
+		p += n;
+		return s;
+	}
+	/**
+	 * @brief Reads an array written by Binary_Writer::write_array().
+	 *
+	 * The array borrows the data if it is aligned, as it is when the data
+	 * starts at an address aligned to BINARY_ALIGNMENT.
+	 */
+	template <class T>
+	auto read_array(Flat_Array<T>& a) -> void
+	{
+		static_assert(is_trivially_copyable<T>::value,
+		              "only trivial types can be read");
+		auto n = read_size();
+		read_bytes((BINARY_ALIGNMENT - (p - first) % BINARY_ALIGNMENT) %
+		           BINARY_ALIGNMENT);
+		if (bytes_left() / sizeof(T) < n)
+			return fail();
+		auto data = reinterpret_cast<const T*>(p);
+		if (reinterpret_cast<uintptr_t>(p) % alignof(T) == 0) {
+			a = Flat_Array<T>(data, n);
 		}
 		else {
-			auto end = dic_find_end_of_word_heuristics(line);
-			word.assign(line, 0, end);
-			ss.ignore(end);
+			auto v = vector<T>(n);
+			copy_n(p, n * sizeof(T),
+			       reinterpret_cast<char*>(v.data()));
+			a = move(v);
 		}
-		if (word.empty()) {
-			continue;
+		p += n * sizeof(T);
+	}
+	auto read(Flag_Set& s) -> void
+	{
+		auto flags = u16string();
+		read(flags);
+		s = move(flags);
+	}
+	template <class T, class U>
+	auto read(pair<T, U>& x) -> void
+	{
+		read(x.first);
+		read(x.second);
+	}
+	template <class T>
+	auto read(vector<T>& v) -> void
+	{
+		auto n = read_size();
+		v.clear();
+		// Each element takes at least one byte, do not allocate
+		// based on a corrupted count.
+		if (n > size_t(last - p))
+			return fail();
+		v.resize(n);
+		for (auto& x : v)
+			read(x);
+	}
+	template <class AffixT>
+	auto read(Affix_Table<wchar_t, AffixT>& t) -> void
+	{
+		auto n = read_size();
+		auto a = AffixT();
+		auto cond = wstring();
+		for (size_t i = 0; i != n && ok; ++i) {
+			read(a.flag);
+			read(a.cross_product);
+			read(a.stripping);
+			read(a.appending);
+			read(a.cont_flags);
+			read(cond);
+			a.condition = move(cond);
+			if (ok)
+				t.emplace(a);
 		}
-		// parse_morhological_fields(ss, morphs);
+	}
+};
 
-		auto casing = Casing();
-		auto ok = false;
-		if (encoding.is_utf8()) {
-			ok = utf8_to_wide(word, wide_word);
-		}
-		else {
-			ok = enc_conv.to_wide(word, wide_word);
-			wide_to_utf8(wide_word, word);
-		}
-		if (!ok)
-			continue;
-		if (!ignored_chars.empty()) {
-			erase_chars(wide_word, ignored_chars);
-			wide_to_utf8(wide_word, word);
-		}
-		casing = classify_casing(wide_word);
-
-		const char16_t HIDDEN_HOMONYM_FLAG = -1;
-		switch (casing) {
-		case Casing::ALL_CAPITAL: {
-			// check for hidden homonym
-			auto hom = words.equal_range_nonconst_unsafe(word);
-			auto h =
-			    std::find_if(hom.first, hom.second, [&](auto& w) {
-				    return w.second.contains(
-				        HIDDEN_HOMONYM_FLAG);
-			    });
-
-			if (h != hom.second) {
-				// replace if found
-				h->second = flags;
-			}
-			else {
-				words.emplace(word, flags);
-			}
-			break;
-		}
-		case Casing::PASCAL:
-		case Casing::CAMEL: {
-			words.emplace(word, flags);
-
-			// add the hidden homonym directly in uppercase
-			auto up_wide = to_upper(wide_word, icu_locale);
-			wide_to_utf8(wide_word, word);
-			auto& up = word;
-			auto hom = words.equal_range(up);
-			auto h = none_of(hom.first, hom.second, [&](auto& w) {
-				return w.second.contains(HIDDEN_HOMONYM_FLAG);
-			});
-			if (h) { // if not found
-				flags += HIDDEN_HOMONYM_FLAG;
-				words.emplace(up, flags);
-			}
-			break;
-		}
-		default:
-			words.emplace(word, flags);
+template <class CharT>
+auto write_similarity_group(Binary_Writer& w, const Similarity_Group<CharT>& g)
+{
+	w.write(g.chars);
+	w.write(g.strings);
+}
+
+template <class CharT>
+auto read_similarity_group(Binary_Reader& r, Similarity_Group<CharT>& g)
+{
+	r.read(g.chars);
+	r.read(g.strings);
+}
+} // namespace
+
+/**
+ * @brief Writes all the data in a binary format.
+ *
+ * The format is versioned and not portable between platforms with different
+ * byte order or different size of wchar_t. Load it with load_binary().
+ *
+ * @param out output stream, should be opened in binary mode.
+ * @return true on success.
+ */
+auto Aff_Data::save_binary(std::ostream& out) const -> bool
+{
+	auto w = Binary_Writer(out);
+	w.write_bytes(string_view(BINARY_MAGIC, sizeof(BINARY_MAGIC)));
+	w.write(BINARY_VERSION);
+	w.write(BINARY_BYTE_ORDER_MARK);
+	w.write(uint32_t(sizeof(wchar_t)));
+
+	auto& flag_sets = words.flag_set_pool();
+	w.write_size(flag_sets.size() - 1);
+	for (size_t i = 1; i != flag_sets.size(); ++i)
+		w.write(flag_sets[i]);
+	switch (words.word_store()) {
+	case Word_Store::DAWG:
+		w.write(uint8_t(Word_Store::DAWG));
+		words.dawg_store().save(w);
+		break;
+	case Word_Store::PERFECT_HASH:
+		w.write(uint8_t(Word_Store::PERFECT_HASH));
+		words.perfect_hash_store().save(w);
+		break;
+	default: {
+		// the hash table holds pointers, save a static store instead
+		auto entries =
+		    vector<pair<string_view, Flag_Set_Pool::Handle>>();
+		entries.reserve(words.size());
+		words.for_each([&](auto word, auto& flags) {
+			entries.emplace_back(word, flags);
+		});
+		auto ph = Word_Perfect_Hash();
+		if (ph.build(entries)) {
+			w.write(uint8_t(Word_Store::PERFECT_HASH));
+			ph.save(w);
 			break;
 		}
+		stable_sort(begin(entries), end(entries), [](auto& a, auto& b) {
+			return a.first < b.first;
+		});
+		w.write(uint8_t(Word_Store::DAWG));
+		Word_Dawg(entries).save(w);
+		break;
+	}
+	}
+
+	w.write(input_substr_replacer.data());
+	w.write(output_substr_replacer.data());
+	auto b1 = break_table.start_word_breaks();
+	auto b2 = break_table.end_word_breaks();
+	auto b3 = break_table.middle_word_breaks();
+	w.write_size(b1.size());
+	w.write_size(b2.size());
+	w.write_size(b1.size() + b2.size() + b3.size());
+	for (auto& b : {b1, b2, b3})
+		for (auto& x : b)
+			w.write(x);
+	w.write(ignored_chars);
+	w.write(prefixes);
+	w.write(suffixes);
+	w.write_size(compound_patterns.size());
+	for (auto& p : compound_patterns) {
+		w.write(p.begin_end_chars.str());
+		w.write_size(p.begin_end_chars.idx());
+		w.write(p.replacement);
+		w.write(p.first_word_flag);
+		w.write(p.second_word_flag);
+		w.write(p.match_first_only_unaffixed_or_zero_affixed);
+	}
+	auto r1 = replacements.whole_word_replacements();
+	auto r2 = replacements.start_word_replacements();
+	auto r3 = replacements.end_word_replacements();
+	auto r4 = replacements.any_place_replacements();
+	w.write_size(r1.size());
+	w.write_size(r2.size());
+	w.write_size(r3.size());
+	w.write_size(r1.size() + r2.size() + r3.size() + r4.size());
+	for (auto& r : {r1, r2, r3, r4})
+		for (auto& x : r)
+			w.write(x);
+	w.write_size(similarities.size());
+	for (auto& g : similarities)
+		write_similarity_group(w, g);
+	w.write(keyboard_closeness);
+	w.write(try_chars);
+	w.write(phonetic_table.data());
+
+	w.write(encoding.value());
+	w.write(string(icu_locale.getName()));
+	w.write(uint8_t(flag_type));
+	w.write(complex_prefixes);
+	w.write(fullstrip);
+	w.write(checksharps);
+	w.write(forbid_warn);
+	w.write(circumfix_flag);
+	w.write(forbiddenword_flag);
+	w.write(keepcase_flag);
+	w.write(need_affix_flag);
+	w.write(substandard_flag);
+	w.write(warn_flag);
+	w.write(flag_aliases);
+	w.write(wordchars);
+
+	w.write(nosuggest_flag);
+	w.write(max_compound_suggestions);
+	w.write(max_ngram_suggestions);
+	w.write(max_diff_factor);
+	w.write(only_max_diff);
+	w.write(no_split_suggestions);
+	w.write(suggest_with_dots);
+
+	w.write(compound_min_length);
+	w.write(compound_max_word_count);
+	w.write(compound_flag);
+	w.write(compound_begin_flag);
+	w.write(compound_last_flag);
+	w.write(compound_middle_flag);
+	w.write(compound_onlyin_flag);
+	w.write(compound_permit_flag);
+	w.write(compound_forbid_flag);
+	w.write(compound_root_flag);
+	w.write(compound_force_uppercase);
+	w.write(compound_more_suffixes);
+	w.write(compound_check_duplicate);
+	w.write(compound_check_rep);
+	w.write(compound_check_case);
+	w.write(compound_check_triple);
+	w.write(compound_simplified_triple);
+	w.write(compound_rules.data());
+	w.write(compound_syllable_max);
+	w.write(compound_syllable_vowels);
+	w.write(compound_syllable_num);
+	return bool(out);
+}
+
+/**
+ * @brief Loads data written with save_binary().
+ *
+ * Must be called on default constructed (empty) object. The word store
+ * refers to the data and does not copy it, so the data must outlive this
+ * object and its copies, see Aff_Data::storage. The arrays of the word store
+ * are checked so that corrupted data is rejected, not read out of bounds.
+ *
+ * @param data pointer to the whole content of the binary file, best aligned
+ * to 8 bytes, otherwise the word store is copied.
+ * @param size size of the content in bytes.
+ * @return true on success, false if the data is corrupted, has an
+ * unsupported version or was produced on an incompatible platform.
+ */
+auto Aff_Data::load_binary(const char* data, size_t size) -> bool
+{
+	if (size < sizeof(BINARY_MAGIC) ||
+	    memcmp(data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0)
+		return false;
+	auto r = Binary_Reader(data, size);
+	auto version = uint32_t();
+	auto byte_order_mark = uint32_t();
+	auto wchar_size = uint32_t();
+	r.read_bytes(sizeof(BINARY_MAGIC));
+	r.read(version);
+	r.read(byte_order_mark);
+	r.read(wchar_size);
+	if (!r || version != BINARY_VERSION ||
+	    byte_order_mark != BINARY_BYTE_ORDER_MARK ||
+	    wchar_size != sizeof(wchar_t))
+		return false;
+
+	auto n = r.read_size();
+	if (n > r.bytes_left())
+		return false;
+	auto word_flags = Flag_Set();
+	for (size_t i = 0; i != n && r; ++i) {
+		r.read(word_flags);
+		// the saved sets are distinct and not empty, their handles
+		// are the same as in the saved pool
+		if (words.intern(word_flags) != i + 1)
+			return false;
+	}
+	auto store = uint8_t();
+	r.read(store);
+	if (!r)
+		return false;
+	if (Word_Store(store) == Word_Store::DAWG) {
+		auto dawg = Word_Dawg();
+		if (!dawg.load(r, words.flag_set_pool().size()))
+			return false;
+		words.set_dawg(move(dawg));
 	}
-	return in.eof(); // success if we reached eof
+	else if (Word_Store(store) == Word_Store::PERFECT_HASH) {
+		auto ph = Word_Perfect_Hash();
+		if (!ph.load(r, words.flag_set_pool().size()))
+			return false;
+		words.set_perfect_hash(move(ph));
+	}
+	else {
+		return false;
+	}
+
+	auto tbl_pairs = vector<pair<wstring, wstring>>();
+	r.read(tbl_pairs);
+	input_substr_replacer = move(tbl_pairs);
+	r.read(tbl_pairs);
+	output_substr_replacer = move(tbl_pairs);
+	auto cnt1 = r.read_size();
+	auto cnt2 = r.read_size();
+	auto tbl_str = vector<wstring>();
+	r.read(tbl_str);
+	if (!r)
+		return false;
+	try {
+		break_table.assign_ordered(move(tbl_str), cnt1, cnt2);
+	}
+	catch (const std::out_of_range&) {
+		return false;
+	}
+	r.read(ignored_chars);
+	r.read(prefixes);
+	r.read(suffixes);
+	n = r.read_size();
+	for (size_t i = 0; i != n && r; ++i) {
+		auto p = Compound_Pattern<wchar_t>();
+		auto s = wstring();
+		r.read(s);
+		auto idx = r.read_size();
+		if (!r || idx > s.size())
+			return false;
+		p.begin_end_chars = String_Pair<wchar_t>(move(s), idx);
+		r.read(p.replacement);
+		r.read(p.first_word_flag);
+		r.read(p.second_word_flag);
+		r.read(p.match_first_only_unaffixed_or_zero_affixed);
+		compound_patterns.push_back(move(p));
+	}
+	cnt1 = r.read_size();
+	cnt2 = r.read_size();
+	auto cnt3 = r.read_size();
+	r.read(tbl_pairs);
+	if (!r)
+		return false;
+	try {
+		replacements.assign_ordered(move(tbl_pairs), cnt1, cnt2, cnt3);
+	}
+	catch (const std::out_of_range&) {
+		return false;
+	}
+	n = r.read_size();
+	for (size_t i = 0; i != n && r; ++i) {
+		similarities.emplace_back();
+		read_similarity_group(r, similarities.back());
+	}
+	r.read(keyboard_closeness);
+	r.read(try_chars);
+	tbl_pairs.clear();
+	r.read(tbl_pairs);
+	phonetic_table = move(tbl_pairs);
+
+	auto str = string();
+	r.read(str);
+	encoding = move(str);
+	r.read(str);
+	icu_locale = icu::Locale(str.c_str());
+	auto ft = uint8_t();
+	r.read(ft);
+	if (ft > uint8_t(Flag_Type::UTF8))
+		return false;
+	flag_type = Flag_Type(ft);
+	r.read(complex_prefixes);
+	r.read(fullstrip);
+	r.read(checksharps);
+	r.read(forbid_warn);
+	r.read(circumfix_flag);
+	r.read(forbiddenword_flag);
+	r.read(keepcase_flag);
+	r.read(need_affix_flag);
+	r.read(substandard_flag);
+	r.read(warn_flag);
+	r.read(flag_aliases);
+	r.read(wordchars);
+
+	r.read(nosuggest_flag);
+	r.read(max_compound_suggestions);
+	r.read(max_ngram_suggestions);
+	r.read(max_diff_factor);
+	r.read(only_max_diff);
+	r.read(no_split_suggestions);
+	r.read(suggest_with_dots);
+
+	r.read(compound_min_length);
+	r.read(compound_max_word_count);
+	r.read(compound_flag);
+	r.read(compound_begin_flag);
+	r.read(compound_last_flag);
+	r.read(compound_middle_flag);
+	r.read(compound_onlyin_flag);
+	r.read(compound_permit_flag);
+	r.read(compound_forbid_flag);
+	r.read(compound_root_flag);
+	r.read(compound_force_uppercase);
+	r.read(compound_more_suffixes);
+	r.read(compound_check_duplicate);
+	r.read(compound_check_rep);
+	r.read(compound_check_case);
+	r.read(compound_check_triple);
+	r.read(compound_simplified_triple);
+	auto rules = vector<u16string>();
+	r.read(rules);
+	compound_rules = move(rules);
+	r.read(compound_syllable_max);
+	r.read(compound_syllable_vowels);
+	r.read(compound_syllable_num);
+	update_flag_attributes();
+	return r && r.at_end();
 }
 } // namespace nuspell
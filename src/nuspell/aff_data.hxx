@@ -28,6 +28,9 @@
 #include "structures.hxx"
 
 #include <iosfwd>
+#include <unordered_map>
+
+#include <boost/locale/utf.hpp>
 
 namespace nuspell {
 
@@ -38,31 +41,902 @@ enum class Flag_Type {
 	UTF8 /**< UTF-8 flag, e.g. for "á" */
 };
 
-using Word_List_Base =
-    Hash_Multiset<std::pair<std::string, Flag_Set>, string_view,
-                  member<std::pair<std::string, Flag_Set>, std::string,
-                         &std::pair<std::string, Flag_Set>::first>>;
+/**
+ * @brief Hash function for the word list.
+ *
+ * Words are stored in UTF-8, but looked up with words in the internal wide
+ * encoding. This hashes the UTF-8 bytes and for wide strings it encodes to
+ * UTF-8 on the fly, so both give the same hash without transcoding into a
+ * buffer.
+ */
+struct Word_Hash {
+	using is_transparent = void;
+
+	auto static step(uint64_t h, unsigned char c) noexcept
+	{
+		return (h ^ c) * 0x100000001b3; // FNV-1a
+	}
+	auto static finish(uint64_t h) noexcept
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccd;
+		h ^= h >> 33;
+		return size_t(h);
+	}
+	auto operator()(string_view s) const noexcept
+	{
+		uint64_t h = 0xcbf29ce484222325;
+		for (auto c : s)
+			h = step(h, c);
+		return finish(h);
+	}
+	auto operator()(wstring_view s) const noexcept
+	{
+		using utf8 = boost::locale::utf::utf_traits<char>;
+		using utfw = boost::locale::utf::utf_traits<wchar_t>;
+		uint64_t h = 0xcbf29ce484222325;
+		char buf[utf8::max_width];
+		for (auto it = begin(s), last = end(s); it != last;) {
+			if (*it < 0x80) {
+				h = step(h, *it++);
+				continue;
+			}
+			auto cp = utfw::decode_valid(it);
+			auto buf_end = utf8::encode(cp, buf);
+			for (auto p = buf; p != buf_end; ++p)
+				h = step(h, *p);
+		}
+		return finish(h);
+	}
+};
+
+/**
+ * @brief Equality for the word list, complement of Word_Hash.
+ */
+struct Word_Equal {
+	using is_transparent = void;
+
+	auto operator()(string_view a, string_view b) const noexcept
+	{
+		return a == b;
+	}
+	auto operator()(wstring_view a, string_view b) const noexcept
+	{
+		using utf8 = boost::locale::utf::utf_traits<char>;
+		using utfw = boost::locale::utf::utf_traits<wchar_t>;
+		if (b.size() < a.size() ||
+		    b.size() > a.size() * utf8::max_width)
+			return false;
+		auto j = begin(b);
+		auto b_last = end(b);
+		char buf[utf8::max_width];
+		for (auto it = begin(a), last = end(a); it != last;) {
+			if (*it < 0x80) {
+				if (j == b_last || *j != char(*it))
+					return false;
+				++it;
+				++j;
+				continue;
+			}
+			auto cp = utfw::decode_valid(it);
+			auto buf_end = utf8::encode(cp, buf);
+			auto n = buf_end - buf;
+			if (b_last - j < n || !std::equal(buf, buf_end, j))
+				return false;
+			j += n;
+		}
+		return j == b_last;
+	}
+};
+
+/**
+ * @brief Deduplicated storage of the flag sets of the words.
+ *
+ * Many words have the same flags, with flag aliases (AF) nearly all of them
+ * do, so each distinct set is stored once and a word refers to it with a
+ * 32-bit handle. Handle 0 is the empty set.
+ *
+ * For each set the pool also stores which of the special flags it contains,
+ * see Flag_Attribute, so checking them is a single bit test. The special
+ * flags must be given with set_attribute_flags(), usually through
+ * Aff_Data::update_flag_attributes().
+ */
+class Flag_Set_Pool {
+      public:
+	using Handle = uint32_t;
+
+      private:
+	std::vector<Flag_Set> sets = std::vector<Flag_Set>(1);
+	mutable std::vector<Flag_Attributes> attrs =
+	    std::vector<Flag_Attributes>(1);
+	std::unordered_map<std::u16string, Handle> index;
+	mutable Special_Flags special_flags;
+
+      public:
+	auto insert(const Flag_Set& flags) -> Handle;
+	auto operator[](Handle h) const -> const Flag_Set& { return sets[h]; }
+	auto attributes(Handle h) const { return attrs[h]; }
+	auto size() const { return sets.size(); }
+	auto set_attribute_flags(const Special_Flags& sf) const -> void;
+	auto attribute_flags() const -> const Special_Flags&
+	{
+		return special_flags;
+	}
+};
+
+/**
+ * @brief Append-only storage of many small strings in few large blocks.
+ *
+ * Stored strings never move, the views returned by store() are valid until
+ * the arena is destroyed. Moving the arena keeps them valid too. On Linux,
+ * blocks of 2 MiB or more are backed by transparent huge pages if the
+ * system allows it.
+ */
+class String_Arena {
+	struct Block_Deleter {
+		auto operator()(char* p) const -> void;
+	};
+	struct Block {
+		std::unique_ptr<char[], Block_Deleter> data;
+		size_t size = 0;
+		size_t used = 0;
+	};
+	std::vector<Block> blocks;
+	string_view last;
+
+	auto add_block(size_t n) -> void;
+
+      public:
+	auto reserve(size_t n) -> void;
+	auto store(string_view s) -> string_view;
+};
+
+/**
+ * @brief Read-only array that owns its elements or borrows them.
+ *
+ * The word stores that do not change after they are built keep their data
+ * in these arrays. Built in memory, the array owns a vector. Loaded from a
+ * binary file, the array points into the memory of the file and the owner of
+ * that memory must outlive the array and all its copies.
+ */
+template <class T>
+class Flat_Array {
+	std::vector<T> own;
+	const T* ptr = nullptr;
+	size_t sz = 0;
+
+      public:
+	Flat_Array() = default;
+	Flat_Array(std::vector<T>&& v)
+	    : own(std::move(v)), ptr(own.data()), sz(own.size())
+	{
+	}
+	Flat_Array(const T* data, size_t n) : ptr(data), sz(n) {}
+	Flat_Array(const Flat_Array& other)
+	    : own(other.own),
+	      ptr(other.is_borrowed() ? other.ptr : own.data()), sz(other.sz)
+	{
+	}
+	Flat_Array(Flat_Array&& other) noexcept
+	    : own(std::move(other.own)), ptr(other.ptr), sz(other.sz)
+	{
+		other.ptr = nullptr;
+		other.sz = 0;
+	}
+	auto operator=(Flat_Array other) noexcept -> Flat_Array&
+	{
+		own.swap(other.own);
+		std::swap(ptr, other.ptr);
+		std::swap(sz, other.sz);
+		return *this;
+	}
+
+	auto is_borrowed() const { return ptr != own.data(); }
+	auto data() const { return ptr; }
+	auto size() const { return sz; }
+	auto empty() const { return sz == 0; }
+	auto begin() const { return ptr; }
+	auto end() const { return ptr + sz; }
+	auto& operator[](size_t i) const { return ptr[i]; }
+};
+
+/**
+ * @brief Word store as a minimal acyclic automaton (DAWG).
+ *
+ * The automaton works on the UTF-8 bytes of the words. Words with a common
+ * prefix share the path from the root and, because the automaton is
+ * minimal, words with a common suffix share the path to the end. It takes
+ * much less memory than the hash table, but lookups are slower.
+ *
+ * Words are numbered in lexicographical order of their bytes and the
+ * handles of their flags are stored in that order, homonyms next to each
+ * other. Each arc knows how many words are below the state before the arc,
+ * so the number of a word is summed while walking its path. Thus
+ * equal_range() returns a range of handles and each word has a stable
+ * address, like with the hash table.
+ */
+class Word_Dawg {
+      public:
+	using Handle = Flag_Set_Pool::Handle;
+
+      private:
+	struct State {
+		uint32_t first_arc = 0;
+		uint32_t final_count = 0; // number of homonyms ending here
+	};
+	Flat_Array<State> states; // with sentinel at the end
+	Flat_Array<unsigned char> labels;
+	Flat_Array<uint32_t> targets;
+	Flat_Array<uint32_t> skips; // words before the target of an arc
+	Flat_Array<Handle> vals;
+	uint32_t root = 0;
+
+	auto find_arc(uint32_t s, unsigned char c) const -> size_t;
+
+	template <class Func>
+	auto for_each_in(uint32_t s, size_t idx, size_t idx_end, size_t first,
+	                 size_t last, std::string& word, Func& f) const -> void
+	{
+		auto fc = states[s].final_count;
+		if (fc && idx + fc > first && idx < last)
+			f(string_view(word), &vals[std::max(idx, first)],
+			  &vals[std::min(idx + fc, last)]);
+		auto a_end = states[s + 1].first_arc;
+		for (auto a = states[s].first_arc; a != a_end; ++a) {
+			auto child = idx + skips[a];
+			auto child_end =
+			    a + 1 != a_end ? idx + skips[a + 1] : idx_end;
+			if (child >= last)
+				break;
+			if (child_end <= first)
+				continue;
+			word.push_back(labels[a]);
+			for_each_in(targets[a], child, child_end, first, last,
+			            word, f);
+			word.pop_back();
+		}
+	}
+
+      public:
+	Word_Dawg() = default;
+	/**
+	 * @brief Builds the automaton.
+	 *
+	 * @param words sorted by the word, homonyms keep their order.
+	 */
+	explicit Word_Dawg(
+	    const std::vector<std::pair<string_view, Handle>>& words);
+
+	auto size() const { return vals.size(); }
+	auto empty() const { return size() == 0; }
+	auto state_count() const
+	{
+		return states.empty() ? size_t(0) : states.size() - 1;
+	}
+	auto arc_count() const { return labels.size(); }
+
+	/**
+	 * @brief Writes the arrays with w.write_array() and the root.
+	 */
+	template <class Writer>
+	auto save(Writer& w) const -> void
+	{
+		w.write_array(states);
+		w.write_array(labels);
+		w.write_array(targets);
+		w.write_array(skips);
+		w.write_array(vals);
+		w.write(root);
+	}
+	/**
+	 * @brief Reads the arrays written by save(), complement of it.
+	 *
+	 * @param handle_count handles in the store must be less than it.
+	 * @return false if the arrays do not form a valid automaton, see
+	 * is_valid().
+	 */
+	template <class Reader>
+	auto load(Reader& r, size_t handle_count) -> bool
+	{
+		r.read_array(states);
+		r.read_array(labels);
+		r.read_array(targets);
+		r.read_array(skips);
+		r.read_array(vals);
+		r.read(root);
+		return r && is_valid(handle_count);
+	}
+	auto is_valid(size_t handle_count) const -> bool;
+
+	auto equal_range(string_view word) const
+	    -> std::pair<const Handle*, const Handle*>;
+	auto equal_range(wstring_view word) const
+	    -> std::pair<const Handle*, const Handle*>;
+
+	/**
+	 * @brief Returns the number of the word, i.e. its lexicographical
+	 * position, of a handle returned by equal_range().
+	 */
+	auto index_of(const Handle& h) const -> size_t
+	{
+		return &h - vals.data();
+	}
+	auto word_at(size_t i) const -> std::string;
+
+	/**
+	 * @brief Calls f(word, first, last) for the words with numbers in
+	 * [first_word, last_word), in lexicographical order.
+	 *
+	 * [first, last) are the handles of the homonyms.
+	 */
+	template <class Func>
+	auto for_each_in_range(size_t first_word, size_t last_word,
+	                       Func f) const -> void
+	{
+		if (empty())
+			return;
+		auto word = std::string();
+		for_each_in(root, 0, size(), first_word, last_word, word, f);
+	}
+	template <class Func>
+	auto for_each(Func f) const -> void
+	{
+		for_each_in_range(0, size(), f);
+	}
+
+	/**
+	 * @brief Calls f(word, first, last) for the words that start with
+	 * prefix, in lexicographical order.
+	 */
+	template <class Func>
+	auto for_each_with_prefix(string_view prefix, Func f) const -> void
+	{
+		if (empty())
+			return;
+		auto s = root;
+		size_t idx = 0;
+		size_t idx_end = size();
+		for (auto c : prefix) {
+			auto a = find_arc(s, c);
+			if (a == size_t(-1))
+				return;
+			if (a + 1 != states[s + 1].first_arc)
+				idx_end = idx + skips[a + 1];
+			idx += skips[a];
+			s = targets[a];
+		}
+		auto word = std::string(prefix);
+		for_each_in(s, idx, idx_end, idx, idx_end, word, f);
+	}
+};
+
+/**
+ * @brief Word store with a minimal perfect hash function.
+ *
+ * The distinct words are mapped one to one to the slots [0, word_count())
+ * with a hash-and-displace function (CHD/PTHash style). The words are
+ * split into buckets by their Word_Hash, and each bucket gets a pilot, a
+ * number mixed into the hash of its words, so that all words land in free
+ * slots. A lookup hashes the key, reads the pilot of its bucket and compares
+ * the key with the one word in the computed slot, there is no probing.
+ *
+ * The pilots take about one byte per word. The bytes of the words and the
+ * handles of their flags are stored in slot order, homonyms next to each
+ * other, so equal_range() returns a range of handles with stable addresses.
+ *
+ * Finding the pilots is the slow part. They can be saved and given back to
+ * build() later, which then only checks them.
+ */
+class Word_Perfect_Hash {
+      public:
+	using Handle = Flag_Set_Pool::Handle;
+
+      private:
+	Flat_Array<uint32_t> pilots;
+	Flat_Array<char> chars;
+	Flat_Array<uint32_t> word_ends = std::vector<uint32_t>(1);
+	Flat_Array<uint32_t> val_ends = std::vector<uint32_t>(1);
+	Flat_Array<Handle> vals;
+
+	auto static bucket_count(size_t n) { return (n + 3) / 4; }
+	auto static slot_of(size_t h, uint32_t pilot, size_t n) -> size_t
+	{
+		uint64_t x = h ^ (uint64_t(pilot) * 0x9e3779b97f4a7c15);
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccd;
+		x ^= x >> 33;
+		return x % n;
+	}
+	auto bucket_of(size_t h) const { return h % pilots.size(); }
+	auto slot_of(size_t h) const
+	{
+		return slot_of(h, pilots[bucket_of(h)], word_ends.size() - 1);
+	}
+	auto fill(const std::vector<std::pair<string_view, Handle>>& words,
+	          const std::vector<size_t>& firsts,
+	          const std::vector<size_t>& order) -> void;
+
+      public:
+	/**
+	 * @brief Builds the hash function, finds the pilots.
+	 *
+	 * @param words homonyms must be next to each other.
+	 * @return false in the practically impossible case that two distinct
+	 * words have the same Word_Hash, the store is then left empty.
+	 */
+	auto build(const std::vector<std::pair<string_view, Handle>>& words)
+	    -> bool;
+	/**
+	 * @brief Builds the store with pilots from a previous build().
+	 *
+	 * @param words in the order given by for_each() of the previous store.
+	 * @param p the pilots of the previous store.
+	 * @return false if the pilots do not fit the words.
+	 */
+	auto build(const std::vector<std::pair<string_view, Handle>>& words,
+	           std::vector<uint32_t> p) -> bool;
+
+	auto size() const { return vals.size(); }
+	auto empty() const { return size() == 0; }
+	auto word_count() const { return word_ends.size() - 1; }
+	auto pilot_data() const
+	{
+		return std::vector<uint32_t>(pilots.begin(), pilots.end());
+	}
+
+	/**
+	 * @brief Writes the arrays with w.write_array().
+	 */
+	template <class Writer>
+	auto save(Writer& w) const -> void
+	{
+		w.write_array(pilots);
+		w.write_array(chars);
+		w.write_array(word_ends);
+		w.write_array(val_ends);
+		w.write_array(vals);
+	}
+	/**
+	 * @brief Reads the arrays written by save(), complement of it.
+	 *
+	 * @param handle_count handles in the store must be less than it.
+	 * @return false if the arrays do not form a valid store, see
+	 * is_valid().
+	 */
+	template <class Reader>
+	auto load(Reader& r, size_t handle_count) -> bool
+	{
+		r.read_array(pilots);
+		r.read_array(chars);
+		r.read_array(word_ends);
+		r.read_array(val_ends);
+		r.read_array(vals);
+		return r && is_valid(handle_count);
+	}
+	auto is_valid(size_t handle_count) const -> bool;
+
+	template <class K>
+	auto equal_range(const K& word) const
+	    -> std::pair<const Handle*, const Handle*>
+	{
+		if (empty())
+			return {};
+		auto i = slot_of(Word_Hash()(word));
+		if (!Word_Equal()(word, word_at(i)))
+			return {};
+		auto p = vals.data();
+		return {p + val_ends[i], p + val_ends[i + 1]};
+	}
+	/**
+	 * @brief Hints the CPU to load the pilot for a word with the
+	 * Word_Hash h.
+	 */
+	auto prefetch(size_t h) const -> void
+	{
+		if (!empty())
+			prefetch_memory(&pilots[bucket_of(h)]);
+	}
+	/**
+	 * @brief Hints the CPU to load the slot for a word with the
+	 * Word_Hash h, reads the pilot loaded by prefetch().
+	 */
+	auto prefetch_word(size_t h) const -> void
+	{
+		if (empty())
+			return;
+		auto i = slot_of(h);
+		prefetch_memory(&word_ends[i]);
+		prefetch_memory(&val_ends[i]);
+	}
+
+	/**
+	 * @brief Returns the slot of the word of a handle returned by
+	 * equal_range().
+	 */
+	auto slot_of_handle(const Handle& h) const -> size_t;
+	auto word_at(size_t i) const
+	{
+		return string_view(chars.data() + word_ends[i],
+		                   word_ends[i + 1] - word_ends[i]);
+	}
+
+	/**
+	 * @brief Calls f(word, first, last) for the words in the slots
+	 * [first_slot, last_slot).
+	 *
+	 * [first, last) are the handles of the homonyms.
+	 */
+	template <class Func>
+	auto for_each_in_range(size_t first_slot, size_t last_slot,
+	                       Func f) const -> void
+	{
+		auto p = vals.data();
+		for (auto i = first_slot; i != last_slot; ++i)
+			f(word_at(i), p + val_ends[i], p + val_ends[i + 1]);
+	}
+	template <class Func>
+	auto for_each(Func f) const -> void
+	{
+		for_each_in_range(0, word_count(), f);
+	}
+};
+
+/**
+ * @brief Entry of the hash table of Word_List.
+ *
+ * The handle of the flags is the first member, so a reference to it can be
+ * converted back to the entry.
+ */
+struct Word_List_Entry {
+	Flag_Set_Pool::Handle flags = 0;
+	uint32_t size = 0;
+	const char* data = nullptr;
+
+	auto word() const { return string_view(data, size); }
+};
+struct Word_List_Entry_Key {
+	auto operator()(const Word_List_Entry& e) const { return e.word(); }
+};
+using Word_List_Table =
+    Hash_Multiset<Word_List_Entry, string_view, Word_List_Entry_Key,
+                  Word_Hash, Word_Equal>;
+
+/**
+ * @brief Hash table of words with the handles of their flags.
+ *
+ * The bytes of the words are packed in a String_Arena owned by the table.
+ * Copying the table copies the bytes too.
+ */
+class Word_Table {
+	Word_List_Table table;
+	String_Arena arena;
+
+      public:
+	Word_Table() = default;
+	Word_Table(const Word_Table& other);
+	Word_Table(Word_Table&& other) = default;
+	auto operator=(const Word_Table& other) -> Word_Table&;
+	auto operator=(Word_Table&& other) -> Word_Table& = default;
+
+	auto size() const { return table.size(); }
+	auto empty() const { return table.empty(); }
+	auto reserve(size_t n) { table.reserve(n); }
+	/**
+	 * @brief Makes room for words with total length of n bytes in one
+	 * block.
+	 */
+	auto reserve_bytes(size_t n) { arena.reserve(n); }
+	auto emplace(string_view word, Flag_Set_Pool::Handle flags)
+	{
+		auto w = arena.store(word);
+		return table.insert({flags, uint32_t(w.size()), w.data()});
+	}
+	template <class K>
+	auto equal_range(const K& key) const
+	{
+		return table.equal_range(key);
+	}
+	auto prefetch(size_t h) const { table.prefetch(h); }
+	auto prefetch_word(size_t h) const
+	{
+		auto e = table.candidate(h);
+		if (e)
+			prefetch_memory(e->word().data());
+	}
+	template <class Func>
+	auto for_each(Func f) const
+	{
+		table.for_each(f);
+	}
+	template <class Func>
+	auto for_each_in_slots(size_t first, size_t last, Func f) const
+	{
+		table.for_each_in_slots(first, last, f);
+	}
+	auto slot_count() const { return table.slot_count(); }
+};
+
+enum class Word_Store {
+	HASH_TABLE /**< fast lookups, the default */,
+	DAWG /**< minimal automaton, less memory, see Word_Dawg */,
+	PERFECT_HASH /**< single-probe lookups, for words that do not change,
+	                see Word_Perfect_Hash */
+};
+
 /**
  * @brief Map between words and word_flags.
  *
- * Flags are stored as part of the container. Maybe for the future flags should
- * be stored elsewhere (flag aliases) and this should store pointers.
+ * The flags are interned in a Flag_Set_Pool owned by the list. The words
+ * are kept in one of the stores, see Word_Store.
+ *
+ * The elements of the list are the handles, their addresses are stable as
+ * long as the list is not modified. Use flags(), attributes() and word() to
+ * get the data of an element.
  *
  * Does not store morphological data as is low priority feature and is out of
  * scope.
+ *
+ * Words are stored in UTF-8 and can be looked up directly with wide strings,
+ * see Word_Hash.
  */
-class Word_List : public Word_List_Base {
+class Word_List {
       public:
-	using Word_List_Base::equal_range;
-	auto equal_range(const std::wstring& word) const
-	    -> std::pair<Word_List_Base::local_const_iterator,
-	                 Word_List_Base::local_const_iterator>;
+	using value_type = Flag_Set_Pool::Handle;
+	using size_type = std::size_t;
+	using const_reference = const value_type&;
+	using const_pointer = const value_type*;
+
+	/**
+	 * @brief Iterator over the homonyms returned by equal_range().
+	 */
+	class const_iterator {
+	      public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Flag_Set_Pool::Handle;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+	      private:
+		const Word_List_Entry* entry = nullptr;
+		const value_type* value = nullptr;
+
+	      public:
+		const_iterator() = default;
+		const_iterator(const Word_List_Entry* e) : entry(e) {}
+		const_iterator(const value_type* v) : value(v) {}
+
+		auto& operator*() const
+		{
+			return entry ? entry->flags : *value;
+		}
+		auto operator->() const { return &**this; }
+		auto& operator++()
+		{
+			if (entry)
+				++entry;
+			else
+				++value;
+			return *this;
+		}
+		auto operator++(int)
+		{
+			auto tmp = *this;
+			++*this;
+			return tmp;
+		}
+		auto operator==(const const_iterator& other) const
+		{
+			return entry == other.entry && value == other.value;
+		}
+		auto operator!=(const const_iterator& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+      private:
+	Word_Table table;
+	Word_Dawg dawg;
+	Word_Perfect_Hash perfect_hash;
+	Flag_Set_Pool flag_sets;
+	Word_Store store = Word_Store::HASH_TABLE;
+
+	static auto& entry_of(const_reference e)
+	{
+		return reinterpret_cast<const Word_List_Entry&>(e);
+	}
+
+      public:
+	auto size() const
+	{
+		switch (store) {
+		case Word_Store::DAWG:
+			return dawg.size();
+		case Word_Store::PERFECT_HASH:
+			return perfect_hash.size();
+		default:
+			return table.size();
+		}
+	}
+	auto empty() const { return size() == 0; }
+	auto word_store() const { return store; }
+	auto set_word_store(Word_Store s) -> void;
+	auto table_store() const -> const Word_Table& { return table; }
+	auto dawg_store() const -> const Word_Dawg& { return dawg; }
+	auto perfect_hash_store() const -> const Word_Perfect_Hash&
+	{
+		return perfect_hash;
+	}
+	auto set_dawg(Word_Dawg&& d) -> void;
+	auto set_perfect_hash(Word_Perfect_Hash&& ph) -> void;
+
+	auto reserve(size_t n) -> void
+	{
+		if (store == Word_Store::HASH_TABLE)
+			table.reserve(n);
+	}
+	/**
+	 * @brief Makes room for words with total length of n bytes in one
+	 * block.
+	 */
+	auto reserve_bytes(size_t n) -> void
+	{
+		if (store == Word_Store::HASH_TABLE)
+			table.reserve_bytes(n);
+	}
+
+	/**
+	 * @brief Adds a word. The list is switched to the hash table first.
+	 */
+	auto emplace(string_view word, Flag_Set_Pool::Handle flags)
+	    -> const_pointer;
+	auto emplace(string_view word, const Flag_Set& flags)
+	{
+		return emplace(word, flag_sets.insert(flags));
+	}
+	auto insert(const std::pair<string_view, Flag_Set>& word_flags)
+	{
+		return emplace(word_flags.first, word_flags.second);
+	}
+
+	template <class K>
+	auto equal_range(const K& key) const
+	    -> std::pair<const_iterator, const_iterator>
+	{
+		switch (store) {
+		case Word_Store::DAWG:
+			return dawg.equal_range(key);
+		case Word_Store::PERFECT_HASH:
+			return perfect_hash.equal_range(key);
+		default:
+			return table.equal_range(key);
+		}
+	}
+
+	/**
+	 * @brief Hints the CPU to load the memory where a word with the
+	 * Word_Hash h would be.
+	 *
+	 * Issuing this for several words before looking any of them up lets
+	 * the cache misses overlap. The DAWG has no such hint.
+	 */
+	auto prefetch(size_t h) const -> void
+	{
+		if (store == Word_Store::HASH_TABLE)
+			table.prefetch(h);
+		else if (store == Word_Store::PERFECT_HASH)
+			perfect_hash.prefetch(h);
+	}
+	/**
+	 * @brief Hints the CPU to load the memory that a lookup reads after
+	 * the one loaded by prefetch() with the same h.
+	 *
+	 * It reads that memory, so it is best called for a group of words
+	 * after prefetch() was called for all of them.
+	 */
+	auto prefetch_word(size_t h) const -> void
+	{
+		if (store == Word_Store::HASH_TABLE)
+			table.prefetch_word(h);
+		else if (store == Word_Store::PERFECT_HASH)
+			perfect_hash.prefetch_word(h);
+	}
+
+	/**
+	 * @brief Calls f(word, entry) for each element.
+	 *
+	 * With the DAWG the words come in lexicographical order. In all
+	 * stores homonyms come one after another.
+	 */
+	template <class Func>
+	auto for_each(Func f) const -> void
+	{
+		for_each_in_slots(0, slot_count(), f);
+	}
+
+	/**
+	 * @brief Calls f(word, entry) for the elements in the slots [first,
+	 * last).
+	 *
+	 * Splitting [0, slot_count()) in ranges allows the list to be scanned
+	 * in parallel. Elements are visited in the order of their addresses.
+	 * In the DAWG a slot is a word number, in the perfect hash it holds
+	 * a word with its homonyms.
+	 */
+	template <class Func>
+	auto for_each_in_slots(size_t first, size_t last, Func f) const
+	    -> void
+	{
+		if (store == Word_Store::HASH_TABLE) {
+			table.for_each_in_slots(first, last, [&](auto& e) {
+				f(e.word(), e.flags);
+			});
+			return;
+		}
+		auto g = [&](string_view w, auto vfirst, auto vlast) {
+			for (; vfirst != vlast; ++vfirst)
+				f(w, *vfirst);
+		};
+		if (store == Word_Store::DAWG)
+			dawg.for_each_in_range(first, last, g);
+		else
+			perfect_hash.for_each_in_range(first, last, g);
+	}
+	auto slot_count() const
+	{
+		switch (store) {
+		case Word_Store::DAWG:
+			return dawg.size();
+		case Word_Store::PERFECT_HASH:
+			return perfect_hash.word_count();
+		default:
+			return table.slot_count();
+		}
+	}
+
+	auto word(const_reference word_entry) const -> std::string
+	{
+		switch (store) {
+		case Word_Store::DAWG:
+			return dawg.word_at(dawg.index_of(word_entry));
+		case Word_Store::PERFECT_HASH:
+			return std::string(perfect_hash.word_at(
+			    perfect_hash.slot_of_handle(word_entry)));
+		default:
+			return std::string(entry_of(word_entry).word());
+		}
+	}
+	/**
+	 * @brief Replaces the flags of an element, the word stays.
+	 *
+	 * Only for the hash table, the other stores may be read-only.
+	 */
+	auto set_flags(const_reference word_entry, Flag_Set_Pool::Handle h)
+	{
+		const_cast<value_type&>(word_entry) = h;
+	}
+	auto intern(const Flag_Set& flags) { return flag_sets.insert(flags); }
+	auto flags(const_reference word_entry) const -> const Flag_Set&
+	{
+		return flag_sets[word_entry];
+	}
+	auto attributes(const_reference word_entry) const
+	{
+		return flag_sets.attributes(word_entry);
+	}
+	auto flag_set_pool() const -> const Flag_Set_Pool& { return flag_sets; }
+	auto flag_set_pool() -> Flag_Set_Pool& { return flag_sets; }
 };
 
 struct Aff_Data {
 	// data members
 	// word list
 	Word_List words;
+	// affixed forms of the words, empty unless expanded
+	Word_Table word_forms;
+	// owner of the memory that the word store borrows, see load_binary()
+	std::shared_ptr<const void> storage;
 
 	Substr_Replacer<wchar_t> input_substr_replacer;
 	Substr_Replacer<wchar_t> output_substr_replacer;
@@ -132,12 +1006,24 @@ struct Aff_Data {
 	// methods
 	auto parse_aff(std::istream& in) -> bool;
 	auto parse_dic(std::istream& in) -> bool;
+	auto parse_aff(string_view in) -> bool;
+	auto parse_dic(string_view in) -> bool;
 	auto parse_aff_dic(std::istream& aff, std::istream& dic)
 	{
 		if (parse_aff(aff))
 			return parse_dic(dic);
 		return false;
 	}
+	auto parse_aff_dic(string_view aff, string_view dic)
+	{
+		if (parse_aff(aff))
+			return parse_dic(dic);
+		return false;
+	}
+	auto save_binary(std::ostream& out) const -> bool;
+	auto load_binary(const char* data, size_t size) -> bool;
+	auto special_flags() const -> Special_Flags;
+	auto update_flag_attributes() const -> void;
 };
 } // namespace nuspell
 
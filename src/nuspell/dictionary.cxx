@@ -19,12 +19,24 @@
 #include "dictionary.hxx"
 #include "string_utils.hxx"
 
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
 
 #include <unicode/uchar.h>
 
+#if !defined(_WIN32) && (defined(__unix__) || defined(__unix) ||               \
+                         (defined(__APPLE__) && defined(__MACH__)))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NUSPELL_HAVE_MMAP 1
+#endif
+
 namespace nuspell {
 
 #ifdef __GNUC__
@@ -60,6 +72,15 @@ class At_Scope_Exit {
 
 #define AT_SCOPE_EXIT(...) ASE_INTERNAL2(__COUNTER__, __VA_ARGS__)
 
+/**
+ * @brief Gets the temporaries of the calling thread.
+ */
+auto Spell_Scratch::of_this_thread() -> Spell_Scratch&
+{
+	auto static thread_local s = Spell_Scratch();
+	return s;
+}
+
 /**
  * @brief Check spelling for a word.
  *
@@ -92,9 +113,7 @@ auto Dict_Base::spell_priv(std::wstring& s) const -> bool
 	erase_chars(s, ignored_chars);
 
 	// handle break patterns
-	auto copy = s;
 	auto ret = spell_break(s);
-	assert(s == copy);
 	if (!ret && abbreviation) {
 		s += '.';
 		ret = spell_break(s);
@@ -103,66 +122,160 @@ auto Dict_Base::spell_priv(std::wstring& s) const -> bool
 }
 
 /**
- * @brief Checks recursively the spelling according to break patterns.
+ * @brief Gets the sub-result of a part of the word, inserts it if missing.
+ *
+ * The returned reference is valid until the next insertion.
+ *
+ * @param begin start of the part in the word.
+ * @param end end of the part in the word.
+ * @return The entry of the part.
+ */
+auto Break_Memo::part(size_t begin, size_t end) -> Entry&
+{
+	auto key = begin * (word.size() + 1) + end;
+	auto mask = parts->size() - 1;
+	auto i = size_t(uint64_t(key) * 0x9E3779B97F4A7C15u >> 32) & mask;
+	for (;; i = (i + 1) & mask) {
+		auto& x = (*parts)[i];
+		if (x.key == key)
+			return x;
+		if (x.key == Entry().key)
+			break;
+	}
+	if (2 * (num_parts + 1) <= parts->size()) {
+		++num_parts;
+		auto& x = (*parts)[i];
+		x.key = key;
+		return x;
+	}
+	// grow the table and insert again
+	Scratch_Pool<Storage>::Ref old(pool);
+	old->swap(*parts);
+	parts->resize(old->size() * 2);
+	num_parts = 0;
+	for (auto& x : *old) {
+		if (x.key == Entry().key)
+			continue;
+		auto b = x.key / (word.size() + 1);
+		part(b, x.key - b * (word.size() + 1)) = x;
+	}
+	return part(begin, end);
+}
+
+/**
+ * @brief Checks the spelling according to break patterns.
+ *
+ * The word is split recursively at the break patterns. The parts are
+ * handled as ranges of the word and their results are stored in a
+ * Break_Memo, so each part is checked at most once.
  *
  * @param s string to check spelling for.
  * @return The spelling result.
  */
-auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
+auto Dict_Base::spell_break(std::wstring& s) const -> bool
 {
 	// check spelling accoring to case
 	auto res = spell_casing(s);
 	if (res) {
 		// handle forbidden words
-		if (res->contains(forbiddenword_flag)) {
+		if (words.attributes(*res) & FORBIDDEN_WORD_ATTR) {
 			return false;
 		}
-		if (forbid_warn && res->contains(warn_flag)) {
+		if (forbid_warn && words.attributes(*res) & WARN_ATTR) {
 			return false;
 		}
 		return true;
 	}
+	if (break_table.start_word_breaks().empty() &&
+	    break_table.end_word_breaks().empty() &&
+	    break_table.middle_word_breaks().empty())
+		return false;
+
+	auto& scratch = Spell_Scratch::of_this_thread();
+	Break_Memo memo(s, scratch.break_memos, scratch.strings);
+	memo.part(0, s.size()).casing = Break_Memo::NOT_FOUND;
+	return spell_break(memo, 0, s.size(), 0);
+}
+
+/**
+ * @brief Checks recursively the spelling of a part according to break
+ * patterns.
+ *
+ * @param memo the word and the results of its parts.
+ * @param begin start of the part in the word.
+ * @param end end of the part in the word.
+ * @param depth number of middle breaks above this part.
+ * @return The spelling result.
+ */
+auto Dict_Base::spell_break(Break_Memo& memo, size_t begin, size_t end,
+                            size_t depth) const -> bool
+{
+	auto& word = memo.word;
+	auto& entry = memo.part(begin, end);
+	// entry is valid only until the recursive calls below
+	if (entry.casing == Break_Memo::UNKNOWN) {
+		auto& part = *memo.part_str;
+		part.assign(word, begin, end - begin);
+		auto res = spell_casing(part);
+		if (!res)
+			entry.casing = Break_Memo::NOT_FOUND;
+		else if (words.attributes(*res) & FORBIDDEN_WORD_ATTR)
+			entry.casing = Break_Memo::BAD;
+		else if (forbid_warn && words.attributes(*res) & WARN_ATTR)
+			entry.casing = Break_Memo::BAD;
+		else
+			entry.casing = Break_Memo::GOOD;
+	}
+	if (entry.casing != Break_Memo::NOT_FOUND)
+		return entry.casing == Break_Memo::GOOD;
 	if (depth == 9)
 		return false;
+	if (int(depth) <= entry.splits_up_to)
+		return true;
+	if (int(depth) >= entry.fails_from)
+		return false;
 
-	// handle break pattern at start of a word
-	for (auto& pat : break_table.start_word_breaks()) {
-		if (s.compare(0, pat.size(), pat) == 0) {
-			auto substr = s.substr(pat.size());
-			auto res = spell_break(substr);
-			if (res)
-				return res;
+	auto ret = [&]() {
+		// handle break pattern at start of a word
+		for (auto& pat : break_table.start_word_breaks()) {
+			if (pat.size() > end - begin)
+				continue;
+			if (word.compare(begin, pat.size(), pat) == 0 &&
+			    spell_break(memo, begin + pat.size(), end, 0))
+				return true;
 		}
-	}
 
-	// handle break pattern at end of a word
-	for (auto& pat : break_table.end_word_breaks()) {
-		if (pat.size() > s.size())
-			continue;
-		if (s.compare(s.size() - pat.size(), pat.size(), pat) == 0) {
-			auto substr = s.substr(0, s.size() - pat.size());
-			auto res = spell_break(substr);
-			if (res)
-				return res;
+		// handle break pattern at end of a word
+		for (auto& pat : break_table.end_word_breaks()) {
+			if (pat.size() > end - begin)
+				continue;
+			auto first = end - pat.size();
+			if (word.compare(first, pat.size(), pat) == 0 &&
+			    spell_break(memo, begin, first, 0))
+				return true;
 		}
-	}
 
-	// handle break pattern in middle of a word
-	for (auto& pat : break_table.middle_word_breaks()) {
-		auto i = s.find(pat);
-		if (i > 0 && i < s.size() - pat.size()) {
-			auto part1 = s.substr(0, i);
-			auto part2 = s.substr(i + pat.size());
-			auto res1 = spell_break(part1, depth + 1);
-			if (!res1)
+		// handle break pattern in middle of a word, only the first
+		// occurrence in the part is tried
+		for (auto& pat : break_table.middle_word_breaks()) {
+			auto i = word.find(pat, begin);
+			if (i == word.npos || i == begin ||
+			    i + pat.size() >= end)
 				continue;
-			auto res2 = spell_break(part2, depth + 1);
-			if (res2)
-				return res2;
+			if (spell_break(memo, begin, i, depth + 1) &&
+			    spell_break(memo, i + pat.size(), end, depth + 1))
+				return true;
 		}
-	}
-
-	return false;
+		return false;
+	}();
+	auto& entry2 = memo.part(begin, end);
+	if (ret)
+		entry2.splits_up_to = std::max(entry2.splits_up_to,
+		                               static_cast<signed char>(depth));
+	else
+		entry2.fails_from = std::min(entry2.fails_from,
+		                             static_cast<signed char>(depth));
+	return ret;
 }
 
 /**
@@ -171,10 +284,12 @@ auto Dict_Base::spell_break(std::wstring& s, size_t depth) const -> bool
  * @param s string to check spelling for.
  * @return The spelling result.
  */
-auto Dict_Base::spell_casing(std::wstring& s) const -> const Flag_Set*
+auto Dict_Base::spell_casing(std::wstring& s) const
+    -> Word_List::const_pointer
 {
-	auto casing_type = classify_casing(s);
-	const Flag_Set* res = nullptr;
+	auto counts = Casing_Counts();
+	auto casing_type = classify_casing(s, counts);
+	auto res = Word_List::const_pointer();
 
 	switch (casing_type) {
 	case Casing::SMALL:
@@ -186,7 +301,7 @@ auto Dict_Base::spell_casing(std::wstring& s) const -> const Flag_Set*
 		res = spell_casing_upper(s);
 		break;
 	case Casing::INIT_CAPITAL:
-		res = spell_casing_title(s);
+		res = spell_casing_title(s, counts);
 		break;
 	}
 	return res;
@@ -196,11 +311,13 @@ auto Dict_Base::spell_casing(std::wstring& s) const -> const Flag_Set*
  * @brief Checks spelling for a word which is in all upper case.
  *
  * @param s string to check spelling for.
- * @return The flags of the corresponding dictionary word.
+ * @return The entry of the corresponding dictionary word.
  */
-auto Dict_Base::spell_casing_upper(std::wstring& s) const -> const Flag_Set*
+auto Dict_Base::spell_casing_upper(std::wstring& s) const
+    -> Word_List::const_pointer
 {
 	auto& loc = icu_locale;
+	auto& strings = Spell_Scratch::of_this_thread().strings;
 
 	auto res = check_word(s);
 	if (res)
@@ -211,39 +328,44 @@ auto Dict_Base::spell_casing_upper(std::wstring& s) const -> const Flag_Set*
 	auto apos = s.find('\'');
 	if (apos != s.npos && apos != s.size() - 1) {
 		// apostophe is at beginning of word or dividing the word
-		auto part1 = s.substr(0, apos + 1);
-		auto part2 = s.substr(apos + 1);
-		part1 = to_lower(part1, loc);
-		part2 = to_title(part2, loc);
-		auto t = part1 + part2;
-		res = check_word(t);
+		auto part1 = wstring_view(s).substr(0, apos + 1);
+		auto part2 = wstring_view(s).substr(apos + 1);
+		Scratch_String part1_cased(strings);
+		Scratch_String part2_cased(strings);
+		Scratch_String t(strings);
+		to_lower(part1, loc, *part1_cased);
+		to_title(part2, loc, *part2_cased);
+		*t = *part1_cased;
+		*t += *part2_cased;
+		res = check_word(*t);
 		if (res)
 			return res;
-		part1 = to_title(part1, loc);
-		t = part1 + part2;
-		res = check_word(t);
+		to_title(*part1_cased, loc, *t);
+		*t += *part2_cased;
+		res = check_word(*t);
 		if (res)
 			return res;
 	}
 
+	Scratch_String t(strings);
 	// handle sharp s for German
 	if (checksharps && s.find(L"SS") != s.npos) {
-		auto t = to_lower(s, loc);
-		res = spell_sharps(t);
+		to_lower(s, loc, *t);
+		res = spell_sharps(*t);
 		if (!res)
-			t = to_title(s, loc);
-		res = spell_sharps(t);
+			to_title(s, loc, *t);
+		res = spell_sharps(*t);
 		if (res)
 			return res;
 	}
-	auto t = to_title(s, loc);
-	res = check_word(t);
-	if (res && !res->contains(keepcase_flag))
+	to_title(s, loc, *t);
+	res = check_word(*t);
+	if (res && !(words.attributes(*res) & KEEP_CASE_ATTR))
 		return res;
 
-	t = to_lower(s, loc);
-	res = check_word(t);
-	if (res && !res->contains(keepcase_flag))
+	to_lower(s, loc, *t);
+	res = check_word(*t);
+	if (res && !(words.attributes(*res) & KEEP_CASE_ATTR))
 		return res;
 	return nullptr;
 }
@@ -252,9 +374,12 @@ auto Dict_Base::spell_casing_upper(std::wstring& s) const -> const Flag_Set*
  * @brief Checks spelling for a word which is in title casing.
  *
  * @param s string to check spelling for.
- * @return The flags of the corresponding dictionary word.
+ * @param counts the counts of cased letters from classify_casing().
+ * @return The entry of the corresponding dictionary word.
  */
-auto Dict_Base::spell_casing_title(std::wstring& s) const -> const Flag_Set*
+auto Dict_Base::spell_casing_title(std::wstring& s,
+                                   const Casing_Counts& counts) const
+    -> Word_List::const_pointer
 {
 	auto& loc = icu_locale;
 
@@ -262,18 +387,26 @@ auto Dict_Base::spell_casing_title(std::wstring& s) const -> const Flag_Set*
 	auto res = check_word(s);
 
 	// forbid bad capitalization
-	if (res && res->contains(forbiddenword_flag))
+	if (res && (words.attributes(*res) & FORBIDDEN_WORD_ATTR))
 		return nullptr;
 	if (res)
 		return res;
 
 	// attempt checking lower case spelling
-	auto t = to_lower(s, loc);
-	res = check_word(t);
+	Scratch_String t(Spell_Scratch::of_this_thread().strings);
+	if (counts.lower == s.size() - 1) {
+		// the rest are lower case letters, they stay the same
+		to_lower(wstring_view(s).substr(0, 1), loc, *t);
+		t->append(s, 1, s.npos);
+	}
+	else {
+		to_lower(s, loc, *t);
+	}
+	res = check_word(*t);
 
 	// with CHECKSHARPS, ß is allowed too in KEEPCASE words with title case
-	if (res && res->contains(keepcase_flag) &&
-	    !(checksharps && (t.find(L'\xDF') != t.npos))) {
+	if (res && (words.attributes(*res) & KEEP_CASE_ATTR) &&
+	    !(checksharps && (t->find(L'\xDF') != t->npos))) {
 		res = nullptr;
 	}
 	return res;
@@ -293,10 +426,10 @@ auto Dict_Base::spell_casing_title(std::wstring& s) const -> const Flag_Set*
  * @param pos position in the string to start next find and replacement.
  * @param n counter for the recursion depth.
  * @param rep counter for the number of replacements done.
- * @return The flags of the corresponding dictionary word.
+ * @return The entry of the corresponding dictionary word.
  */
 auto Dict_Base::spell_sharps(std::wstring& base, size_t pos, size_t n,
-                             size_t rep) const -> const Flag_Set*
+                             size_t rep) const -> Word_List::const_pointer
 {
 	const size_t MAX_SHARPS = 5;
 	pos = base.find(L"ss", pos);
@@ -318,84 +451,200 @@ auto Dict_Base::spell_sharps(std::wstring& base, size_t pos, size_t n,
 	return nullptr;
 }
 
+/**
+ * @brief Computes the features of the dictionary, see Feature.
+ */
+auto Dict_Base::features() const -> unsigned
+{
+	auto f = 0u;
+	auto pfx_cross = false;
+	auto sfx_cross = false;
+	prefixes.for_each([&](auto& e) { pfx_cross |= e.cross_product; });
+	suffixes.for_each([&](auto& e) { sfx_cross |= e.cross_product; });
+	if (prefixes.size() != 0)
+		f |= HAS_PREFIXES;
+	if (suffixes.size() != 0)
+		f |= HAS_SUFFIXES;
+	if (pfx_cross && sfx_cross)
+		f |= HAS_CROSS_PRODUCT;
+	if (prefixes.has_continuation_flags() ||
+	    suffixes.has_continuation_flags())
+		f |= HAS_CONT_FLAGS;
+	if (complex_prefixes)
+		f |= HAS_COMPLEX_PREFIXES;
+	if (compound_flag || compound_begin_flag || compound_middle_flag ||
+	    compound_last_flag || !compound_rules.empty())
+		f |= HAS_COMPOUNDING;
+	return f;
+}
+
+namespace {
+template <size_t... f>
+auto check_word_table(index_sequence<f...>)
+    -> const Dict_Base::Check_Word_Ptr*
+{
+	static const Dict_Base::Check_Word_Ptr table[] = {
+	    &Dict_Base::check_word_with<f>...};
+	return table;
+}
+
+/**
+ * @brief Tells if the feature may be present.
+ *
+ * With ANY_FEATURES every feature may be present.
+ */
+constexpr auto has(unsigned features, unsigned f) -> bool
+{
+	return (features & (Dict_Base::ANY_FEATURES | f)) != 0;
+}
+} // namespace
+
+/**
+ * @brief Updates the data derived from the tables and the options.
+ *
+ * Computes the attributes of the flags, see
+ * Aff_Data::update_flag_attributes(), and selects the instantiation of
+ * check_word_with() for features(). Dictionary calls it once after loading.
+ * Code that changes the affixes, the compounding options or the compounding
+ * flags must call it again. Until it is called all features are checked at
+ * run time. The attributes alone do not need it, check_word() brings them up
+ * to date when any of the special flags changed.
+ */
+auto Dict_Base::update_derived_data() -> void
+{
+	update_flag_attributes();
+	auto table = check_word_table(make_index_sequence<ANY_FEATURES>());
+	check_word_ptr = table[features()];
+}
+
 /**
  * @brief Low-level spell-cheking.
  *
+ * Checks spelling for various unaffixed versions of the provided word, see
+ * check_simple_word(), and then as a compound word. With expanded forms the
+ * first part is a single lookup, see expand_word_forms().
+ *
+ * @tparam features the features of the dictionary, see Feature.
+ * @param s string to check spelling for.
+ * @return The entry of the corresponding dictionary word.
+ */
+template <unsigned features>
+auto Dict_Base::check_word_with(std::wstring& s) const
+    -> Word_List::const_pointer
+{
+	if (!word_forms.empty()) {
+		auto r = word_forms.equal_range(s);
+		if (r.first != r.second)
+			return &r.first->flags;
+	}
+	else {
+		auto ret = check_simple_word_with<features>(s);
+		if (ret)
+			return ret;
+	}
+	if (!has(features, HAS_COMPOUNDING))
+		return nullptr;
+	return check_compound(s);
+}
+
+/**
+ * @brief Checks the word without compounding.
+ *
  * Checks spelling for various unaffixed versions of the provided word.
  * Unaffixing is done by combinations of zero or more unsuffixing and
- * unprefixing operations.
+ * unprefixing operations. The combinations that need absent features are
+ * skipped.
  *
+ * @tparam features the features of the dictionary, see Feature.
  * @param s string to check spelling for.
- * @return The flags of the corresponding dictionary word.
+ * @return The entry of the corresponding dictionary word.
  */
-auto Dict_Base::check_word(std::wstring& s) const -> const Flag_Set*
+template <unsigned features>
+auto Dict_Base::check_simple_word_with(std::wstring& s) const
+    -> Word_List::const_pointer
 {
-
+	constexpr auto pfx = has(features, HAS_PREFIXES);
+	constexpr auto sfx = has(features, HAS_SUFFIXES);
 	for (auto& we : make_iterator_range(words.equal_range(s))) {
-		auto& word_flags = we.second;
-		if (word_flags.contains(need_affix_flag))
-			continue;
-		if (word_flags.contains(compound_onlyin_flag))
+		if (words.attributes(we) &
+		    (NEED_AFFIX_ATTR | ONLY_IN_COMPOUND_ATTR))
 			continue;
-		return &word_flags;
+		return &we;
 	}
-	{
+	if (sfx) {
 		auto ret3 = strip_suffix_only(s);
 		if (ret3)
-			return &ret3->second;
+			return ret3;
 	}
-	{
+	if (pfx) {
 		auto ret2 = strip_prefix_only(s);
 		if (ret2)
-			return &ret2->second;
+			return ret2;
 	}
-	{
+	if (has(features, HAS_CROSS_PRODUCT)) {
 		auto ret4 = strip_prefix_then_suffix_commutative(s);
 		if (ret4)
-			return &ret4->second;
+			return ret4;
 	}
-	if (!complex_prefixes) {
-		auto ret6 = strip_suffix_then_suffix(s);
-		if (ret6)
-			return &ret6->second;
-
-		auto ret7 = strip_prefix_then_2_suffixes(s);
-		if (ret7)
-			return &ret7->second;
-
-		auto ret8 = strip_suffix_prefix_suffix(s);
-		if (ret8)
-			return &ret8->second;
+	if (!has(features, HAS_CONT_FLAGS))
+		return nullptr;
+	auto complex = features & ANY_FEATURES
+	                   ? complex_prefixes
+	                   : (features & HAS_COMPLEX_PREFIXES) != 0;
+	if (!complex) {
+		if (sfx) {
+			auto ret6 = strip_suffix_then_suffix(s);
+			if (ret6)
+				return ret6;
+		}
+		if (pfx && sfx) {
+			auto ret7 = strip_prefix_then_2_suffixes(s);
+			if (ret7)
+				return ret7;
+
+			auto ret8 = strip_suffix_prefix_suffix(s);
+			if (ret8)
+				return ret8;
+		}
 
 		// this is slow and unused so comment
 		// auto ret9 = strip_2_suffixes_then_prefix(s);
 		// if (ret9)
-		//	return &ret9->second;
+		//	return ret9;
 	}
 	else {
-		auto ret6 = strip_prefix_then_prefix(s);
-		if (ret6)
-			return &ret6->second;
-		auto ret7 = strip_suffix_then_2_prefixes(s);
-		if (ret7)
-			return &ret7->second;
-
-		auto ret8 = strip_prefix_suffix_prefix(s);
-		if (ret8)
-			return &ret8->second;
+		if (pfx) {
+			auto ret6 = strip_prefix_then_prefix(s);
+			if (ret6)
+				return ret6;
+		}
+		if (pfx && sfx) {
+			auto ret7 = strip_suffix_then_2_prefixes(s);
+			if (ret7)
+				return ret7;
+
+			auto ret8 = strip_prefix_suffix_prefix(s);
+			if (ret8)
+				return ret8;
+		}
 
 		// this is slow and unused so comment
 		// auto ret9 = strip_2_prefixes_then_suffix(s);
 		// if (ret9)
-		//	return &ret9->second;
+		//	return ret9;
 	}
-	auto ret10 = check_compound(s);
-	if (ret10)
-		return &ret10->second;
-
 	return nullptr;
 }
 
+/**
+ * @brief Checks the word without compounding, see check_simple_word_with().
+ */
+auto Dict_Base::check_simple_word(std::wstring& s) const
+    -> Word_List::const_pointer
+{
+	return check_simple_word_with<ANY_FEATURES>(s);
+}
+
 template <class AffixT>
 class To_Root_Unroot_RAII {
       private:
@@ -415,24 +664,24 @@ class To_Root_Unroot_RAII {
 template <Affixing_Mode m>
 auto Dict_Base::affix_NOT_valid(const Prefix<wchar_t>& e) const
 {
-	if (m == FULL_WORD && e.cont_flags.contains(compound_onlyin_flag))
+	if (m == FULL_WORD && e.cont_attrs & ONLY_IN_COMPOUND_ATTR)
 		return true;
 	if (m == AT_COMPOUND_END &&
-	    !e.cont_flags.contains(compound_permit_flag))
+	    !(e.cont_attrs & COMPOUND_PERMIT_ATTR))
 		return true;
-	if (m != FULL_WORD && e.cont_flags.contains(compound_forbid_flag))
+	if (m != FULL_WORD && e.cont_attrs & COMPOUND_FORBID_ATTR)
 		return true;
 	return false;
 }
 template <Affixing_Mode m>
 auto Dict_Base::affix_NOT_valid(const Suffix<wchar_t>& e) const
 {
-	if (m == FULL_WORD && e.cont_flags.contains(compound_onlyin_flag))
+	if (m == FULL_WORD && e.cont_attrs & ONLY_IN_COMPOUND_ATTR)
 		return true;
 	if (m == AT_COMPOUND_BEGIN &&
-	    !e.cont_flags.contains(compound_permit_flag))
+	    !(e.cont_attrs & COMPOUND_PERMIT_ATTR))
 		return true;
-	if (m != FULL_WORD && e.cont_flags.contains(compound_forbid_flag))
+	if (m != FULL_WORD && e.cont_attrs & COMPOUND_FORBID_ATTR)
 		return true;
 	return false;
 }
@@ -441,14 +690,14 @@ auto Dict_Base::outer_affix_NOT_valid(const AffixT& e) const
 {
 	if (affix_NOT_valid<m>(e))
 		return true;
-	if (e.cont_flags.contains(need_affix_flag))
+	if (e.cont_attrs & NEED_AFFIX_ATTR)
 		return true;
 	return false;
 }
 template <class AffixT>
 auto Dict_Base::is_circumfix(const AffixT& a) const
 {
-	return a.cont_flags.contains(circumfix_flag);
+	return (a.cont_attrs & CIRCUMFIX_ATTR) != 0;
 }
 
 template <class AffixInner, class AffixOuter>
@@ -464,123 +713,114 @@ auto cross_valid_inner_outer(const Flag_Set& word_flags, const Affix& afx)
 }
 
 template <Affixing_Mode m>
-auto Dict_Base::is_valid_inside_compound(const Flag_Set& flags) const
+auto Dict_Base::is_valid_inside_compound(Flag_Attributes attrs) const
 {
-	if (m == AT_COMPOUND_BEGIN && !flags.contains(compound_flag) &&
-	    !flags.contains(compound_begin_flag))
+	if (m == AT_COMPOUND_BEGIN &&
+	    !(attrs & (COMPOUND_ATTR | COMPOUND_BEGIN_ATTR)))
 		return false;
-	if (m == AT_COMPOUND_MIDDLE && !flags.contains(compound_flag) &&
-	    !flags.contains(compound_middle_flag))
+	if (m == AT_COMPOUND_MIDDLE &&
+	    !(attrs & (COMPOUND_ATTR | COMPOUND_MIDDLE_ATTR)))
 		return false;
-	if (m == AT_COMPOUND_END && !flags.contains(compound_flag) &&
-	    !flags.contains(compound_last_flag))
+	if (m == AT_COMPOUND_END &&
+	    !(attrs & (COMPOUND_ATTR | COMPOUND_LAST_ATTR)))
 		return false;
 	return true;
 }
 
-auto prefix(const wstring& word, size_t len)
-{
-	return wstring_view(word).substr(0, len);
-}
-auto prefix(wstring&& word, size_t len) = delete;
-auto suffix(const wstring& word, size_t len)
-{
-	return wstring_view(word).substr(word.size() - len);
-}
-auto suffix(wstring&& word, size_t len) = delete;
-
 /**
  * @brief Iterator of prefix entres that match a word.
  *
  * Iterates all prefix entries where the appending member is prefix of a given
- * word.
+ * word. Entries are visited by the length of the appending, shortest first,
+ * with one walk over the trie of the table.
  */
 class Prefix_Iter {
 	const Prefix_Table<wchar_t>& tbl;
 	const wstring& word;
-	size_t len;
-	wstring_view pfx;
+	size_t len = 0;
+	size_t node;
 	using iter = typename Prefix_Table<wchar_t>::iterator;
 	iter a;
 	iter b;
-	bool valid;
+	bool valid = true;
 
-      public:
-	Prefix_Iter(const Prefix_Table<wchar_t>& tbl, const wstring& word)
-	    : tbl(tbl), word(word)
+	auto next_node() -> void
 	{
-		for (len = 0; len <= word.size(); ++len) {
-			pfx = prefix(word, len);
-			tie(a, b) = tbl.equal_range(pfx);
-			for (; a != b; ++a) {
-				valid = true;
+		while (len != word.size()) {
+			node = tbl.trie_child(node, word[len]);
+			if (node == tbl.trie_root())
+				break;
+			++len;
+			tie(a, b) = tbl.trie_entries(node);
+			if (a != b)
 				return;
-			}
 		}
 		valid = false;
 	}
+
+      public:
+	Prefix_Iter(const Prefix_Table<wchar_t>& tbl, const wstring& word)
+	    : tbl(tbl), word(word), node(tbl.trie_root())
+	{
+		tie(a, b) = tbl.trie_entries(node);
+		if (a == b)
+			next_node();
+	}
 	auto& operator++()
 	{
-		goto resume_pfx_of_word;
-
-		for (len = 0; len <= word.size(); ++len) {
-			pfx = prefix(word, len);
-			tie(a, b) = tbl.equal_range(pfx);
-			for (; a != b; ++a) {
-				return *this;
-			resume_pfx_of_word:;
-			}
-		}
-		valid = false;
+		if (++a == b)
+			next_node();
 		return *this;
 	}
 	operator bool() { return valid; }
 	auto& operator*() { return *a; }
+	auto aff_len() { return len; }
 };
 
 /**
  * @brief Iterator of suffix entres that match a word.
  *
  * Iterates all suffix entries where the appending member is suffix of a given
- * word.
+ * word. Entries are visited by the length of the appending, shortest first,
+ * with one walk over the reversed trie of the table.
  */
 class Suffix_Iter {
 	const Suffix_Table<wchar_t>& tbl;
 	const wstring& word;
-	size_t len;
-	wstring_view pfx;
+	size_t len = 0;
+	size_t node;
 	using iter = typename Suffix_Table<wchar_t>::iterator;
 	iter a;
 	iter b;
-	bool valid;
+	bool valid = true;
 
-      public:
-	Suffix_Iter(const Suffix_Table<wchar_t>& tbl, const wstring& word)
-	    : tbl(tbl), word(word)
+	auto next_node() -> void
 	{
-		for (len = 0; len <= word.size(); ++len) {
-			pfx = suffix(word, len);
-			tie(a, b) = tbl.equal_range(pfx);
-			for (; a != b; ++a) {
-				valid = true;
+		while (len != word.size()) {
+			node = tbl.trie_child(node,
+			                      word[word.size() - 1 - len]);
+			if (node == tbl.trie_root())
+				break;
+			++len;
+			tie(a, b) = tbl.trie_entries(node);
+			if (a != b)
 				return;
-			}
 		}
 		valid = false;
 	}
+
+      public:
+	Suffix_Iter(const Suffix_Table<wchar_t>& tbl, const wstring& word)
+	    : tbl(tbl), word(word), node(tbl.trie_root())
+	{
+		tie(a, b) = tbl.trie_entries(node);
+		if (a == b)
+			next_node();
+	}
 	auto& operator++()
 	{
-		goto resume_sfx_of_word;
-
-		for (len = 0; len <= word.size(); ++len) {
-			pfx = suffix(word, len);
-			tie(a, b) = tbl.equal_range(pfx);
-			for (; a != b; ++a) {
-				return *this;
-			resume_sfx_of_word:;
-			}
-		}
-		valid = false;
+		if (++a == b)
+			next_node();
 		return *this;
 	}
 	operator bool() { return valid; }
@@ -605,16 +845,17 @@ auto Dict_Base::strip_prefix_only(std::wstring& word) const
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check
-			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(e.cont_flags))
+			if (!is_valid_inside_compound<m>(word_attrs |
+			                                 e.cont_attrs))
 				continue;
 			return {word_entry, e};
 		}
@@ -633,7 +874,7 @@ auto Dict_Base::strip_suffix_only(std::wstring& word) const
 		if (outer_affix_NOT_valid<m>(e))
 			continue;
 		if (it.aff_len() != 0 && m == AT_COMPOUND_END &&
-		    e.cont_flags.contains(compound_onlyin_flag))
+		    e.cont_attrs & ONLY_IN_COMPOUND_ATTR)
 			continue;
 		if (is_circumfix(e))
 			continue;
@@ -642,16 +883,17 @@ auto Dict_Base::strip_suffix_only(std::wstring& word) const
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check
-			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(e.cont_flags))
+			if (!is_valid_inside_compound<m>(word_attrs |
+			                                 e.cont_attrs))
 				continue;
 			return {word_entry, e};
 		}
@@ -699,7 +941,8 @@ auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(se, pe) &&
 			    !cross_valid_inner_outer(word_flags, pe))
 				continue;
@@ -707,12 +950,11 @@ auto Dict_Base::strip_pfx_then_sfx_2(const Prefix<wchar_t>& pe,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check
-			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(se.cont_flags) &&
-			    !is_valid_inside_compound<m>(pe.cont_flags))
+			if (!is_valid_inside_compound<m>(
+			        word_attrs | se.cont_attrs | pe.cont_attrs))
 				continue;
 			return {word_entry, se, pe};
 		}
@@ -761,7 +1003,8 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(pe, se) &&
 			    !cross_valid_inner_outer(word_flags, se))
 				continue;
@@ -769,12 +1012,11 @@ auto Dict_Base::strip_sfx_then_pfx_2(const Suffix<wchar_t>& se,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check
-			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(se.cont_flags) &&
-			    !is_valid_inside_compound<m>(pe.cont_flags))
+			if (!is_valid_inside_compound<m>(
+			        word_attrs | se.cont_attrs | pe.cont_attrs))
 				continue;
 			return {word_entry, pe, se};
 		}
@@ -808,7 +1050,7 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(const Prefix<wchar_t>& pe,
     -> Affixing_Result<Suffix<wchar_t>, Prefix<wchar_t>>
 {
 	auto& dic = words;
-	auto has_needaffix_pe = pe.cont_flags.contains(need_affix_flag);
+	auto has_needaffix_pe = (pe.cont_attrs & NEED_AFFIX_ATTR) != 0;
 	auto is_circumfix_pe = is_circumfix(pe);
 
 	for (auto it = Suffix_Iter(suffixes, word); it; ++it) {
@@ -817,7 +1059,7 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(const Prefix<wchar_t>& pe,
 			continue;
 		if (affix_NOT_valid<m>(se))
 			continue;
-		auto has_needaffix_se = se.cont_flags.contains(need_affix_flag);
+		auto has_needaffix_se = (se.cont_attrs & NEED_AFFIX_ATTR) != 0;
 		if (has_needaffix_pe && has_needaffix_se)
 			continue;
 		if (is_circumfix_pe != is_circumfix(se))
@@ -827,7 +1069,8 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(const Prefix<wchar_t>& pe,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 
 			auto valid_cross_pe_outer =
 			    !has_needaffix_pe &&
@@ -846,12 +1089,11 @@ auto Dict_Base::strip_pfx_then_sfx_comm_2(const Prefix<wchar_t>& pe,
 
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check
-			if (!is_valid_inside_compound<m>(word_flags) &&
-			    !is_valid_inside_compound<m>(se.cont_flags) &&
-			    !is_valid_inside_compound<m>(pe.cont_flags))
+			if (!is_valid_inside_compound<m>(
+			        word_attrs | se.cont_attrs | pe.cont_attrs))
 				continue;
 			return {word_entry, se, pe};
 		}
@@ -911,12 +1153,13 @@ auto Dict_Base::strip_sfx_then_sfx_2(const Suffix<wchar_t>& se1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(word_flags, se2))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check here if needed
 			return {word_entry, se2, se1};
@@ -974,12 +1217,13 @@ auto Dict_Base::strip_pfx_then_pfx_2(const Prefix<wchar_t>& pe1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(word_flags, pe2))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check here if needed
 			return {word_entry, pe2, pe1};
@@ -1043,7 +1287,8 @@ auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(se1, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
 				continue;
@@ -1051,7 +1296,7 @@ auto Dict_Base::strip_pfx_2_sfx_3(const Prefix<wchar_t>& pe1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check here if needed
 			return {word_entry};
@@ -1122,7 +1367,8 @@ auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(se2, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
 				continue;
@@ -1130,7 +1376,7 @@ auto Dict_Base::strip_s_p_s_3(const Suffix<wchar_t>& se1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check here if needed
 			return {word_entry};
@@ -1197,7 +1443,8 @@ auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(pe1, se2) &&
 			    !cross_valid_inner_outer(word_flags, se2))
 				continue;
@@ -1205,7 +1452,7 @@ auto Dict_Base::strip_2_sfx_pfx_3(const Suffix<wchar_t>& se1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			// needflag check here if needed
 			return {word_entry};
@@ -1270,7 +1517,8 @@ auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(pe1, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
 				continue;
@@ -1278,7 +1526,7 @@ auto Dict_Base::strip_sfx_2_pfx_3(const Suffix<wchar_t>& se1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			return {word_entry};
 		}
@@ -1348,7 +1596,8 @@ auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(pe2, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
 				continue;
@@ -1356,7 +1605,7 @@ auto Dict_Base::strip_p_s_p_3(const Prefix<wchar_t>& pe1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			return {word_entry};
 		}
@@ -1422,7 +1671,8 @@ auto Dict_Base::strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
 			continue;
 		for (auto& word_entry :
 		     make_iterator_range(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+			auto& word_flags = words.flags(word_entry);
+			auto word_attrs = words.attributes(word_entry);
 			if (!cross_valid_inner_outer(se1, pe2) &&
 			    !cross_valid_inner_outer(word_flags, pe2))
 				continue;
@@ -1430,7 +1680,7 @@ auto Dict_Base::strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    word_attrs & ONLY_IN_COMPOUND_ATTR)
 				continue;
 			return {word_entry};
 		}
@@ -1440,8 +1690,9 @@ auto Dict_Base::strip_2_pfx_sfx_3(const Prefix<wchar_t>& pe1,
 }
 
 auto match_compound_pattern(const Compound_Pattern<wchar_t>& p,
-                            const wstring& word, size_t i,
-                            Compounding_Result first, Compounding_Result second)
+                            const Word_List& words, const wstring& word,
+                            size_t i, Compounding_Result first,
+                            Compounding_Result second)
 {
 	if (i < p.begin_end_chars.idx())
 		return false;
@@ -1450,10 +1701,10 @@ auto match_compound_pattern(const Compound_Pattern<wchar_t>& p,
 	                 p.begin_end_chars.str()) != 0)
 		return false;
 	if (p.first_word_flag != 0 &&
-	    !first->second.contains(p.first_word_flag))
+	    !words.flags(*first).contains(p.first_word_flag))
 		return false;
 	if (p.second_word_flag != 0 &&
-	    !second->second.contains(p.second_word_flag))
+	    !words.flags(*second).contains(p.second_word_flag))
 		return false;
 	if (p.match_first_only_unaffixed_or_zero_affixed &&
 	    first.affixed_and_modified)
@@ -1462,27 +1713,34 @@ auto match_compound_pattern(const Compound_Pattern<wchar_t>& p,
 }
 
 auto is_compound_forbidden_by_patterns(
-    const vector<Compound_Pattern<wchar_t>>& patterns, const wstring& word,
-    size_t i, Compounding_Result first, Compounding_Result second)
+    const vector<Compound_Pattern<wchar_t>>& patterns, const Word_List& words,
+    const wstring& word, size_t i, Compounding_Result first,
+    Compounding_Result second)
 {
 	return any_of(begin(patterns), end(patterns), [&](auto& p) {
-		return match_compound_pattern(p, word, i, first, second);
+		return match_compound_pattern(p, words, word, i, first,
+		                              second);
 	});
 }
 
 auto Dict_Base::check_compound(std::wstring& word) const -> Compounding_Result
 {
-	auto part = std::wstring();
+	auto& scratch = Spell_Scratch::of_this_thread();
+	Scratch_String part(scratch.strings);
 
 	if (compound_flag || compound_begin_flag || compound_middle_flag ||
 	    compound_last_flag) {
-		auto ret = check_compound(word, 0, 0, part);
+		Compounding_Memo memo(scratch.memos, word.size());
+		auto ret = check_compound(word, 0, 0, *part, memo);
 		if (ret)
 			return ret;
 	}
 	if (!compound_rules.empty()) {
-		auto words_data = vector<const Flag_Set*>();
-		return check_compound_with_rules(word, words_data, 0, part);
+		auto state = compound_rules.start_state();
+		Scratch_Pool<Spell_Scratch::Dead_Ends>::Ref dead_ends(
+		    scratch.dead_ends);
+		return check_compound_with_rules(word, state, 0, *part,
+		                                 *dead_ends);
 	}
 
 	return {};
@@ -1490,7 +1748,8 @@ auto Dict_Base::check_compound(std::wstring& word) const -> Compounding_Result
 
 template <Affixing_Mode m>
 auto Dict_Base::check_compound(std::wstring& word, size_t start_pos,
-                               size_t num_part, std::wstring& part) const
+                               size_t num_part, std::wstring& part,
+                               Compounding_Memo& memo) const
     -> Compounding_Result
 {
 	size_t min_length = 3;
@@ -1498,35 +1757,44 @@ auto Dict_Base::check_compound(std::wstring& word, size_t start_pos,
 		min_length = compound_min_length;
 	if (word.size() < min_length * 2)
 		return {};
+	if (m == AT_COMPOUND_MIDDLE) {
+		auto& e = memo.middle(start_pos);
+		if (e.first)
+			return e.second;
+	}
+	auto ret = Compounding_Result();
 	size_t max_length = word.size() - min_length;
 	for (auto i = start_pos + min_length; i <= max_length; ++i) {
 
-		auto part1_entry = check_compound_classic<m>(word, start_pos, i,
-		                                             num_part, part);
+		ret = check_compound_classic<m>(word, start_pos, i, num_part,
+		                                part, memo);
 
-		if (part1_entry)
-			return part1_entry;
+		if (ret)
+			break;
 
-		part1_entry = check_compound_with_pattern_replacements<m>(
+		ret = check_compound_with_pattern_replacements<m>(
 		    word, start_pos, i, num_part, part);
 
-		if (part1_entry)
-			return part1_entry;
+		if (ret)
+			break;
 	}
-	return {};
+	if (m == AT_COMPOUND_MIDDLE)
+		memo.middle(start_pos) = {true, ret};
+	return ret;
 }
 
 template <Affixing_Mode m>
 auto Dict_Base::check_compound_classic(std::wstring& word, size_t start_pos,
                                        size_t i, size_t num_part,
-                                       std::wstring& part) const
+                                       std::wstring& part,
+                                       Compounding_Memo& memo) const
     -> Compounding_Result
 {
 	part.assign(word, start_pos, i - start_pos);
 	auto part1_entry = check_word_in_compound<m>(part);
 	if (!part1_entry)
 		return {};
-	if (part1_entry->second.contains(forbiddenword_flag))
+	if (words.attributes(*part1_entry) & FORBIDDEN_WORD_ATTR)
 		return {};
 	if (compound_check_triple) {
 		auto triple = wstring(3, word[i]);
@@ -1539,13 +1807,12 @@ auto Dict_Base::check_compound_classic(std::wstring& word, size_t start_pos,
 	    has_uppercase_at_compound_word_boundary(word, i))
 		return {};
 
-	part.assign(word, i, word.npos);
-	auto part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
+	auto part2_entry = check_word_at_compound_end(word, i, part, memo);
 	if (!part2_entry)
 		goto try_recursive;
-	if (part2_entry->second.contains(forbiddenword_flag))
+	if (words.attributes(*part2_entry) & FORBIDDEN_WORD_ATTR)
 		goto try_recursive;
-	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
+	if (is_compound_forbidden_by_patterns(compound_patterns, words, word, i,
 	                                      part1_entry, part2_entry))
 		goto try_recursive;
 	if (compound_check_duplicate && part1_entry == part2_entry)
@@ -1554,11 +1821,11 @@ auto Dict_Base::check_compound_classic(std::wstring& word, size_t start_pos,
 	return part1_entry;
 
 try_recursive:
-	part2_entry =
-	    check_compound<AT_COMPOUND_MIDDLE>(word, i, num_part + 1, part);
+	part2_entry = check_compound<AT_COMPOUND_MIDDLE>(word, i, num_part + 1,
+	                                                 part, memo);
 	if (!part2_entry)
 		goto try_simplified_triple;
-	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
+	if (is_compound_forbidden_by_patterns(compound_patterns, words, word, i,
 	                                      part1_entry, part2_entry))
 		goto try_simplified_triple;
 	// if (compound_check_duplicate && part1_entry == part2_entry)
@@ -1573,13 +1840,15 @@ try_simplified_triple:
 		return {};
 	word.insert(i, 1, word[i - 1]);
 	AT_SCOPE_EXIT(word.erase(i, 1));
+	Compounding_Memo memo2(Spell_Scratch::of_this_thread().memos,
+	                       word.size());
 	part.assign(word, i, word.npos);
 	part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 	if (!part2_entry)
 		goto try_simplified_triple_recursive;
-	if (part2_entry->second.contains(forbiddenword_flag))
+	if (words.attributes(*part2_entry) & FORBIDDEN_WORD_ATTR)
 		goto try_simplified_triple_recursive;
-	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
+	if (is_compound_forbidden_by_patterns(compound_patterns, words, word, i,
 	                                      part1_entry, part2_entry))
 		goto try_simplified_triple_recursive;
 	if (compound_check_duplicate && part1_entry == part2_entry)
@@ -1588,11 +1857,11 @@ try_simplified_triple:
 	return part1_entry;
 
 try_simplified_triple_recursive:
-	part2_entry =
-	    check_compound<AT_COMPOUND_MIDDLE>(word, i, num_part + 1, part);
+	part2_entry = check_compound<AT_COMPOUND_MIDDLE>(word, i, num_part + 1,
+	                                                 part, memo2);
 	if (!part2_entry)
 		return {};
-	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
+	if (is_compound_forbidden_by_patterns(compound_patterns, words, word, i,
 	                                      part1_entry, part2_entry))
 		return {};
 	// if (compound_check_duplicate && part1_entry == part2_entry)
@@ -1620,15 +1889,17 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 			word.replace(i, p.begin_end_chars.str().size(),
 			             p.replacement);
 		});
+		Compounding_Memo memo2(Spell_Scratch::of_this_thread().memos,
+		                       word.size());
 
 		part.assign(word, start_pos, i - start_pos);
 		auto part1_entry = check_word_in_compound<m>(part);
 		if (!part1_entry)
 			continue;
-		if (part1_entry->second.contains(forbiddenword_flag))
+		if (words.attributes(*part1_entry) & FORBIDDEN_WORD_ATTR)
 			continue;
 		if (p.first_word_flag != 0 &&
-		    !part1_entry->second.contains(p.first_word_flag))
+		    !words.flags(*part1_entry).contains(p.first_word_flag))
 			continue;
 		if (compound_check_triple) {
 			auto triple = wstring(3, word[i]);
@@ -1643,10 +1914,10 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 		    check_word_in_compound<AT_COMPOUND_END>(part);
 		if (!part2_entry)
 			goto try_recursive;
-		if (part2_entry->second.contains(forbiddenword_flag))
+		if (words.attributes(*part2_entry) & FORBIDDEN_WORD_ATTR)
 			goto try_recursive;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !words.flags(*part2_entry).contains(p.second_word_flag))
 			goto try_recursive;
 		if (compound_check_duplicate && part1_entry == part2_entry)
 			goto try_recursive;
@@ -1655,11 +1926,11 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 
 	try_recursive:
 		part2_entry = check_compound<AT_COMPOUND_MIDDLE>(
-		    word, i, num_part + 1, part);
+		    word, i, num_part + 1, part, memo2);
 		if (!part2_entry)
 			goto try_simplified_triple;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !words.flags(*part2_entry).contains(p.second_word_flag))
 			goto try_simplified_triple;
 		// if (compound_check_duplicate && part1_entry == part2_entry)
 		//	goto try_simplified_triple;
@@ -1673,14 +1944,16 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 			return {};
 		word.insert(i, 1, word[i - 1]);
 		AT_SCOPE_EXIT(word.erase(i, 1));
+		Compounding_Memo memo3(Spell_Scratch::of_this_thread().memos,
+		                       word.size());
 		part.assign(word, i, word.npos);
 		part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 		if (!part2_entry)
 			goto try_simplified_triple_recursive;
-		if (part2_entry->second.contains(forbiddenword_flag))
+		if (words.attributes(*part2_entry) & FORBIDDEN_WORD_ATTR)
 			goto try_simplified_triple_recursive;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !words.flags(*part2_entry).contains(p.second_word_flag))
 			goto try_simplified_triple_recursive;
 		if (compound_check_duplicate && part1_entry == part2_entry)
 			goto try_simplified_triple_recursive;
@@ -1689,11 +1962,11 @@ auto Dict_Base::check_compound_with_pattern_replacements(
 
 	try_simplified_triple_recursive:
 		part2_entry = check_compound<AT_COMPOUND_MIDDLE>(
-		    word, i, num_part + 1, part);
+		    word, i, num_part + 1, part, memo3);
 		if (!part2_entry)
 			continue;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !words.flags(*part2_entry).contains(p.second_word_flag))
 			continue;
 		// if (compound_check_duplicate && part1_entry == part2_entry)
 		//	return {};
@@ -1715,19 +1988,10 @@ auto Dict_Base::check_word_in_compound(std::wstring& word) const
 {
 	auto range = words.equal_range(word);
 	for (auto& we : make_iterator_range(range)) {
-		auto& word_flags = we.second;
-		if (word_flags.contains(need_affix_flag))
+		auto word_attrs = words.attributes(we);
+		if (word_attrs & NEED_AFFIX_ATTR)
 			continue;
-		if (word_flags.contains(compound_flag))
-			return {&we};
-		if (m == AT_COMPOUND_BEGIN &&
-		    word_flags.contains(compound_begin_flag))
-			return {&we};
-		if (m == AT_COMPOUND_MIDDLE &&
-		    word_flags.contains(compound_middle_flag))
-			return {&we};
-		if (m == AT_COMPOUND_END &&
-		    word_flags.contains(compound_last_flag))
+		if (is_valid_inside_compound<m>(word_attrs))
 			return {&we};
 	}
 	auto x2 = strip_suffix_only<m>(word);
@@ -1745,64 +2009,92 @@ auto Dict_Base::check_word_in_compound(std::wstring& word) const
 	return {};
 }
 
+auto Dict_Base::check_word_at_compound_end(std::wstring& word, size_t i,
+                                           std::wstring& part,
+                                           Compounding_Memo& memo) const
+    -> Compounding_Result
+{
+	auto& e = memo.end(i);
+	if (!e.first) {
+		part.assign(word, i, word.npos);
+		e = {true, check_word_in_compound<AT_COMPOUND_END>(part)};
+	}
+	return e.second;
+}
+
+/**
+ * @brief Checks compound word with COMPOUNDRULE.
+ *
+ * The rest of the word from @p start_pos is split in all possible ways and
+ * the parts advance the state of the compound rules. What follows depends
+ * only on the position and the state, so the pairs that failed are stored
+ * in @p dead_ends and not tried again.
+ */
 auto Dict_Base::check_compound_with_rules(
-    std::wstring& word, std::vector<const Flag_Set*>& words_data,
-    size_t start_pos, std::wstring& part) const -> Compounding_Result
+    std::wstring& word, const Compound_Rule_Table::State& state,
+    size_t start_pos, std::wstring& part,
+    std::vector<std::pair<size_t, Compound_Rule_Table::State>>& dead_ends)
+    const -> Compounding_Result
 {
 	size_t min_length = 3;
 	if (compound_min_length != 0)
 		min_length = compound_min_length;
 	if (word.size() < min_length * 2)
 		return {};
+	auto is_dead_end =
+	    any_of(begin(dead_ends), end(dead_ends), [&](auto& d) {
+		    return d.first == start_pos && d.second == state;
+	    });
+	if (is_dead_end)
+		return {};
 	size_t max_length = word.size() - min_length;
+	auto state1 = Compound_Rule_Table::State();
+	auto state2 = Compound_Rule_Table::State();
 	for (auto i = start_pos + min_length; i <= max_length; ++i) {
 
 		part.assign(word, start_pos, i - start_pos);
 		auto part1_entry = Word_List::const_pointer();
 		auto range = words.equal_range(part);
 		for (auto& we : make_iterator_range(range)) {
-			auto& word_flags = we.second;
-			if (word_flags.contains(need_affix_flag))
+			if (words.attributes(we) & NEED_AFFIX_ATTR)
 				continue;
-			if (!compound_rules.has_any_of_flags(word_flags))
+			if (!compound_rules.has_any_of_flags(words.flags(we)))
 				continue;
 			part1_entry = &we;
 			break;
 		}
 		if (!part1_entry)
 			continue;
-		words_data.push_back(&part1_entry->second);
-		AT_SCOPE_EXIT(words_data.pop_back());
+		// no rule can continue with this word, prune
+		if (!compound_rules.advance(state, words.flags(*part1_entry),
+		                            state1))
+			continue;
 
 		part.assign(word, i, word.npos);
 		auto part2_entry = Word_List::const_pointer();
 		range = words.equal_range(part);
 		for (auto& we : make_iterator_range(range)) {
-			auto& word_flags = we.second;
-			if (word_flags.contains(need_affix_flag))
+			if (words.attributes(we) & NEED_AFFIX_ATTR)
 				continue;
-			if (!compound_rules.has_any_of_flags(word_flags))
+			if (!compound_rules.has_any_of_flags(words.flags(we)))
 				continue;
 			part2_entry = &we;
 			break;
 		}
 		if (!part2_entry)
 			goto try_recursive;
+		if (compound_rules.advance(state1, words.flags(*part2_entry),
+		                           state2) &&
+		    compound_rules.is_accepting(state2))
+			return {part1_entry};
 
-		{
-			words_data.push_back(&part2_entry->second);
-			AT_SCOPE_EXIT(words_data.pop_back());
-
-			auto m = compound_rules.match_any_rule(words_data);
-			if (m)
-				return {part1_entry};
-		}
 	try_recursive:
 		part2_entry =
-		    check_compound_with_rules(word, words_data, i, part);
+		    check_compound_with_rules(word, state1, i, part, dead_ends);
 		if (part2_entry)
 			return {part2_entry};
 	}
+	dead_ends.emplace_back(start_pos, state);
 	return {};
 }
 
@@ -1816,6 +2108,8 @@ auto Dict_Base::suggest_priv(std::wstring& word, List_WStrings& out) const
 	bad_char_suggest(word, out);
 	forgotten_char_suggest(word, out);
 	phonetic_suggest(word, out);
+	if (out.empty())
+		ngram_suggest(word, out);
 }
 
 auto Dict_Base::add_sug_if_correct(std::wstring& word, List_WStrings& out) const
@@ -1827,9 +2121,9 @@ auto Dict_Base::add_sug_if_correct(std::wstring& word, List_WStrings& out) const
 	auto res = check_word(word);
 	if (!res)
 		return false;
-	if (res->contains(forbiddenword_flag))
+	if (words.attributes(*res) & FORBIDDEN_WORD_ATTR)
 		return false;
-	if (forbid_warn && res->contains(warn_flag))
+	if (forbid_warn && words.attributes(*res) & WARN_ATTR)
 		return false;
 	out.push_back(word);
 	return true;
@@ -2025,14 +2319,694 @@ auto Dict_Base::phonetic_suggest(std::wstring& word, List_WStrings& out) const
 	word.assign(&backup[0], backup.size());
 }
 
+enum Ngram_Options : unsigned {
+	NGRAM_LONGER_WORSE = 1 << 0,
+	NGRAM_ANY_MISMATCH = 1 << 1,
+	NGRAM_WEIGHTED = 1 << 2
+};
+
+/**
+ * @brief Similarity of two words by their common n-grams.
+ *
+ * For each length k from 1 to n counts the substrings of s1 of length k that
+ * occur in s2, like ngram() in Hunspell.
+ */
+auto ngram_similarity(size_t n, wstring_view s1, wstring_view s2,
+                      unsigned opt) -> int
+{
+	auto l1 = int(s1.size());
+	auto l2 = int(s2.size());
+	if (l2 == 0)
+		return 0;
+	auto score = 0;
+	for (auto k = 1; k <= int(n); ++k) {
+		auto ns = 0;
+		for (auto i = 0; i <= l1 - k; ++i) {
+			if (s2.find(s1.substr(i, k)) != s2.npos) {
+				++ns;
+				continue;
+			}
+			if (opt & NGRAM_WEIGHTED) {
+				--ns;
+				if (i == 0 || i == l1 - k)
+					--ns; // side weight
+			}
+		}
+		score += ns;
+		if (ns < 2 && !(opt & NGRAM_WEIGHTED))
+			break;
+	}
+	auto penalty = 0;
+	if (opt & NGRAM_LONGER_WORSE)
+		penalty = l2 - l1 - 2;
+	if (opt & NGRAM_ANY_MISMATCH)
+		penalty = abs(l2 - l1) - 2;
+	return score - max(penalty, 0);
+}
+
+/**
+ * @brief Score of a dictionary word in the first pass of n-gram suggestions.
+ *
+ * Equals ngram_similarity(3, word, dic_word, NGRAM_LONGER_WORSE). The
+ * substrings of length 1, 2 and 3 that start at one position of word are
+ * searched with one pass over dic_word, and with SSE2 four positions of
+ * dic_word are compared at once.
+ *
+ * @param dic_word must be followed by at least 8 zeros.
+ */
+auto ngram_root_score(wstring_view word, const wchar_t* dic_word,
+                      size_t dic_len) -> int
+{
+	size_t counts[3] = {};
+	auto wl = word.size();
+	for (size_t i = 0; i != wl; ++i) {
+		auto max_k = min(wl - i, size_t(3));
+		auto all = (1u << max_k) - 1;
+		auto found = 0u;
+		auto c0 = word[i];
+		auto c1 = max_k > 1 ? word[i + 1] : 0;
+		auto c2 = max_k > 2 ? word[i + 2] : 0;
+#if defined(NUSPELL_HAVE_SSE2) && WCHAR_MAX > 0xFFFF
+		auto load = [](const wchar_t* p) {
+			auto q = reinterpret_cast<const __m128i*>(p);
+			return _mm_loadu_si128(q);
+		};
+		auto v0 = _mm_set1_epi32(c0);
+		auto v1 = _mm_set1_epi32(c1);
+		auto v2 = _mm_set1_epi32(c2);
+		for (size_t j = 0; j < dic_len && found != all; j += 4) {
+			auto p = dic_word + j;
+			auto m0 = _mm_cmpeq_epi32(load(p), v0);
+			auto m1 = _mm_cmpeq_epi32(load(p + 1), v1);
+			auto m2 = _mm_cmpeq_epi32(load(p + 2), v2);
+			m1 = _mm_and_si128(m0, m1);
+			m2 = _mm_and_si128(m1, m2);
+			found |= unsigned(_mm_movemask_epi8(m0) != 0) |
+			         unsigned(_mm_movemask_epi8(m1) != 0) << 1 |
+			         unsigned(_mm_movemask_epi8(m2) != 0) << 2;
+			found &= all;
+		}
+#else
+		for (size_t j = 0; j != dic_len && found != all; ++j) {
+			if (dic_word[j] != c0)
+				continue;
+			found |= 1;
+			if (dic_word[j + 1] == c1) {
+				found |= 2;
+				if (dic_word[j + 2] == c2)
+					found |= 4;
+			}
+			found &= all;
+		}
+#endif
+		for (size_t k = 0; k != 3; ++k)
+			counts[k] += found >> k & 1;
+	}
+	auto score = int(counts[0]);
+	if (counts[0] >= 2) {
+		score += counts[1];
+		if (counts[1] >= 2)
+			score += counts[2];
+	}
+	auto penalty = int(dic_len) - int(wl) - 2;
+	return score - max(penalty, 0);
+}
+
+auto simple_to_lower(wchar_t c) -> wchar_t
+{
+	if (c < 0x80)
+		return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+	return u_tolower(c);
+}
+
+/**
+ * @brief Length of the common prefix of a word and a dictionary word.
+ *
+ * Returns 1 if word starts with an upper case letter that differs from the
+ * start of the dictionary word, like leftcommonsubstring() in Hunspell.
+ */
+auto left_common_substring(wstring_view word, wstring_view dic_word) -> int
+{
+	auto c1 = word.empty() ? 0 : word[0];
+	auto c2 = dic_word.empty() ? 0 : simple_to_lower(dic_word[0]);
+	if (c1 != c2 && c1 != simple_to_lower(c1))
+		return 1;
+	auto n = min(word.size(), dic_word.size());
+	return mismatch(begin(word), begin(word) + n, begin(dic_word)).first -
+	       begin(word);
+}
+
+/**
+ * @brief Counts the positions where two words have the same character.
+ *
+ * The first character of dic_word is compared in lower case.
+ *
+ * @param[out] is_swap set to whether the words differ only by two swapped
+ * characters.
+ */
+auto common_char_positions(wstring_view word, wstring_view dic_word,
+                           bool& is_swap) -> int
+{
+	auto at = [&](size_t i) {
+		return i == 0 ? simple_to_lower(dic_word[0]) : dic_word[i];
+	};
+	auto num = 0;
+	auto diff = 0;
+	size_t diff_pos[2] = {};
+	auto n = min(word.size(), dic_word.size());
+	for (size_t i = 0; i != n; ++i) {
+		if (word[i] == at(i)) {
+			++num;
+			continue;
+		}
+		if (diff < 2)
+			diff_pos[diff] = i;
+		++diff;
+	}
+	is_swap = diff == 2 && word.size() == dic_word.size() &&
+	          word[diff_pos[0]] == at(diff_pos[1]) &&
+	          word[diff_pos[1]] == at(diff_pos[0]);
+	return num;
+}
+
+/**
+ * @brief Length of the longest common subsequence of two strings.
+ */
+auto lcs_length(wstring_view a, wstring_view b) -> int
+{
+	auto row = vector<int>(b.size() + 1);
+	for (auto ca : a) {
+		auto diag = 0;
+		for (size_t j = 0; j != b.size(); ++j) {
+			auto up = row[j + 1];
+			row[j + 1] = ca == b[j] ? diag + 1 : max(up, row[j]);
+			diag = up;
+		}
+	}
+	return row.back();
+}
+
+/**
+ * @brief Pushes into a bounded heap that keeps the best k elements.
+ *
+ * The element that is worst by the ordering @p better is at the front.
+ */
+template <class T, class Better>
+auto push_top_k(vector<T>& heap, size_t k, T&& x, Better better) -> void
+{
+	if (heap.size() < k) {
+		heap.push_back(move(x));
+		push_heap(begin(heap), end(heap), better);
+		return;
+	}
+	if (!better(x, heap.front()))
+		return;
+	pop_heap(begin(heap), end(heap), better);
+	heap.back() = move(x);
+	push_heap(begin(heap), end(heap), better);
+}
+
+/**
+ * @brief Suggests dictionary words that have many n-grams in common with a
+ * badly misspelled word.
+ *
+ * The algorithm is the one of ngsuggest() in Hunspell. It honors the options
+ * MAXNGRAMSUGS, MAXDIFF and ONLYMAXDIFF. Words not in lower case are lowered
+ * first and the suggestions get the casing of the word.
+ */
+auto Dict_Base::ngram_suggest(const std::wstring& word,
+                              List_WStrings& out) const -> void
+{
+	if (max_ngram_suggestions == 0 || word.empty())
+		return;
+	update_flag_attributes(); // the roots are read without check_word()
+	auto casing = classify_casing(word);
+	auto old_size = out.size();
+	if (casing == Casing::SMALL)
+		ngram_suggest_lowercase(word, casing, out);
+	else
+		ngram_suggest_lowercase(to_lower(word, icu_locale), casing,
+		                        out);
+	for (auto i = old_size; i != out.size(); ++i) {
+		auto& sug = out[i];
+		if (casing == Casing::ALL_CAPITAL)
+			sug = to_upper(sug, icu_locale);
+		else if (casing == Casing::INIT_CAPITAL ||
+		         casing == Casing::PASCAL)
+			sug[0] = u_totitle(sug[0]);
+	}
+	// the word itself is found when it is correct
+	out.erase(remove(begin(out) + old_size, end(out), word), end(out));
+}
+
+auto Dict_Base::ngram_suggest_lowercase(const std::wstring& word,
+                                        Casing casing,
+                                        List_WStrings& out) const -> void
+{
+	struct Root {
+		int score;
+		string word;
+		Word_List::const_pointer entry;
+	};
+	struct Guess {
+		int score;
+		size_t seq;
+		wstring word;
+	};
+	// Ties are broken by the word and then by its flags, so the result
+	// does not depend on the word store nor on how the scan is split among
+	// threads.
+	auto root_better = [&](const Root& a, const Root& b) {
+		if (a.score != b.score)
+			return a.score > b.score;
+		if (a.word != b.word)
+			return a.word < b.word;
+		return words.flags(*a.entry) < words.flags(*b.entry);
+	};
+	auto guess_better = [](const Guess& a, const Guess& b) {
+		return a.score > b.score ||
+		       (a.score == b.score && a.seq < b.seq);
+	};
+	auto const max_roots = size_t(100);
+	auto const max_guesses = size_t(200);
+	auto const min_words_per_thread = size_t(50000);
+
+	auto wl = word.size();
+	auto has_phonetic = !phonetic_table.empty();
+	// capitalized dictionary words are not suggested for lower case words,
+	// except in German
+	auto skip_init_capital = casing == Casing::SMALL && !has_phonetic &&
+	                         strcmp(icu_locale.getLanguage(), "de") != 0;
+
+	auto scan = [&](size_t first, size_t last) {
+		using utf8 = boost::locale::utf::utf_traits<char>;
+		using utfw = boost::locale::utf::utf_traits<wchar_t>;
+		auto is_upper = [](wchar_t c) {
+			return simple_to_lower(c) != c;
+		};
+		auto is_lead_byte = [](char c) { return (c & 0xC0) != 0x80; };
+		auto roots = vector<Root>();
+		auto dic_word = wstring();
+		words.for_each_in_slots(first, last, [&](auto word_utf8,
+		                                         auto& entry) {
+			auto len = count_if(begin(word_utf8), end(word_utf8),
+			                    is_lead_byte);
+			if (abs(len - ptrdiff_t(wl)) > 4)
+				return;
+			if (words.attributes(entry) &
+			    (FORBIDDEN_WORD_ATTR | NO_SUGGEST_ATTR |
+			     ONLY_IN_COMPOUND_ATTR | HIDDEN_HOMONYM_ATTR))
+				return;
+			dic_word.clear();
+			auto it = begin(word_utf8);
+			auto it_end = end(word_utf8);
+			while (it != it_end) {
+				if (is_ascii(*it)) {
+					dic_word.push_back(*it++);
+					continue;
+				}
+				auto cp = utf8::decode(it, it_end);
+				if (cp == boost::locale::utf::illegal ||
+				    cp == boost::locale::utf::incomplete)
+					continue;
+				utfw::encode(cp, back_inserter(dic_word));
+			}
+			auto n_upper = count_if(begin(dic_word), end(dic_word),
+			                        is_upper);
+			auto init_cap = n_upper == 1 && is_upper(dic_word[0]);
+			if (init_cap && skip_init_capital)
+				return;
+			auto mixed = n_upper != 0 && !init_cap;
+			auto left = 0;
+			if (mixed)
+				left = left_common_substring(word, dic_word);
+			transform(begin(dic_word), end(dic_word),
+			          begin(dic_word), simple_to_lower);
+			if (!mixed)
+				left = left_common_substring(word, dic_word);
+			auto dic_len = dic_word.size();
+			dic_word.append(8, L'\0');
+			auto score = ngram_root_score(word, dic_word.data(),
+			                              dic_len) +
+			             left;
+			// reject before copying the word, equal words are
+			// ordered by push_top_k()
+			if (roots.size() == max_roots) {
+				auto& worst = roots.front();
+				if (score < worst.score ||
+				    (score == worst.score &&
+				     word_utf8 > string_view(worst.word)))
+					return;
+			}
+			push_top_k(roots, max_roots,
+			           Root{score, string(word_utf8), &entry},
+			           root_better);
+		});
+		return roots;
+	};
+
+	auto roots = vector<Root>();
+	auto n_slots = words.slot_count();
+	auto n_threads = min(size_t(thread::hardware_concurrency()),
+	                     words.size() / min_words_per_thread);
+	if (n_threads < 2) {
+		roots = scan(0, n_slots);
+	}
+	else {
+		auto step = n_slots / n_threads + 1;
+		auto futures = vector<future<vector<Root>>>();
+		for (size_t i = 0; i < n_slots; i += step)
+			futures.push_back(async(launch::async, scan, i,
+			                        min(i + step, n_slots)));
+		for (auto& f : futures)
+			for (auto& r : f.get())
+				push_top_k(roots, max_roots, move(r),
+				           root_better);
+	}
+	if (roots.empty())
+		return;
+	sort(begin(roots), end(roots), root_better);
+
+	// minimal score of a passable suggestion, from the word mangled three
+	// different ways
+	auto threshold = 0;
+	for (size_t sp = 1; sp != 4; ++sp) {
+		auto mangled = word;
+		for (auto k = sp; k < wl; k += 4)
+			mangled[k] = '*';
+		threshold += ngram_similarity(wl, word, mangled,
+		                              NGRAM_ANY_MISMATCH);
+	}
+	threshold = threshold / 3 - 1;
+
+	// expand affixes on the best roots and select the forms by length
+	// adjusted n-gram scores
+	auto guesses = vector<Guess>();
+	auto root = wstring();
+	auto forms = List_WStrings();
+	auto lower_form = wstring();
+	auto seq = size_t(0);
+	for (auto& r : roots) {
+		utf8_to_wide(r.word, root);
+		forms.clear();
+		expand_root_word(root, *r.entry, word, forms);
+		for (auto& f : forms) {
+			lower_form.resize(f.size());
+			transform(begin(f), end(f), begin(lower_form),
+			          simple_to_lower);
+			auto score = ngram_similarity(wl, word, lower_form,
+			                              NGRAM_ANY_MISMATCH) +
+			             left_common_substring(word, f);
+			if (score > threshold)
+				push_top_k(guesses, max_guesses,
+				           Guess{score, seq++, move(f)},
+				           guess_better);
+		}
+	}
+	sort(begin(guesses), end(guesses), guess_better);
+
+	// weight the guesses with a similarity index based on the longest
+	// common subsequence and sort again
+	auto max_diff = min(max_diff_factor, static_cast<unsigned short>(10));
+	auto fact = (10.0 - max_diff) / 5.0;
+	auto n = int(wl);
+	for (auto& g : guesses) {
+		lower_form.resize(g.word.size());
+		transform(begin(g.word), end(g.word), begin(lower_form),
+		          simple_to_lower);
+		auto len = int(lower_form.size());
+		auto lcs = lcs_length(word, lower_form);
+		// same characters with different casing
+		if (n == len && n == lcs) {
+			g.score += 2000;
+			break;
+		}
+		auto re = ngram_similarity(2, word, lower_form,
+		                           NGRAM_ANY_MISMATCH | NGRAM_WEIGHTED);
+		if (re)
+			re += ngram_similarity(
+			    2, lower_form, word,
+			    NGRAM_ANY_MISMATCH | NGRAM_WEIGHTED);
+		auto is_swap = false;
+		auto common = common_char_positions(word, lower_form, is_swap);
+		auto limit = has_phonetic ? len * fact : (n + len) * fact;
+		g.score = 2 * lcs - abs(n - len) +
+		          left_common_substring(word, lower_form) +
+		          (common ? 1 : 0) + (is_swap ? 10 : 0) +
+		          ngram_similarity(4, word, lower_form,
+		                           NGRAM_ANY_MISMATCH) +
+		          re + (re < limit ? -1000 : 0);
+	}
+	stable_sort(begin(guesses), end(guesses),
+	            [](auto& a, auto& b) { return a.score > b.score; });
+
+	auto old_size = out.size();
+	auto only_excellent = false;
+	for (auto& g : guesses) {
+		if (out.size() == old_size + max_ngram_suggestions)
+			break;
+		if (only_excellent && g.score <= 1000)
+			break;
+		if (g.score > 1000) {
+			// leave only the excellent suggestions
+			only_excellent = true;
+		}
+		else if (g.score < -100) {
+			// keep the best one, unless in ONLYMAXDIFF mode
+			only_excellent = true;
+			if (out.size() != old_size || only_max_diff)
+				break;
+		}
+		// skip previous suggestions and their affixed forms
+		auto contains_previous = any_of(
+		    begin(out), end(out),
+		    [&](auto& o) { return g.word.find(o) != g.word.npos; });
+		if (contains_previous)
+			continue;
+		auto res = check_word(g.word);
+		if (!res || (words.attributes(*res) & FORBIDDEN_WORD_ATTR) ||
+		    (forbid_warn && (words.attributes(*res) & WARN_ATTR)))
+			continue;
+		out.push_back(move(g.word));
+	}
+}
+
+/**
+ * @brief Checks if an affix can be added to a word, for expanding words.
+ */
+auto static can_derive(const Prefix<wchar_t>& e, const wstring& word)
+{
+	return word.compare(0, e.stripping.size(), e.stripping) == 0 &&
+	       e.check_condition(word);
+}
+auto static can_derive(const Suffix<wchar_t>& e, const wstring& word)
+{
+	auto n = e.stripping.size();
+	return n <= word.size() &&
+	       word.compare(word.size() - n, n, e.stripping) == 0 &&
+	       e.check_condition(word);
+}
+
+/**
+ * @brief Fills word_forms with all words accepted by check_simple_word().
+ *
+ * Every root is expanded with up to three affixes, like in unmunch. The
+ * affixes are added in the reverse order of stripping, at most two suffixes
+ * and a prefix, or two prefixes and a suffix with COMPLEXPREFIXES. An affix
+ * is added if its flag is among the flags of the root or the continuation
+ * flags of the affixes added before it, and its condition matches. This
+ * gives a superset of the accepted words, so each form is then checked with
+ * check_simple_word() and stored with the flags of the root it resolves to.
+ * Thus check_word() gives exactly the same results with and without the
+ * expanded forms.
+ */
+auto Dict_Base::expand_word_forms() -> void
+{
+	word_forms = Word_Table();
+	auto prefixes_by_flag =
+	    unordered_map<char16_t, vector<const Prefix<wchar_t>*>>();
+	auto suffixes_by_flag =
+	    unordered_map<char16_t, vector<const Suffix<wchar_t>*>>();
+	prefixes.for_each(
+	    [&](auto& e) { prefixes_by_flag[e.flag].push_back(&e); });
+	suffixes.for_each(
+	    [&](auto& e) { suffixes_by_flag[e.flag].push_back(&e); });
+	auto max_prefixes = complex_prefixes ? 2 : 1;
+	auto max_suffixes = complex_prefixes ? 1 : 2;
+
+	auto forms = Word_Table();
+	auto form = wstring();
+	auto form_u8 = string();
+	// flags of the root and of the added affixes
+	auto flag_sets = vector<const Flag_Set*>();
+	auto flags = vector<char16_t>();
+	auto add_form = [&]() {
+		auto r = forms.equal_range(form);
+		if (r.first != r.second)
+			return;
+		auto res = check_simple_word(form);
+		if (!res)
+			return;
+		wide_to_utf8(form, form_u8);
+		forms.emplace(form_u8, *res);
+	};
+	auto expand = [&](auto& self, int n_pfx, int n_sfx) -> void {
+		// try each affix with allowed flag
+		auto derive = [&](auto& by_flag, char16_t flag, int n_pfx,
+		                  int n_sfx) {
+			auto it = by_flag.find(flag);
+			if (it == end(by_flag))
+				return;
+			for (auto e : it->second) {
+				if (!can_derive(*e, form))
+					continue;
+				e->to_derived(form);
+				flag_sets.push_back(&e->cont_flags);
+				add_form();
+				self(self, n_pfx, n_sfx);
+				flag_sets.pop_back();
+				e->to_root(form);
+			}
+		};
+		flags.clear();
+		for (auto fs : flag_sets)
+			flags.insert(end(flags), begin(*fs), end(*fs));
+		sort(begin(flags), end(flags));
+		flags.erase(unique(begin(flags), end(flags)), end(flags));
+		auto allowed = flags;
+		for (auto flag : allowed) {
+			if (n_pfx != max_prefixes)
+				derive(prefixes_by_flag, flag, n_pfx + 1,
+				       n_sfx);
+			if (n_sfx != max_suffixes)
+				derive(suffixes_by_flag, flag, n_pfx,
+				       n_sfx + 1);
+		}
+	};
+	words.for_each([&](auto word, auto& word_entry) {
+		utf8_to_wide(word, form);
+		flag_sets.assign(1, &words.flags(word_entry));
+		add_form();
+		expand(expand, 0, 0);
+	});
+	word_forms = move(forms);
+}
+
+/**
+ * @brief Generates the forms of a root word that may fit a misspelled word.
+ *
+ * Only the affixes that the misspelled word starts or ends with are applied,
+ * like expand_rootword() in Hunspell, and at most 100 forms are generated.
+ *
+ * @param root the root word.
+ * @param root_entry the dictionary entry of the root.
+ * @param word the misspelled word.
+ * @param[out] forms the generated forms are appended here.
+ */
+auto Dict_Base::expand_root_word(const std::wstring& root,
+                                 Word_List::const_reference root_entry,
+                                 const std::wstring& word,
+                                 List_WStrings& forms) const -> void
+{
+	auto const max_forms = size_t(100);
+	auto& flags = words.flags(root_entry);
+	auto is_valid_cont = [&](Flag_Attributes cont) {
+		return !(cont & (NEED_AFFIX_ATTR | CIRCUMFIX_ATTR |
+		                 ONLY_IN_COMPOUND_ATTR));
+	};
+	auto can_strip = [&](const wstring& w, const wstring& strip) {
+		return w.size() > strip.size() ||
+		       (fullstrip && w.size() == strip.size());
+	};
+
+	if (!(words.attributes(root_entry) &
+	      (NEED_AFFIX_ATTR | ONLY_IN_COMPOUND_ATTR)))
+		forms.push_back(root);
+
+	auto cross_forms = vector<size_t>();
+	for (auto it = Suffix_Iter(suffixes, word); it; ++it) {
+		if (it.aff_len() == word.size())
+			break;
+		auto& e = *it;
+		if (!flags.contains(e.flag) || !is_valid_cont(e.cont_attrs))
+			continue;
+		auto& strip = e.stripping;
+		if (!can_strip(root, strip) ||
+		    root.compare(root.size() - strip.size(), strip.size(),
+		                 strip) != 0 ||
+		    !e.check_condition(root))
+			continue;
+		if (forms.size() == max_forms)
+			return;
+		if (e.cross_product)
+			cross_forms.push_back(forms.size());
+		forms.push_back(e.to_derived_copy(root));
+	}
+	for (auto i : cross_forms) {
+		for (auto it = Prefix_Iter(prefixes, word); it; ++it) {
+			if (it.aff_len() == word.size())
+				break;
+			auto& e = *it;
+			if (!e.cross_product || !flags.contains(e.flag))
+				continue;
+			auto& strip = e.stripping;
+			auto& form = forms[i];
+			if (!can_strip(form, strip) ||
+			    form.compare(0, strip.size(), strip) != 0 ||
+			    !e.check_condition(form))
+				continue;
+			if (forms.size() == max_forms)
+				return;
+			forms.push_back(e.to_derived_copy(form));
+		}
+	}
+	for (auto it = Prefix_Iter(prefixes, word); it; ++it) {
+		if (it.aff_len() == word.size())
+			break;
+		auto& e = *it;
+		if (!flags.contains(e.flag) || !is_valid_cont(e.cont_attrs))
+			continue;
+		auto& strip = e.stripping;
+		if (!can_strip(root, strip) ||
+		    root.compare(0, strip.size(), strip) != 0 ||
+		    !e.check_condition(root))
+			continue;
+		if (forms.size() == max_forms)
+			return;
+		forms.push_back(e.to_derived_copy(root));
+	}
+}
+
+/**
+ * @brief Results of spell() and suggest(), keyed by the word in the internal
+ * encoding.
+ */
+struct Dictionary::Result_Cache {
+	Sharded_Lru_Cache<wstring, bool> spell;
+	Sharded_Lru_Cache<wstring, vector<wstring>> suggest;
+
+	Result_Cache(size_t max_words) : spell(max_words), suggest(max_words)
+	{
+	}
+};
+
 Dictionary::Dictionary(std::istream& aff, std::istream& dic)
 {
 	if (!parse_aff_dic(aff, dic))
 		throw Dictionary_Loading_Error("error parsing");
+	update_derived_data();
 	external_locale_known_utf8 = is_locale_known_utf8(external_locale);
 }
 
-auto Dictionary::external_to_internal_encoding(const string& in,
+Dictionary::Dictionary(string_view aff, string_view dic)
+{
+	if (!parse_aff_dic(aff, dic))
+		throw Dictionary_Loading_Error("error parsing");
+	update_derived_data();
+	external_locale_known_utf8 = is_locale_known_utf8(external_locale);
+}
+
+auto Dictionary::external_to_internal_encoding(string_view in,
                                                wstring& wide_out) const -> bool
 {
 	if (external_locale_known_utf8)
@@ -2056,6 +3030,36 @@ Dictionary::Dictionary()
 	external_locale_known_utf8 = is_locale_known_utf8(external_locale);
 }
 
+auto Dictionary::spell_cached(std::wstring& word) const -> bool
+{
+	if (!cache)
+		return spell_priv(word);
+	auto ret = false;
+	if (cache->spell.find(word, ret))
+		return ret;
+	auto key = word; // spell_priv() modifies the word
+	ret = spell_priv(word);
+	cache->spell.insert(key, ret);
+	return ret;
+}
+
+auto Dictionary::suggest_cached(std::wstring& word, List_WStrings& out) const
+    -> void
+{
+	if (!cache)
+		return suggest_priv(word, out);
+	auto static thread_local sugs = vector<wstring>();
+	if (cache->suggest.find(word, sugs)) {
+		for (auto& s : sugs)
+			out.push_back(s);
+		return;
+	}
+	auto key = word;
+	suggest_priv(word, out);
+	sugs.assign(begin(out), end(out));
+	cache->suggest.insert(key, sugs);
+}
+
 /**
  * @brief Create a dictionary from opened files as iostreams
  *
@@ -2073,8 +3077,74 @@ auto Dictionary::load_from_aff_dic(std::istream& aff, std::istream& dic)
 	return Dictionary(aff, dic);
 }
 
+namespace {
+/**
+ * @brief Read-only view of a whole file.
+ *
+ * On POSIX the file is memory mapped, elsewhere it is read into a buffer.
+ */
+class Mapped_File {
+	const char* ptr = nullptr;
+	size_t sz = 0;
+#ifdef NUSPELL_HAVE_MMAP
+	bool mapped = false;
+#endif
+	std::string buffer;
+
+      public:
+	Mapped_File(const std::string& file_path, const char* what = "File");
+	~Mapped_File();
+	Mapped_File(const Mapped_File&) = delete;
+	auto operator=(const Mapped_File&) -> Mapped_File& = delete;
+	auto data() const { return ptr; }
+	auto size() const { return sz; }
+};
+
+Mapped_File::Mapped_File(const std::string& file_path, const char* what)
+{
+#ifdef NUSPELL_HAVE_MMAP
+	auto fd = ::open(file_path.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw Dictionary_Loading_Error(what + (" " + file_path) +
+		                               " not found");
+	struct stat st;
+	if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+		auto p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE,
+		                fd, 0);
+		if (p != MAP_FAILED) {
+			ptr = static_cast<const char*>(p);
+			sz = st.st_size;
+			mapped = true;
+		}
+	}
+	::close(fd);
+	if (mapped)
+		return;
+#endif
+	std::ifstream in(file_path, ios_base::binary);
+	if (in.fail())
+		throw Dictionary_Loading_Error(what + (" " + file_path) +
+		                               " not found");
+	buffer.assign(istreambuf_iterator<char>(in),
+	              istreambuf_iterator<char>());
+	ptr = buffer.data();
+	sz = buffer.size();
+}
+
+Mapped_File::~Mapped_File()
+{
+#ifdef NUSPELL_HAVE_MMAP
+	if (mapped)
+		::munmap(const_cast<char*>(ptr), sz);
+#endif
+}
+} // namespace
+
 /**
  * @brief Create a dictionary from files
+ *
+ * The files are memory mapped where possible and parsed in place.
+ *
  * @param file path without extensions
  * @return Dictionary object
  * @throws Dictionary_Loading_Error on error
@@ -2084,18 +3154,58 @@ auto Dictionary::load_from_path(const std::string& file_path_without_extension)
 {
 	auto path = file_path_without_extension;
 	path += ".aff";
-	std::ifstream aff_file(path);
-	if (aff_file.fail()) {
-		auto err = "Aff file " + path + " not found";
-		throw Dictionary_Loading_Error(err);
-	}
+	Mapped_File aff_file(path, "Aff file");
 	path.replace(path.size() - 3, 3, "dic");
-	std::ifstream dic_file(path);
-	if (dic_file.fail()) {
-		auto err = "Dic file " + path + " not found";
-		throw Dictionary_Loading_Error(err);
-	}
-	return load_from_aff_dic(aff_file, dic_file);
+	Mapped_File dic_file(path, "Dic file");
+	auto aff = string_view(aff_file.data(), aff_file.size());
+	auto dic = string_view(dic_file.data(), dic_file.size());
+	return Dictionary(aff, dic);
+}
+
+/**
+ * @brief Create a dictionary from a precompiled binary file
+ *
+ * The binary file is produced with save_binary(). There is no text to parse
+ * and no flags to decode. The file is memory mapped where possible and the
+ * words are used in place, they are only checked and not copied, so
+ * processes that load the same file share its pages. The file stays
+ * mapped as long as the dictionary or a copy of it exists.
+ *
+ * The words are in the perfect hash store, or in the DAWG if the dictionary
+ * was saved with it, see set_word_store(). Adding words copies them to the
+ * hash table.
+ *
+ * @param file_path path to the binary file
+ * @return Dictionary object
+ * @throws Dictionary_Loading_Error on error
+ */
+auto Dictionary::load_from_binary(const std::string& file_path) -> Dictionary
+{
+	auto file = make_shared<Mapped_File>(file_path);
+	auto d = Dictionary();
+	d.storage = file;
+	if (!d.load_binary(file->data(), file->size()))
+		throw Dictionary_Loading_Error("Binary file " + file_path +
+		                               " is invalid or incompatible");
+	d.update_derived_data();
+	return d;
+}
+
+/**
+ * @brief Saves the dictionary in a precompiled binary file
+ *
+ * The format is versioned and it is specific to the platform (byte order and
+ * size of wchar_t). Load it with load_from_binary().
+ *
+ * @param file_path path to the binary file
+ * @return true on success, false on write error
+ */
+auto Dictionary::save_binary(const std::string& file_path) const -> bool
+{
+	std::ofstream out(file_path, ios_base::binary);
+	if (out.fail())
+		return false;
+	return Dict_Base::save_binary(out) && out.flush();
 }
 
 /**
@@ -2134,7 +3244,120 @@ auto Dictionary::spell(const std::string& word) const -> bool
 	}
 	if (unlikely(!ok_enc))
 		return false;
-	return spell_priv(wide_word);
+	return spell_cached(wide_word);
+}
+
+/**
+ * @brief Computes the Word_Hash of the likely stems of a word.
+ *
+ * The stems are the word without the longest suffixes that match its end,
+ * with the stripping put back, for the suffixes whose condition holds. They
+ * are the first words that check_word() looks up after the whole word.
+ *
+ * @param word the word in the internal encoding
+ * @param out array for at least max_batch_stems hashes
+ * @return the number of hashes written to out
+ */
+auto Dictionary::stem_hashes(const std::wstring& word, size_t* out) const
+    -> size_t
+{
+	auto static thread_local stem = wstring();
+	// the deepest trie nodes with entries, deepest last
+	size_t nodes[max_batch_stems];
+	size_t lens[max_batch_stems];
+	size_t num_nodes = 0;
+	auto node = suffixes.trie_root();
+	for (size_t len = 1; len < word.size(); ++len) {
+		node = suffixes.trie_child(node, word[word.size() - len]);
+		if (node == suffixes.trie_root())
+			break;
+		auto e = suffixes.trie_entries(node);
+		if (e.first == e.second)
+			continue;
+		if (num_nodes == max_batch_stems) {
+			move(nodes + 1, nodes + num_nodes, nodes);
+			move(lens + 1, lens + num_nodes, lens);
+			--num_nodes;
+		}
+		nodes[num_nodes] = node;
+		lens[num_nodes] = len;
+		++num_nodes;
+	}
+	size_t n = 0;
+	while (num_nodes != 0 && n != max_batch_stems) {
+		--num_nodes;
+		auto e = suffixes.trie_entries(nodes[num_nodes]);
+		for (; e.first != e.second && n != max_batch_stems; ++e.first) {
+			stem.assign(word, 0, word.size() - lens[num_nodes]);
+			stem += e.first->stripping;
+			if (!e.first->check_condition(stem))
+				continue;
+			auto h = Word_Hash()(stem);
+			if (find(out, out + n, h) == out + n)
+				out[n++] = h;
+		}
+	}
+	return n;
+}
+
+/**
+ * @brief Checks the spelling of many words at once
+ *
+ * Gives the same results as calling spell() for each word, but it is faster
+ * for big inputs. The words are processed in small groups. First all words
+ * of a group are converted to the internal encoding. Then the Word_Hash of
+ * each word and of its likely stems, the word without the longest suffixes
+ * that match its end, is computed. Then the memory where those would be
+ * found in the word list is prefetched, and only then the words are checked,
+ * so the cache misses of the group overlap.
+ *
+ * @param words the words to check
+ * @param[out] out the results, true if the word at the same index is
+ * correct. Only the first min(words.size(), out.size()) words are checked.
+ */
+auto Dictionary::spell_batch(span<const string_view> words,
+                             span<bool> out) const -> void
+{
+	constexpr size_t group_size = 8;
+	auto static thread_local wide_words = vector<wstring>(group_size);
+	bool ok_enc[group_size];
+	size_t hashes[group_size * (1 + max_batch_stems)];
+	auto prefetch_all = [&](auto& list, size_t num_hashes) {
+		for (size_t k = 0; k != num_hashes; ++k)
+			list.prefetch(hashes[k]);
+		for (size_t k = 0; k != num_hashes; ++k)
+			list.prefetch_word(hashes[k]);
+	};
+	auto n = min(words.size(), out.size());
+	for (size_t i = 0; i < n; i += group_size) {
+		auto m = min(group_size, n - i);
+		for (size_t j = 0; j != m; ++j) {
+			auto& w = wide_words[j];
+			auto& word = words[i + j];
+			ok_enc[j] = external_to_internal_encoding(word, w);
+			if (unlikely(w.size() > 180)) {
+				w.resize(180);
+				w.shrink_to_fit();
+				ok_enc[j] = false;
+			}
+		}
+		size_t num_hashes = 0;
+		for (size_t j = 0; j != m; ++j) {
+			if (unlikely(!ok_enc[j]))
+				continue;
+			auto& w = wide_words[j];
+			hashes[num_hashes++] = Word_Hash()(w);
+			if (word_forms.empty())
+				num_hashes +=
+				    stem_hashes(w, &hashes[num_hashes]);
+		}
+		if (word_forms.empty())
+			prefetch_all(this->words, num_hashes);
+		else
+			prefetch_all(word_forms, num_hashes);
+		for (size_t j = 0; j != m; ++j)
+			out[i + j] = ok_enc[j] && spell_cached(wide_words[j]);
+	}
 }
 
 /**
@@ -2157,7 +3380,7 @@ auto Dictionary::suggest(const std::string& word,
 	if (unlikely(!ok_enc))
 		return;
 	wide_list.clear();
-	suggest_priv(wide_word, wide_list);
+	suggest_cached(wide_word, wide_list);
 
 	auto narrow_list = List_Strings(move(out));
 	narrow_list.clear();
@@ -2167,4 +3390,84 @@ auto Dictionary::suggest(const std::string& word,
 	}
 	out = narrow_list.extract_sequence();
 }
+
+/**
+ * @brief Enables caching of the results of spell() and suggest()
+ *
+ * Natural text repeats the same words a lot. With the cache enabled the
+ * results for recently seen words are remembered and not computed again.
+ * The cache is bounded, least recently used words are evicted first. It is
+ * safe to call spell() and suggest() from multiple threads with the cache.
+ *
+ * Calling this again replaces the cache with an empty one. Do not call it
+ * while other threads use the dictionary.
+ *
+ * @param max_words maximal number of words remembered, separately for
+ * spell() and suggest()
+ */
+auto Dictionary::enable_cache(size_t max_words) -> void
+{
+	cache = make_shared<Result_Cache>(max_words);
+}
+
+/**
+ * @brief Disables the cache and frees its memory, see enable_cache()
+ */
+auto Dictionary::disable_cache() -> void { cache.reset(); }
+
+/**
+ * @brief Gets the hit and miss counters of the cache
+ * @return the counters, all zero if the cache is not enabled
+ */
+auto Dictionary::cache_stats() const -> Cache_Stats
+{
+	auto ret = Cache_Stats();
+	if (!cache)
+		return ret;
+	ret.spell_hits = cache->spell.hits();
+	ret.spell_misses = cache->spell.misses();
+	ret.suggest_hits = cache->suggest.hits();
+	ret.suggest_misses = cache->suggest.misses();
+	return ret;
+}
+
+/**
+ * @brief Expands the words with their affixes for faster checking
+ *
+ * All affixed forms of the words in the dictionary are generated and stored
+ * in a hash table. Words that are not compounds are then checked with one
+ * lookup instead of stripping the affixes in many ways. The results are the
+ * same. This takes more memory, it is meant for languages with modest
+ * inflection.
+ *
+ * Do not call it while other threads use the dictionary.
+ */
+auto Dictionary::enable_expanded_forms() -> void { expand_word_forms(); }
+
+/**
+ * @brief Frees the expanded forms, see enable_expanded_forms()
+ */
+auto Dictionary::disable_expanded_forms() -> void
+{
+	word_forms = Word_Table();
+}
+
+/**
+ * @brief Selects the data structure that stores the words
+ *
+ * The default hash table is fast and can be modified. The DAWG, a minimal
+ * automaton, needs much less memory for the words, which matters when many
+ * dictionaries are loaded at once, but spell() and suggest() are slower.
+ * The perfect hash finds each word with a single probe and has almost no
+ * empty space, building it takes a while. save_binary() saves the built
+ * hash function, so load_from_binary() does not build it again.
+ *
+ * Do not call it while other threads use the dictionary.
+ *
+ * @param store the new word store
+ */
+auto Dictionary::set_word_store(Word_Store store) -> void
+{
+	words.set_word_store(store);
+}
 } // namespace nuspell
@@ -26,6 +26,8 @@
 
 #include "aff_data.hxx"
 
+#include <memory>
+
 namespace nuspell {
 
 enum Affixing_Mode {
@@ -60,17 +62,141 @@ struct Compounding_Result {
 	auto operator-> () const { return word_entry; }
 };
 
+/**
+ * @brief Sub-results of compound checking of one word.
+ *
+ * Compounding tries every split position and recursively checks the rest
+ * of the word, so the same tails are checked again and again. This stores
+ * them by start position, which makes the checking polynomial. It is valid
+ * only while the word is unchanged, when the word gets modified (pattern
+ * replacements, simplified triples) a new one is made for it.
+ *
+ * The storage is taken from a Scratch_Pool.
+ */
+struct Compounding_Memo {
+	using Entry = std::pair<bool, Compounding_Result>;
+	using Storage = std::vector<Entry>;
+
+	Scratch_Pool<Storage>::Ref at_end;
+	Scratch_Pool<Storage>::Ref at_middle;
+
+	Compounding_Memo(Scratch_Pool<Storage>& pool, size_t word_len)
+	    : at_end(pool), at_middle(pool)
+	{
+		at_end->resize(word_len + 1);
+		at_middle->resize(word_len + 1);
+	}
+	auto& end(size_t start_pos) { return (*at_end)[start_pos]; }
+	auto& middle(size_t start_pos) { return (*at_middle)[start_pos]; }
+};
+
+/**
+ * @brief Sub-results of splitting one word by break patterns.
+ *
+ * The parts of the word are index ranges into it. For each part this stores
+ * the result of spell_casing() and the depths at which splitting the part is
+ * known to succeed or fail. A part that splits at some depth splits at all
+ * lower depths too, so these two depths answer every depth. The parts are
+ * kept in a small hash table with open addressing, only the visited ones
+ * take space.
+ *
+ * The storage is taken from a Scratch_Pool.
+ */
+struct Break_Memo {
+	enum Casing_Result : unsigned char { UNKNOWN, NOT_FOUND, GOOD, BAD };
+	struct Entry {
+		size_t key = -1;
+		Casing_Result casing = UNKNOWN;
+		signed char splits_up_to = -1; /**< max depth known to split */
+		signed char fails_from = 127;  /**< min depth known to fail */
+	};
+	using Storage = std::vector<Entry>;
+
+	const std::wstring& word;
+	Scratch_Pool<Storage>& pool;
+	Scratch_Pool<Storage>::Ref parts;
+	size_t num_parts = 0;
+	Scratch_Pool<std::wstring>::Ref part_str;
+
+	Break_Memo(const std::wstring& word, Scratch_Pool<Storage>& pool,
+	           Scratch_Pool<std::wstring>& strings)
+	    : word(word), pool(pool), parts(pool), part_str(strings)
+	{
+		parts->resize(16);
+	}
+	auto part(size_t begin, size_t end) -> Entry&; // implemented in cxx
+};
+
+/**
+ * @brief Reusable temporaries of spell-checking, one set per thread.
+ *
+ * All temporary strings and tables of Dictionary::spell() come from here,
+ * so spelling does not allocate once the buffers are warmed up.
+ */
+struct Spell_Scratch {
+	using Dead_Ends =
+	    std::vector<std::pair<size_t, Compound_Rule_Table::State>>;
+	Scratch_Pool<std::wstring> strings;
+	Scratch_Pool<Compounding_Memo::Storage> memos;
+	Scratch_Pool<Dead_Ends> dead_ends;
+	Scratch_Pool<Break_Memo::Storage> break_memos;
+
+	auto static of_this_thread() -> Spell_Scratch&;
+};
+using Scratch_String = Scratch_Pool<std::wstring>::Ref;
+
 struct Dict_Base : public Aff_Data {
 
 	auto spell_priv(std::wstring& s) const -> bool;
-	auto spell_break(std::wstring& s, size_t depth = 0) const -> bool;
-	auto spell_casing(std::wstring& s) const -> const Flag_Set*;
-	auto spell_casing_upper(std::wstring& s) const -> const Flag_Set*;
-	auto spell_casing_title(std::wstring& s) const -> const Flag_Set*;
+	auto spell_break(std::wstring& s) const -> bool;
+	auto spell_break(Break_Memo& memo, size_t begin, size_t end,
+	                 size_t depth) const -> bool;
+	auto spell_casing(std::wstring& s) const -> Word_List::const_pointer;
+	auto spell_casing_upper(std::wstring& s) const
+	    -> Word_List::const_pointer;
+	auto spell_casing_title(std::wstring& s,
+	                        const Casing_Counts& counts) const
+	    -> Word_List::const_pointer;
 	auto spell_sharps(std::wstring& base, size_t n_pos = 0, size_t n = 0,
-	                  size_t rep = 0) const -> const Flag_Set*;
+	                  size_t rep = 0) const -> Word_List::const_pointer;
 
-	auto check_word(std::wstring& s) const -> const Flag_Set*;
+	/**
+	 * @brief Features of the dictionary that check_word() depends on.
+	 *
+	 * check_word_with() is instantiated for every combination of them
+	 * and update_derived_data() picks one after loading. The checks for
+	 * absent features are compiled out.
+	 */
+	enum Feature : unsigned {
+		HAS_PREFIXES = 1,
+		HAS_SUFFIXES = 2,
+		HAS_CROSS_PRODUCT = 4, /**< cross product prefix and suffix */
+		HAS_CONT_FLAGS = 8,    /**< affixes with continuation flags */
+		HAS_COMPLEX_PREFIXES = 16,
+		HAS_COMPOUNDING = 32,
+		ANY_FEATURES = 64 /**< not known, all is checked at run time */
+	};
+	using Check_Word_Ptr = auto (Dict_Base::*)(std::wstring& s) const
+	                       -> Word_List::const_pointer;
+	Check_Word_Ptr check_word_ptr =
+	    &Dict_Base::check_word_with<ANY_FEATURES>;
+
+	auto features() const -> unsigned;
+	auto update_derived_data() -> void;
+	auto check_word(std::wstring& s) const -> Word_List::const_pointer
+	{
+		update_flag_attributes();
+		return (this->*check_word_ptr)(s);
+	}
+	template <unsigned features>
+	auto check_word_with(std::wstring& s) const
+	    -> Word_List::const_pointer;
+	template <unsigned features>
+	auto check_simple_word_with(std::wstring& s) const
+	    -> Word_List::const_pointer;
+	auto check_simple_word(std::wstring& s) const
+	    -> Word_List::const_pointer;
+	auto expand_word_forms() -> void;
 
 	template <Affixing_Mode m>
 	auto affix_NOT_valid(const Prefix<wchar_t>& a) const;
@@ -81,7 +207,7 @@ struct Dict_Base : public Aff_Data {
 	template <class AffixT>
 	auto is_circumfix(const AffixT& a) const;
 	template <Affixing_Mode m>
-	auto is_valid_inside_compound(const Flag_Set& flags) const;
+	auto is_valid_inside_compound(Flag_Attributes attrs) const;
 
 	/**
 	 * @brief strip_prefix_only
@@ -221,13 +347,14 @@ struct Dict_Base : public Aff_Data {
 
 	template <Affixing_Mode m = AT_COMPOUND_BEGIN>
 	auto check_compound(std::wstring& word, size_t start_pos,
-	                    size_t num_part, std::wstring& part) const
-	    -> Compounding_Result;
+	                    size_t num_part, std::wstring& part,
+	                    Compounding_Memo& memo) const -> Compounding_Result;
 
 	template <Affixing_Mode m = AT_COMPOUND_BEGIN>
 	auto check_compound_classic(std::wstring& word, size_t start_pos,
 	                            size_t i, size_t num_part,
-	                            std::wstring& part) const
+	                            std::wstring& part,
+	                            Compounding_Memo& memo) const
 	    -> Compounding_Result;
 
 	template <Affixing_Mode m = AT_COMPOUND_BEGIN>
@@ -237,16 +364,21 @@ struct Dict_Base : public Aff_Data {
 	                                              std::wstring& part) const
 	    -> Compounding_Result;
 
-	auto check_compound_with_rules(std::wstring& word,
-	                               std::vector<const Flag_Set*>& words_data,
-	                               size_t start_pos,
-	                               std::wstring& part) const
-	    -> Compounding_Result;
+	auto check_compound_with_rules(
+	    std::wstring& word, const Compound_Rule_Table::State& state,
+	    size_t start_pos, std::wstring& part,
+	    std::vector<std::pair<size_t, Compound_Rule_Table::State>>&
+	        dead_ends) const -> Compounding_Result;
 
 	template <Affixing_Mode m>
 	auto check_word_in_compound(std::wstring& s) const
 	    -> Compounding_Result;
 
+	auto check_word_at_compound_end(std::wstring& word, size_t i,
+	                                std::wstring& part,
+	                                Compounding_Memo& memo) const
+	    -> Compounding_Result;
+
 	auto suggest_priv(std::wstring& word, List_WStrings& out) const -> void;
 
 	auto add_sug_if_correct(std::wstring& word, List_WStrings& out) const
@@ -275,6 +407,17 @@ struct Dict_Base : public Aff_Data {
 	auto phonetic_suggest(std::wstring& word, List_WStrings& out) const
 	    -> void;
 
+	auto ngram_suggest(const std::wstring& word, List_WStrings& out) const
+	    -> void;
+
+	auto ngram_suggest_lowercase(const std::wstring& word, Casing casing,
+	                             List_WStrings& out) const -> void;
+
+	auto expand_root_word(const std::wstring& root,
+	                      Word_List::const_reference root_entry,
+	                      const std::wstring& word,
+	                      List_WStrings& forms) const -> void;
+
       public:
 	Dict_Base()
 	    : Aff_Data() // we explicity do value init so content is zeroed
@@ -292,31 +435,63 @@ class Dictionary_Loading_Error : public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
 
+/**
+ * @brief Hit and miss counters of the result cache of Dictionary
+ */
+struct Cache_Stats {
+	size_t spell_hits = 0;
+	size_t spell_misses = 0;
+	size_t suggest_hits = 0;
+	size_t suggest_misses = 0;
+};
+
 /**
  * @brief The only important public class
  */
 class Dictionary : private Dict_Base {
+	struct Result_Cache;
+
 	std::locale external_locale;
 	bool external_locale_known_utf8;
+	std::shared_ptr<Result_Cache> cache;
 
 	Dictionary(std::istream& aff, std::istream& dic);
-	auto external_to_internal_encoding(const std::string& in,
+	Dictionary(string_view aff, string_view dic);
+	auto external_to_internal_encoding(string_view in,
 	                                   std::wstring& wide_out) const
 	    -> bool;
 
 	auto internal_to_external_encoding(const std::wstring& wide_in,
 	                                   std::string& out) const -> bool;
 
+	auto spell_cached(std::wstring& word) const -> bool;
+	static constexpr size_t max_batch_stems = 4;
+	auto stem_hashes(const std::wstring& word, size_t* out) const
+	    -> size_t;
+	auto suggest_cached(std::wstring& word, List_WStrings& out) const
+	    -> void;
+
       public:
 	Dictionary();
 	auto static load_from_aff_dic(std::istream& aff, std::istream& dic)
 	    -> Dictionary;
 	auto static load_from_path(
 	    const std::string& file_path_without_extension) -> Dictionary;
+	auto static load_from_binary(const std::string& file_path)
+	    -> Dictionary;
+	auto save_binary(const std::string& file_path) const -> bool;
 	auto imbue(const std::locale& loc) -> void;
 	auto spell(const std::string& word) const -> bool;
+	auto spell_batch(span<const string_view> words, span<bool> out) const
+	    -> void;
 	auto suggest(const std::string& word,
 	             std::vector<std::string>& out) const -> void;
+	auto enable_cache(size_t max_words = 10000) -> void;
+	auto disable_cache() -> void;
+	auto cache_stats() const -> Cache_Stats;
+	auto enable_expanded_forms() -> void;
+	auto disable_expanded_forms() -> void;
+	auto set_word_store(Word_Store store) -> void;
 };
 } // namespace v2
 } // namespace nuspell
@@ -19,16 +19,24 @@
 #include "locale_utils.hxx"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/locale/utf8_codecvt.hpp>
 
+#include <unicode/ucasemap.h>
 #include <unicode/uchar.h>
 #include <unicode/ucnv.h>
 #include <unicode/unistr.h>
 #include <unicode/ustring.h>
 
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NUSPELL_HAVE_SSE2 1
+#endif
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
@@ -50,23 +58,176 @@ using namespace std;
 #define unlikely(expr) (expr)
 #endif
 
-auto validate_utf8(const std::string& s) -> bool
+namespace {
+/**
+ * @brief Counts the leading ASCII bytes.
+ *
+ * Checks 16 bytes at once with SSE2, or 8 bytes in an integer otherwise.
+ */
+auto count_ascii(string_view s) -> size_t
+{
+	auto p = s.data();
+	auto n = s.size();
+	size_t i = 0;
+#ifdef NUSPELL_HAVE_SSE2
+	for (; n - i >= 16; i += 16) {
+		auto b =
+		    _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+		if (_mm_movemask_epi8(b))
+			break;
+	}
+#else
+	for (; n - i >= 8; i += 8) {
+		uint64_t b;
+		memcpy(&b, p + i, 8);
+		if (b & 0x8080808080808080)
+			break;
+	}
+#endif
+	while (i != n && static_cast<unsigned char>(p[i]) < 0x80)
+		++i;
+	return i;
+}
+
+/**
+ * @brief Copies the leading ASCII characters, converting the code units.
+ * @return The number of copied characters, at most @p n.
+ */
+template <class InChar, class OutChar>
+auto copy_ascii(const InChar* in, size_t n, OutChar* out) -> size_t
+{
+	using U = make_unsigned_t<InChar>;
+	size_t i = 0;
+	for (; i != n && static_cast<U>(in[i]) < 0x80; ++i)
+		out[i] = static_cast<OutChar>(in[i]);
+	return i;
+}
+
+#if defined(NUSPELL_HAVE_SSE2) && WCHAR_MAX > 0xFFFF
+auto copy_ascii(const char* in, size_t n, wchar_t* out) -> size_t
+{
+	auto zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; n - i >= 16; i += 16) {
+		auto b =
+		    _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		if (_mm_movemask_epi8(b))
+			break;
+		auto lo = _mm_unpacklo_epi8(b, zero);
+		auto hi = _mm_unpackhi_epi8(b, zero);
+		auto o = reinterpret_cast<__m128i*>(out + i);
+		_mm_storeu_si128(o, _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128(o + 1, _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128(o + 2, _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128(o + 3, _mm_unpackhi_epi16(hi, zero));
+	}
+	return i + copy_ascii<char, wchar_t>(in + i, n - i, out + i);
+}
+
+auto copy_ascii(const wchar_t* in, size_t n, char* out) -> size_t
+{
+	auto zero = _mm_setzero_si128();
+	auto non_ascii = _mm_set1_epi32(~0x7F);
+	size_t i = 0;
+	for (; n - i >= 16; i += 16) {
+		auto p = reinterpret_cast<const __m128i*>(in + i);
+		auto a = _mm_loadu_si128(p);
+		auto b = _mm_loadu_si128(p + 1);
+		auto c = _mm_loadu_si128(p + 2);
+		auto d = _mm_loadu_si128(p + 3);
+		auto all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+		all = _mm_cmpeq_epi32(_mm_and_si128(all, non_ascii), zero);
+		if (_mm_movemask_epi8(all) != 0xFFFF)
+			break;
+		auto bytes = _mm_packus_epi16(_mm_packs_epi32(a, b),
+		                              _mm_packs_epi32(c, d));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+	}
+	return i + copy_ascii<wchar_t, char>(in + i, n - i, out + i);
+}
+#endif
+
+/**
+ * @brief Copies the run of ASCII characters at the input position.
+ */
+template <class InIt, class OutIt>
+auto copy_ascii_run(InIt& it, InIt last, OutIt& out_it, OutIt out_last)
+    -> void
+{
+	using InChar = typename iterator_traits<InIt>::value_type;
+	using OutChar = typename iterator_traits<OutIt>::value_type;
+	using U = make_unsigned_t<InChar>;
+	if (static_cast<U>(*it) >= 0x80)
+		return;
+	auto n = min<size_t>(last - it, out_last - out_it);
+	if (n < 16) {
+		// short runs, as in most words, are not worth a call
+		for (; n != 0 && static_cast<U>(*it) < 0x80; --n)
+			*out_it++ = static_cast<OutChar>(*it++);
+		return;
+	}
+	auto k = copy_ascii(&*it, n, &*out_it);
+	it += k;
+	out_it += k;
+}
+
+/**
+ * @brief Decodes one code point, sequences of two and three bytes inline.
+ *
+ * Those are all of the Basic Multilingual Plane, the four-byte sequences
+ * are left to Boost.
+ */
+template <class InIt>
+auto decode_utf(InIt& it, InIt last) -> boost::locale::utf::code_point
+{
+	using namespace boost::locale::utf;
+	using InChar = typename iterator_traits<InIt>::value_type;
+	if (is_same<InChar, char>::value) {
+		auto c = static_cast<unsigned char>(*it);
+		if (0xC2 <= c && c < 0xE0 && last - it >= 2) {
+			auto t = static_cast<unsigned char>(it[1]);
+			if ((t & 0xC0) == 0x80) {
+				it += 2;
+				return (c & 0x1F) << 6 | (t & 0x3F);
+			}
+		}
+		else if ((c & 0xF0) == 0xE0 && last - it >= 3) {
+			auto t1 = static_cast<unsigned char>(it[1]);
+			auto t2 = static_cast<unsigned char>(it[2]);
+			code_point cp =
+			    (c & 0x0F) << 12 | (t1 & 0x3F) << 6 | (t2 & 0x3F);
+			if ((t1 & 0xC0) == 0x80 && (t2 & 0xC0) == 0x80 &&
+			    cp >= 0x800 && (cp < 0xD800 || cp > 0xDFFF)) {
+				it += 3;
+				return cp;
+			}
+		}
+	}
+	return utf_traits<InChar>::decode(it, last);
+}
+} // namespace
+
+auto validate_utf8(string_view s) -> bool
 {
 	using namespace boost::locale::utf;
 	auto first = begin(s);
 	auto last = end(s);
 	while (first != last) {
-		auto cp = utf_traits<char>::decode(first, last);
+		if (static_cast<unsigned char>(*first) < 0x80) {
+			first += count_ascii(s.substr(first - begin(s)));
+			continue;
+		}
+		auto cp = decode_utf(first, last);
 		if (unlikely(cp == incomplete || cp == illegal))
 			return false;
 	}
 	return true;
 }
 
-template <class InChar, class OutContainer>
-auto valid_utf_to_utf(const std::basic_string<InChar>& in, OutContainer& out)
-    -> void
+template <class InRange, class OutContainer>
+auto valid_utf_to_utf(const InRange& in, OutContainer& out) -> void
 {
+	using InChar = typename InRange::value_type;
 	using OutChar = typename OutContainer::value_type;
 	using namespace boost::locale::utf;
 	auto constexpr max_out_width = utf_traits<OutChar>::max_width;
@@ -83,6 +244,9 @@ auto valid_utf_to_utf(const std::basic_string<InChar>& in, OutContainer& out)
 	auto out_it = begin(out);
 	auto out_last = end(out);
 	while (it != last) {
+		copy_ascii_run(it, last, out_it, out_last);
+		if (it == last)
+			break;
 		auto cp = utf_traits<InChar>::decode_valid(it);
 		if (unlikely(out_last - out_it <
 		             utf_traits<OutChar>::width(cp))) {
@@ -97,9 +261,8 @@ auto valid_utf_to_utf(const std::basic_string<InChar>& in, OutContainer& out)
 	out.erase(out_it, end(out));
 }
 
-template <class InChar, class OutContainer>
-auto utf_to_utf_my(const std::basic_string<InChar>& in, OutContainer& out)
-    -> bool
+template <class InRange, class OutContainer>
+auto utf_to_utf_my(const InRange& in, OutContainer& out) -> bool
 {
 	using OutChar = typename OutContainer::value_type;
 	using namespace boost::locale::utf;
@@ -118,7 +281,10 @@ auto utf_to_utf_my(const std::basic_string<InChar>& in, OutContainer& out)
 	auto out_last = end(out);
 	auto valid = true;
 	while (it != last) {
-		auto cp = utf_traits<InChar>::decode(it, last);
+		copy_ascii_run(it, last, out_it, out_last);
+		if (it == last)
+			break;
+		auto cp = decode_utf(it, last);
 		if (unlikely(cp == incomplete || cp == illegal)) {
 			valid = false;
 			continue;
@@ -153,35 +319,32 @@ auto wide_to_utf8(const std::wstring& in,
 	return valid_utf_to_utf(in, out);
 }
 
-auto utf8_to_wide(const std::string& in, std::wstring& out) -> bool
+auto utf8_to_wide(string_view in, std::wstring& out) -> bool
 {
 	return utf_to_utf_my(in, out);
 }
-auto utf8_to_wide(const std::string& in) -> std::wstring
+auto utf8_to_wide(string_view in) -> std::wstring
 {
 	auto out = wstring();
 	utf_to_utf_my(in, out);
 	return out;
 }
 
-auto utf8_to_16(const std::string& in) -> std::u16string
+auto utf8_to_16(string_view in) -> std::u16string
 {
 	auto out = u16string();
 	utf_to_utf_my(in, out);
 	return out;
 }
 
-bool utf8_to_16(const std::string& in, std::u16string& out)
+bool utf8_to_16(string_view in, std::u16string& out)
 {
 	return utf_to_utf_my(in, out);
 }
 
 auto is_ascii(char c) -> bool { return static_cast<unsigned char>(c) <= 127; }
 
-auto is_all_ascii(const std::string& s) -> bool
-{
-	return all_of(begin(s), end(s), is_ascii);
-}
+auto is_all_ascii(string_view s) -> bool { return count_ascii(s) == s.size(); }
 
 template <class CharT>
 auto widen_latin1(char c) -> CharT
@@ -189,13 +352,13 @@ auto widen_latin1(char c) -> CharT
 	return static_cast<unsigned char>(c);
 }
 
-auto latin1_to_ucs2(const std::string& s) -> std::u16string
+auto latin1_to_ucs2(string_view s) -> std::u16string
 {
 	u16string ret;
 	latin1_to_ucs2(s, ret);
 	return ret;
 }
-auto latin1_to_ucs2(const std::string& s, std::u16string& out) -> void
+auto latin1_to_ucs2(string_view s, std::u16string& out) -> void
 {
 	out.resize(s.size());
 	transform(begin(s), end(s), begin(out), widen_latin1<char16_t>);
@@ -210,14 +373,13 @@ auto is_all_bmp(const std::u16string& s) -> bool
 	return none_of(begin(s), end(s), is_surrogate_pair);
 }
 
-auto to_wide(const std::string& in, const std::locale& loc, std::wstring& out)
-    -> bool
+auto to_wide(string_view in, const std::locale& loc, std::wstring& out) -> bool
 {
 	auto& cvt = use_facet<codecvt<wchar_t, char, mbstate_t>>(loc);
 	out.resize(in.size(), L'\0');
 	auto state = mbstate_t();
-	auto in_ptr = in.c_str();
-	auto in_last = in.c_str() + in.size();
+	auto in_ptr = in.data();
+	auto in_last = in.data() + in.size();
 	auto out_ptr = &out[0];
 	auto out_last = &out[out.size()];
 	auto valid = true;
@@ -256,7 +418,7 @@ auto to_wide(const std::string& in, const std::locale& loc, std::wstring& out)
 	return valid;
 }
 
-auto to_wide(const std::string& in, const std::locale& loc) -> std::wstring
+auto to_wide(string_view in, const std::locale& loc) -> std::wstring
 {
 	auto ret = wstring();
 	to_wide(in, loc, ret);
@@ -374,66 +536,370 @@ auto icu_to_wide(const icu::UnicodeString& in, std::wstring& out) -> bool
 	return false;
 }
 
+namespace {
+/**
+ * @brief Buffers of a thread for case mapping.
+ *
+ * ICU maps case in UTF-16. The buffers and the break iterator needed for
+ * title casing are kept between calls, so case mapping of short words does
+ * not allocate.
+ */
+struct Case_Map_Buffers {
+	u16string in;
+	u16string out;
+	UCaseMap* title_map = nullptr;
+	string title_locale;
+
+	Case_Map_Buffers() = default;
+	Case_Map_Buffers(const Case_Map_Buffers&) = delete;
+	auto operator=(const Case_Map_Buffers&) = delete;
+	~Case_Map_Buffers() { ucasemap_close(title_map); }
+};
+auto case_map_buffers() -> Case_Map_Buffers&
+{
+	static thread_local Case_Map_Buffers b;
+	return b;
+}
+
+template <class Func>
+auto map_case(wstring_view in, std::wstring& out, Func f) -> void
+{
+	auto& b = case_map_buffers();
+	valid_utf_to_utf(in, b.in);
+	auto err = U_ZERO_ERROR;
+	b.out.resize(b.out.capacity());
+	auto len = f(&b.out[0], b.out.size(), b.in.data(), b.in.size(), err);
+	if (err == U_BUFFER_OVERFLOW_ERROR) {
+		b.out.resize(len);
+		err = U_ZERO_ERROR;
+		len = f(&b.out[0], b.out.size(), b.in.data(), b.in.size(),
+		        err);
+	}
+	if (U_FAILURE(err)) {
+		out.clear();
+		return;
+	}
+	b.out.resize(len);
+	valid_utf_to_utf(b.out, out);
+}
+
+/**
+ * @brief Table of simple case mappings of the code points below 0x2000.
+ *
+ * It covers ASCII, Latin, IPA, Greek, Cyrillic, Armenian and the extended
+ * Latin and Greek blocks. A mapping is marked usable only if it maps one
+ * code point to one code point, independently of context. Code points like
+ * ß (upper case SS), İ (lower case i with combining dot) or Σ (final sigma)
+ * are not marked, nor the code points outside the table, words with them
+ * are mapped by ICU.
+ */
+class Case_Table {
+      public:
+	enum : unsigned char {
+		UPPER_OK = 1,
+		LOWER_OK = 2,
+		TITLE_OK = 4,
+		CASED_LETTER = 8, /**< Lu, Ll or Lt */
+		UPPER_LETTER = 16, /**< Lu, as u_isupper() */
+		LOWER_LETTER = 32 /**< Ll, as u_islower() */
+	};
+	struct Entry {
+		char16_t upper;
+		char16_t lower;
+		char16_t title;
+		unsigned char flags;
+	};
+	static constexpr char32_t size = 0x2000;
+
+      private:
+	Entry entries[size];
+
+      public:
+	Case_Table()
+	{
+		// whether the full mapping of c is the simple one
+		auto full_is_simple = [](UChar32 c, UChar32 simple, auto map) {
+			UChar in = c;
+			UChar out[8];
+			auto err = U_ZERO_ERROR;
+			auto len = map(out, 8, &in, 1, "", &err);
+			return U_SUCCESS(err) && len == 1 && out[0] == simple;
+		};
+		for (char32_t c = 0; c != size; ++c) {
+			auto& e = entries[c];
+			e.upper = u_toupper(c);
+			e.lower = u_tolower(c);
+			e.title = u_totitle(c);
+			e.flags = 0;
+			if (U_IS_SURROGATE(c))
+				continue;
+			if (full_is_simple(c, e.upper, u_strToUpper))
+				e.flags |= UPPER_OK;
+			if (full_is_simple(c, e.lower, u_strToLower))
+				e.flags |= LOWER_OK;
+			// Code points with special title case have special
+			// upper case too.
+			if (e.flags & UPPER_OK)
+				e.flags |= TITLE_OK;
+			auto cat = u_charType(c);
+			if (cat == U_UPPERCASE_LETTER ||
+			    cat == U_LOWERCASE_LETTER ||
+			    cat == U_TITLECASE_LETTER)
+				e.flags |= CASED_LETTER;
+			if (cat == U_UPPERCASE_LETTER)
+				e.flags |= UPPER_LETTER;
+			else if (cat == U_LOWERCASE_LETTER)
+				e.flags |= LOWER_LETTER;
+		}
+		// lower case depends on the position in the word
+		entries[0x03A3].flags &= ~(LOWER_OK | TITLE_OK);
+	}
+	auto find(wchar_t c) const -> const Entry*
+	{
+		auto u = static_cast<std::make_unsigned_t<wchar_t>>(c);
+		return u < size ? &entries[u] : nullptr;
+	}
+};
+
+auto case_table() -> const Case_Table&
+{
+	auto static const t = Case_Table();
+	return t;
+}
+
+/**
+ * @brief Checks if ICU has locale-specific case mappings for the language.
+ *
+ * Turkish and Azerbaijani dotted and dotless i, Lithuanian dot above, Greek
+ * upper case without accents and Dutch IJ at the start of title case.
+ */
+auto has_special_casing(const icu::Locale& loc) -> bool
+{
+	auto lang = loc.getLanguage();
+	for (auto l : {"tr", "az", "lt", "el", "nl"})
+		if (strcmp(lang, l) == 0)
+			return true;
+	return false;
+}
+
+/**
+ * @brief Maps with the case table, returns false if ICU is needed.
+ */
+template <class Func>
+auto map_case_with_table(wstring_view in, const icu::Locale& loc,
+                         std::wstring& out, unsigned char flag, Func f)
+    -> bool
+{
+	if (has_special_casing(loc))
+		return false;
+	auto& tbl = case_table();
+	out.resize(in.size());
+	for (size_t i = 0; i != in.size(); ++i) {
+		auto e = tbl.find(in[i]);
+		if (!e || !(e->flags & flag))
+			return false;
+		out[i] = f(*e);
+	}
+	return true;
+}
+} // namespace
+
+/**
+ * @brief Maps to upper case into a buffer.
+ *
+ * The output reuses the capacity of @p out, which must not overlap @p in.
+ * Words in Latin, Greek and Cyrillic script are mapped with a table, the
+ * rest and the locales with special rules with ICU.
+ */
+auto to_upper(wstring_view in, const icu::Locale& loc, std::wstring& out)
+    -> void
+{
+	using tbl = Case_Table;
+	if (map_case_with_table(in, loc, out, tbl::UPPER_OK,
+	                        [](auto& e) { return e.upper; }))
+		return;
+	map_case(in, out, [&](auto dest, auto cap, auto src, auto len,
+	                      auto& err) {
+		return u_strToUpper(dest, cap, src, len, loc.getName(), &err);
+	});
+}
+
+/**
+ * @brief Maps to title case into a buffer, see to_upper().
+ *
+ * The table is used only for words made of cased letters, those are single
+ * words for the word break iterator used by ICU.
+ */
+auto to_title(wstring_view in, const icu::Locale& loc, std::wstring& out)
+    -> void
+{
+	using tbl = Case_Table;
+	auto first = true;
+	if (map_case_with_table(in, loc, out, tbl::CASED_LETTER,
+	                        [&](auto& e) -> wchar_t {
+		                        auto f = first;
+		                        first = false;
+		                        if (f && e.flags & tbl::TITLE_OK)
+			                        return e.title;
+		                        if (!f && e.flags & tbl::LOWER_OK)
+			                        return e.lower;
+		                        return 0;
+	                        }) &&
+	    out.find(L'\0') == out.npos)
+		return;
+	auto& b = case_map_buffers();
+	if (!b.title_map || b.title_locale != loc.getName()) {
+		auto err = U_ZERO_ERROR;
+		ucasemap_close(b.title_map);
+		b.title_map = ucasemap_open(loc.getName(), 0, &err);
+		b.title_locale = loc.getName();
+		if (U_FAILURE(err)) {
+			ucasemap_close(b.title_map);
+			b.title_map = nullptr;
+			out.clear();
+			return;
+		}
+	}
+	map_case(in, out, [&](auto dest, auto cap, auto src, auto len,
+	                      auto& err) {
+		return ucasemap_toTitle(b.title_map, dest, cap, src, len,
+		                        &err);
+	});
+}
+
+/**
+ * @brief Maps to lower case into a buffer, see to_upper().
+ */
+auto to_lower(wstring_view in, const icu::Locale& loc, std::wstring& out)
+    -> void
+{
+	using tbl = Case_Table;
+	if (map_case_with_table(in, loc, out, tbl::LOWER_OK,
+	                        [](auto& e) { return e.lower; }))
+		return;
+	map_case(in, out, [&](auto dest, auto cap, auto src, auto len,
+	                      auto& err) {
+		return u_strToLower(dest, cap, src, len, loc.getName(), &err);
+	});
+}
+
 auto to_upper(const std::wstring& in, const icu::Locale& loc) -> std::wstring
 {
-	auto us = icu::UnicodeString();
 	auto out = wstring();
-	wide_to_icu(in, us);
-	us.toUpper(loc);
-	icu_to_wide(us, out);
+	to_upper(in, loc, out);
 	return out;
 }
 auto to_title(const std::wstring& in, const icu::Locale& loc) -> std::wstring
 {
-	auto us = icu::UnicodeString();
 	auto out = wstring();
-	wide_to_icu(in, us);
-	us.toTitle(nullptr, loc);
-	icu_to_wide(us, out);
+	to_title(in, loc, out);
 	return out;
 }
 auto to_lower(const std::wstring& in, const icu::Locale& loc) -> std::wstring
 {
-	auto us = icu::UnicodeString();
 	auto out = wstring();
-	wide_to_icu(in, us);
-	us.toLower(loc);
-	icu_to_wide(us, out);
+	to_lower(in, loc, out);
 	return out;
 }
 
+namespace {
+/**
+ * @brief Counts upper and lower case letters in blocks of ASCII characters.
+ *
+ * With SSE2 four characters are compared at once. Stops at the first block
+ * that has a character that is not ASCII.
+ *
+ * @return The number of characters counted.
+ */
+auto count_ascii_casing(wstring_view s, Casing_Counts& c) -> size_t
+{
+	size_t i = 0;
+#if defined(NUSPELL_HAVE_SSE2) && WCHAR_MAX > 0xFFFF
+	// bit counts and lowest set bits of the 4-bit lane masks
+	static const unsigned char popcount[16] = {0, 1, 1, 2, 1, 2, 2, 3,
+	                                           1, 2, 2, 3, 2, 3, 3, 4};
+	static const unsigned char lowest[16] = {4, 0, 1, 0, 2, 0, 1, 0,
+	                                         3, 0, 1, 0, 2, 0, 1, 0};
+	auto zero = _mm_setzero_si128();
+	auto non_ascii = _mm_set1_epi32(~0x7F);
+	auto before_a = _mm_set1_epi32('A' - 1);
+	auto after_z = _mm_set1_epi32('Z' + 1);
+	auto case_bit = _mm_set1_epi32(0x20);
+	for (; s.size() - i >= 4; i += 4) {
+		auto v = _mm_loadu_si128(
+		    reinterpret_cast<const __m128i*>(s.data() + i));
+		auto ascii = _mm_cmpeq_epi32(_mm_and_si128(v, non_ascii), zero);
+		if (_mm_movemask_epi8(ascii) != 0xFFFF)
+			break;
+		// 'a' - 'z' are 'A' - 'Z' with the bit 0x20 set
+		auto folded = _mm_andnot_si128(case_bit, v);
+		auto letter = _mm_and_si128(_mm_cmpgt_epi32(folded, before_a),
+		                            _mm_cmplt_epi32(folded, after_z));
+		auto is_lower = _mm_cmpeq_epi32(_mm_and_si128(v, case_bit),
+		                                case_bit);
+		auto upper = _mm_andnot_si128(is_lower, letter);
+		auto lower = _mm_and_si128(is_lower, letter);
+		auto upper_mask =
+		    _mm_movemask_ps(_mm_castsi128_ps(upper));
+		auto lower_mask =
+		    _mm_movemask_ps(_mm_castsi128_ps(lower));
+		if (upper_mask && c.upper == 0)
+			c.first_capital = i + lowest[upper_mask];
+		c.upper += popcount[upper_mask];
+		c.lower += popcount[lower_mask];
+	}
+#else
+	(void)s;
+	(void)c;
+#endif
+	return i;
+}
+} // namespace
+
 /**
  * @brief Determines casing (capitalization) type for a word.
  *
- * Casing is sometimes referred to as capitalization.
+ * Casing is sometimes referred to as capitalization. Blocks of ASCII
+ * characters are classified with SIMD and the letters of the scripts of
+ * the case table with a lookup, only other characters query ICU.
  *
  * @param s word for which casing is determined.
+ * @param[out] counts the upper and lower case letters of the word.
  * @return The casing type.
  */
-auto classify_casing(const std::wstring& s) -> Casing
+auto classify_casing(wstring_view s, Casing_Counts& counts) -> Casing
 {
 	// TODO implement Default Case Detection from unicode standard
 	// https://www.unicode.org/versions/Unicode11.0.0/ch03.pdf
 	// See Chapter 13.3. This might be feature for Boost or ICU.
 
 	using namespace std;
-	size_t upper = 0;
-	size_t lower = 0;
-	for (auto& c : s) {
-		if (u_isupper(c))
-			upper++;
-		else if (u_islower(c))
-			lower++;
+	using tbl = Case_Table;
+	auto& table = case_table();
+	auto& c = counts;
+	c = Casing_Counts();
+	for (auto i = count_ascii_casing(s, c); i != s.size(); ++i) {
+		auto e = table.find(s[i]);
+		auto is_upper = e ? (e->flags & tbl::UPPER_LETTER) != 0
+		                  : u_isupper(s[i]);
+		if (is_upper) {
+			if (c.upper++ == 0)
+				c.first_capital = i;
+		}
+		else if (e ? (e->flags & tbl::LOWER_LETTER) != 0
+		           : u_islower(s[i])) {
+			c.lower++;
+		}
 		// else neutral
 	}
-	if (upper == 0)               // all lowercase, maybe with some neutral
+	if (c.upper == 0)             // all lowercase, maybe with some neutral
 		return Casing::SMALL; // most common case
 
-	auto first_capital = u_isupper(s[0]);
-	if (first_capital && upper == 1)
+	auto first_capital = c.first_capital == 0;
+	if (first_capital && c.upper == 1)
 		return Casing::INIT_CAPITAL; // second most common
 
-	if (lower == 0)
+	if (c.lower == 0)
 		return Casing::ALL_CAPITAL;
 
 	if (first_capital)
@@ -442,6 +908,12 @@ auto classify_casing(const std::wstring& s) -> Casing
 		return Casing::CAMEL;
 }
 
+auto classify_casing(const std::wstring& s) -> Casing
+{
+	auto counts = Casing_Counts();
+	return classify_casing(s, counts);
+}
+
 /**
  * @brief Check if word[i] or word[i-1] are uppercase
  *
@@ -501,10 +973,10 @@ auto Encoding_Converter::operator=(const Encoding_Converter& other)
 	return *this;
 }
 
-auto Encoding_Converter::to_wide(const string& in, wstring& out) -> bool
+auto Encoding_Converter::to_wide(string_view in, wstring& out) -> bool
 {
 	auto err = U_ZERO_ERROR;
-	auto us = icu::UnicodeString(in.c_str(), in.size(), cnv, err);
+	auto us = icu::UnicodeString(in.data(), in.size(), cnv, err);
 	if (U_FAILURE(err)) {
 		out.clear();
 		return false;
@@ -514,7 +986,7 @@ auto Encoding_Converter::to_wide(const string& in, wstring& out) -> bool
 	return false;
 }
 
-auto Encoding_Converter::to_wide(const string& in) -> wstring
+auto Encoding_Converter::to_wide(string_view in) -> wstring
 {
 	auto out = wstring();
 	this->to_wide(in, out);
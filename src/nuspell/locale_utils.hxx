@@ -24,6 +24,8 @@
 #ifndef NUSPELL_LOCALE_UTILS_HXX
 #define NUSPELL_LOCALE_UTILS_HXX
 
+#include "string_utils.hxx"
+
 #include <locale>
 #include <string>
 
@@ -34,30 +36,30 @@ struct UConverter; // unicode/ucnv.h
 
 namespace nuspell {
 
-auto validate_utf8(const std::string& s) -> bool;
+auto validate_utf8(string_view s) -> bool;
 
 auto wide_to_utf8(const std::wstring& in, std::string& out) -> void;
 auto wide_to_utf8(const std::wstring& in) -> std::string;
 auto wide_to_utf8(const std::wstring& in,
                   boost::container::small_vector_base<char>& out) -> void;
 
-auto utf8_to_wide(const std::string& in, std::wstring& out) -> bool;
-auto utf8_to_wide(const std::string& in) -> std::wstring;
+auto utf8_to_wide(string_view in, std::wstring& out) -> bool;
+auto utf8_to_wide(string_view in) -> std::wstring;
 
-auto utf8_to_16(const std::string& in) -> std::u16string;
-auto utf8_to_16(const std::string& in, std::u16string& out) -> bool;
+auto utf8_to_16(string_view in) -> std::u16string;
+auto utf8_to_16(string_view in, std::u16string& out) -> bool;
 
 auto is_ascii(char c) -> bool;
-auto is_all_ascii(const std::string& s) -> bool;
+auto is_all_ascii(string_view s) -> bool;
 
-auto latin1_to_ucs2(const std::string& s) -> std::u16string;
-auto latin1_to_ucs2(const std::string& s, std::u16string& out) -> void;
+auto latin1_to_ucs2(string_view s) -> std::u16string;
+auto latin1_to_ucs2(string_view s, std::u16string& out) -> void;
 
 auto is_all_bmp(const std::u16string& s) -> bool;
 
-auto to_wide(const std::string& in, const std::locale& inloc, std::wstring& out)
+auto to_wide(string_view in, const std::locale& inloc, std::wstring& out)
     -> bool;
-auto to_wide(const std::string& in, const std::locale& inloc) -> std::wstring;
+auto to_wide(string_view in, const std::locale& inloc) -> std::wstring;
 auto to_narrow(const std::wstring& in, std::string& out,
                const std::locale& outloc) -> bool;
 auto to_narrow(const std::wstring& in, const std::locale& outloc)
@@ -71,6 +73,12 @@ auto icu_to_wide(const icu::UnicodeString& in, std::wstring& out) -> bool;
 auto to_upper(const std::wstring& in, const icu::Locale& loc) -> std::wstring;
 auto to_title(const std::wstring& in, const icu::Locale& loc) -> std::wstring;
 auto to_lower(const std::wstring& in, const icu::Locale& loc) -> std::wstring;
+auto to_upper(wstring_view in, const icu::Locale& loc, std::wstring& out)
+    -> void;
+auto to_title(wstring_view in, const icu::Locale& loc, std::wstring& out)
+    -> void;
+auto to_lower(wstring_view in, const icu::Locale& loc, std::wstring& out)
+    -> void;
 
 /**
  * @brief Casing type enum, ignoring neutral case characters.
@@ -83,6 +91,16 @@ enum class Casing {
 	PASCAL /**< pascal case, start upper case, e.g. "PascalCase" */
 };
 
+/**
+ * @brief Counts of cased letters found by classify_casing().
+ */
+struct Casing_Counts {
+	size_t upper = 0;
+	size_t lower = 0;
+	size_t first_capital = std::wstring::npos; /**< index of first upper */
+};
+
+auto classify_casing(wstring_view s, Casing_Counts& counts) -> Casing;
 auto classify_casing(const std::wstring& s) -> Casing;
 
 auto has_uppercase_at_compound_word_boundary(const std::wstring& word, size_t i)
@@ -122,7 +140,7 @@ class Encoding {
 	operator const std::string&() const { return name; }
 	auto& value() const { return name; }
 	auto is_utf8() const { return name == "UTF-8"; }
-	auto value_or_default() -> std::string
+	auto value_or_default() const -> std::string
 	{
 		if (name.empty())
 			return "ISO8859-1";
@@ -155,8 +173,8 @@ class Encoding_Converter {
 		std::swap(cnv, other.cnv);
 		return *this;
 	}
-	auto to_wide(const std::string& in, std::wstring& out) -> bool;
-	auto to_wide(const std::string& in) -> std::wstring;
+	auto to_wide(string_view in, std::wstring& out) -> bool;
+	auto to_wide(string_view in) -> std::wstring;
 };
 } // namespace nuspell
 #endif // NUSPELL_LOCALE_UTILS_HXX
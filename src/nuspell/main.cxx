@@ -20,9 +20,12 @@
 #include "finder.hxx"
 #include "string_utils.hxx"
 
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 
 #include <boost/locale.hpp>
 
@@ -67,6 +70,7 @@ struct Args_t {
 	string encoding;
 	vector<string> other_dicts;
 	vector<string> files;
+	size_t num_threads = 1;
 
 	Args_t() = default;
 	Args_t(int argc, char* argv[]) { parse_args(argc, argv); }
@@ -89,7 +93,7 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 	int c;
 	// The program can run in various modes depending on the
 	// command line options. mode is FSM state, this while loop is FSM.
-	const char* shortopts = ":d:i:aDGLSlhv";
+	const char* shortopts = ":d:i:j:aDGLSlhv";
 	const struct option longopts[] = {
 	    {"version", 0, nullptr, 'v'},
 	    {"help", 0, nullptr, 'h'},
@@ -117,6 +121,18 @@ auto Args_t::parse_args(int argc, char* argv[]) -> void
 			encoding = optarg;
 
 			break;
+		case 'j': {
+			char* end = nullptr;
+			auto n = strtol(optarg, &end, 10);
+			if (end == optarg || *end != '\0' || n < 1) {
+				cerr << "Invalid number of threads " << optarg
+				     << '\n';
+				mode = ERROR_MODE;
+				break;
+			}
+			num_threads = n;
+			break;
+		}
 		case 'D':
 			if (mode == DEFAULT_MODE)
 				mode = LIST_DICTIONARIES_MODE;
@@ -211,7 +227,7 @@ class My_Dictionary : public Dictionary {
 		static_cast<Dictionary&>(*this) = move(d);
 		return *this;
 	}
-	auto spell(const string& word)
+	auto spell(const string& word) const
 	{
 		auto correct = Dictionary::spell(word);
 		if (correct)
@@ -269,8 +285,9 @@ auto print_help(const string& program_name) -> void
 	auto& o = cout;
 	o << "Usage:\n"
 	     "\n";
-	o << p << " [-S] [-d dict_NAME] [-i enc] [file_name]...\n";
-	o << p << " -l|-G [-L] [-d dict_NAME] [-i enc] [file_name]...\n";
+	o << p << " [-S] [-d dict_NAME] [-i enc] [-j N] [file_name]...\n";
+	o << p << " -l|-G [-L] [-d dict_NAME] [-i enc] [-j N] "
+	          "[file_name]...\n";
 	o << p << " -D|-h|--help|-v|--version\n";
 	o << "\n"
 	     "Check spelling of each FILE. Without FILE, check standard "
@@ -281,6 +298,7 @@ auto print_help(const string& program_name) -> void
 	     "  -D            print search paths and available dictionaries\n"
 	     "                and exit\n"
 	     "  -i enc        input/output encoding, default is active locale\n"
+	     "  -j N          check with N threads, output order is kept\n"
 	     "  -l            print only misspelled words or lines\n"
 	     "  -G            print only correct words or lines\n"
 	     "  -L            lines mode\n"
@@ -355,7 +373,7 @@ auto list_dictionaries(const Finder& f) -> void
  * @param out the output stream to report spelling correctness
  * @param dic the dictionary to use.
  */
-auto normal_loop(istream& in, ostream& out, My_Dictionary& dic)
+auto normal_loop(istream& in, ostream& out, const My_Dictionary& dic)
 {
 	auto word = string();
 	auto suggestions = vector<string>();
@@ -393,7 +411,7 @@ auto normal_loop(istream& in, ostream& out, My_Dictionary& dic)
  * @param out the output stream with on each line only misspelled words.
  * @param dic the dictionary to use.
  */
-auto misspelled_word_loop(istream& in, ostream& out, My_Dictionary& dic)
+auto misspelled_word_loop(istream& in, ostream& out, const My_Dictionary& dic)
 {
 	auto word = string();
 	while (in >> word) {
@@ -412,7 +430,7 @@ auto misspelled_word_loop(istream& in, ostream& out, My_Dictionary& dic)
  * @param out the output stream with on each line only correct words.
  * @param dic the dictionary to use.
  */
-auto correct_word_loop(istream& in, ostream& out, My_Dictionary& dic)
+auto correct_word_loop(istream& in, ostream& out, const My_Dictionary& dic)
 {
 	auto word = string();
 	while (in >> word) {
@@ -432,7 +450,7 @@ auto correct_word_loop(istream& in, ostream& out, My_Dictionary& dic)
  * @param out the output stream to report spelling correctness
  * @param dic the dictionary to use.
  */
-auto segment_loop(istream& in, ostream& out, My_Dictionary& dic)
+auto segment_loop(istream& in, ostream& out, const My_Dictionary& dic)
 {
 	namespace b = boost::locale::boundary;
 	auto line = string();
@@ -473,7 +491,7 @@ auto segment_loop(istream& in, ostream& out, My_Dictionary& dic)
 	}
 }
 
-auto misspelled_line_loop(istream& in, ostream& out, My_Dictionary& dic)
+auto misspelled_line_loop(istream& in, ostream& out, const My_Dictionary& dic)
 {
 	auto line = string();
 	auto words = vector<string>();
@@ -493,7 +511,7 @@ auto misspelled_line_loop(istream& in, ostream& out, My_Dictionary& dic)
 	}
 }
 
-auto correct_line_loop(istream& in, ostream& out, My_Dictionary& dic)
+auto correct_line_loop(istream& in, ostream& out, const My_Dictionary& dic)
 {
 	auto line = string();
 	auto words = vector<string>();
@@ -513,6 +531,92 @@ auto correct_line_loop(istream& in, ostream& out, My_Dictionary& dic)
 	}
 }
 
+using Loop_Function = void (*)(istream&, ostream&, const My_Dictionary&);
+
+/**
+ * @brief String buffer with a chunk of a bigger stream.
+ *
+ * Reports positions as offsets in the whole stream, so the loops print the
+ * same offsets as when they read the whole stream.
+ */
+class Chunk_Buf : public stringbuf {
+	streamoff base; /**< offset of the chunk, negative if unknown */
+
+      public:
+	Chunk_Buf(const string& chunk, streamoff base)
+	    : stringbuf(chunk, ios_base::in), base(base)
+	{
+	}
+
+      protected:
+	auto seekoff(off_type off, ios_base::seekdir dir,
+	             ios_base::openmode which) -> pos_type override
+	{
+		auto pos = stringbuf::seekoff(off, dir, which);
+		if (pos == pos_type(off_type(-1)) || base < 0)
+			return pos_type(off_type(-1));
+		return pos + base;
+	}
+};
+
+/**
+ * @brief Runs a loop function on chunks of the input in multiple threads.
+ *
+ * The input is split in chunks at line boundaries and at most @p num_threads
+ * chunks are checked at the same time. The outputs of the chunks are written
+ * in input order, so the output is the same as when @p loop_function reads
+ * the whole input.
+ *
+ * @param in the input stream with plain text.
+ * @param out the output stream.
+ * @param dic the dictionary to use, shared by all threads.
+ * @param loop_function the loop to run on each chunk.
+ * @param num_threads the number of threads.
+ */
+auto parallel_loop(istream& in, ostream& out, const My_Dictionary& dic,
+                   Loop_Function loop_function, size_t num_threads)
+{
+	const size_t chunk_size = 1 << 18;
+	auto base = streamoff(in.tellg());
+	auto loc = in.getloc();
+	auto pending = deque<future<string>>();
+	auto write_first = [&]() {
+		out << pending.front().get();
+		pending.pop_front();
+	};
+	auto chunk = string();
+	auto rest = string();
+	while (in) {
+		chunk.resize(chunk_size);
+		in.read(&chunk[0], chunk_size);
+		chunk.resize(in.gcount());
+		if (getline(in, rest)) {
+			chunk += rest;
+			if (!in.eof())
+				chunk += '\n';
+		}
+		if (chunk.empty())
+			break;
+		auto chunk_base = base;
+		if (base >= 0)
+			base += chunk.size();
+		auto task = [&, loop_function, chunk_base, c = move(chunk)]() {
+			Chunk_Buf buf(c, chunk_base);
+			istream chunk_in(&buf);
+			chunk_in.imbue(loc);
+			ostringstream chunk_out;
+			chunk_out.imbue(out.getloc());
+			loop_function(chunk_in, chunk_out, dic);
+			return chunk_out.str();
+		};
+		pending.push_back(async(launch::async, move(task)));
+		if (pending.size() == num_threads)
+			write_first();
+	}
+	while (!pending.empty())
+		write_first();
+}
+
 namespace std {
 ostream& operator<<(ostream& out, const locale& loc)
 {
@@ -630,8 +734,15 @@ int main(int argc, char* argv[])
 		break;
 	}
 
+	auto run_loop = [&](istream& in) {
+		if (args.num_threads > 1)
+			parallel_loop(in, cout, dic, loop_function,
+			              args.num_threads);
+		else
+			loop_function(in, cout, dic);
+	};
 	if (args.files.empty()) {
-		loop_function(cin, cout, dic);
+		run_loop(cin);
 	}
 	else {
 		for (auto& file_name : args.files) {
@@ -641,7 +752,7 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 			in.imbue(loc);
-			loop_function(in, cout, dic);
+			run_loop(in);
 		}
 	}
 	return 0;
@@ -29,6 +29,7 @@
 #include <locale>
 #include <stack>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #ifdef __has_include
@@ -27,20 +27,79 @@
 #include "string_utils.hxx"
 
 #include <algorithm>
+#include <atomic>
+#include <climits>
 #include <cmath>
+#include <cstring>
+#include <functional>
 #include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <boost/container/small_vector.hpp>
+#include <boost/iterator/permutation_iterator.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/range/iterator_range_core.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NUSPELL_HAVE_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 namespace nuspell {
 
+/**
+ * @brief View of a contiguous array, subset of std::span from C++20.
+ *
+ * It can be made from a pointer and a size, from a built-in array or from a
+ * container with data() and size(), like std::vector or std::array.
+ */
+template <class T>
+class span {
+	T* ptr = nullptr;
+	size_t sz = 0;
+
+      public:
+	using element_type = T;
+	using value_type = std::remove_cv_t<T>;
+	using size_type = std::size_t;
+	using pointer = T*;
+	using reference = T&;
+	using iterator = T*;
+
+	span() = default;
+	span(T* data, size_t size) : ptr(data), sz(size) {}
+	template <size_t N>
+	span(T (&a)[N]) : ptr(a), sz(N)
+	{
+	}
+	template <class Container,
+	          class = std::enable_if_t<std::is_convertible<
+	              decltype(std::declval<Container&>().data()), T*>::value>>
+	span(Container& c) : ptr(c.data()), sz(c.size())
+	{
+	}
+
+	auto data() const { return ptr; }
+	auto size() const { return sz; }
+	auto empty() const { return sz == 0; }
+	auto begin() const { return ptr; }
+	auto end() const { return ptr + sz; }
+	auto& operator[](size_t i) const { return ptr[i]; }
+};
+
 /**
  * @brief A Set class backed by a string. Very useful for small sets.
  *
@@ -295,6 +354,96 @@ auto swap(String_Set<CharT>& a, String_Set<CharT>& b)
 
 using Flag_Set = String_Set<char16_t>;
 
+/**
+ * @brief Bits for the flags with special meaning, see Special_Flags.
+ */
+enum Flag_Attribute : uint16_t {
+	FORBIDDEN_WORD_ATTR = 1 << 0,
+	NO_SUGGEST_ATTR = 1 << 1,
+	NEED_AFFIX_ATTR = 1 << 2,
+	ONLY_IN_COMPOUND_ATTR = 1 << 3,
+	HIDDEN_HOMONYM_ATTR = 1 << 4,
+	KEEP_CASE_ATTR = 1 << 5,
+	WARN_ATTR = 1 << 6,
+	CIRCUMFIX_ATTR = 1 << 7,
+	COMPOUND_ATTR = 1 << 8,
+	COMPOUND_BEGIN_ATTR = 1 << 9,
+	COMPOUND_MIDDLE_ATTR = 1 << 10,
+	COMPOUND_LAST_ATTR = 1 << 11,
+	COMPOUND_PERMIT_ATTR = 1 << 12,
+	COMPOUND_FORBID_ATTR = 1 << 13
+};
+using Flag_Attributes = uint16_t;
+
+/**
+ * @brief The flags from the affix file that are tested on the hot paths.
+ */
+struct Special_Flags {
+	char16_t forbiddenword = 0;
+	char16_t nosuggest = 0;
+	char16_t need_affix = 0;
+	char16_t compound_onlyin = 0;
+	char16_t keepcase = 0;
+	char16_t warn = 0;
+	char16_t circumfix = 0;
+	char16_t compound = 0;
+	char16_t compound_begin = 0;
+	char16_t compound_middle = 0;
+	char16_t compound_last = 0;
+	char16_t compound_permit = 0;
+	char16_t compound_forbid = 0;
+};
+auto inline operator==(const Special_Flags& a, const Special_Flags& b)
+{
+	// only char16_t members, no padding
+	return std::memcmp(&a, &b, sizeof(Special_Flags)) == 0;
+}
+auto inline operator!=(const Special_Flags& a, const Special_Flags& b)
+{
+	return !(a == b);
+}
+
+/**
+ * @brief Computes the Flag_Attribute bits of a flag set.
+ */
+auto inline flag_attributes(const Flag_Set& flags, const Special_Flags& sf)
+    -> Flag_Attributes
+{
+	const char16_t HIDDEN_HOMONYM_FLAG = -1;
+	auto a = Flag_Attributes(0);
+	for (auto f : flags) {
+		if (f == sf.forbiddenword)
+			a |= FORBIDDEN_WORD_ATTR;
+		if (f == sf.nosuggest)
+			a |= NO_SUGGEST_ATTR;
+		if (f == sf.need_affix)
+			a |= NEED_AFFIX_ATTR;
+		if (f == sf.compound_onlyin)
+			a |= ONLY_IN_COMPOUND_ATTR;
+		if (f == HIDDEN_HOMONYM_FLAG)
+			a |= HIDDEN_HOMONYM_ATTR;
+		if (f == sf.keepcase)
+			a |= KEEP_CASE_ATTR;
+		if (f == sf.warn)
+			a |= WARN_ATTR;
+		if (f == sf.circumfix)
+			a |= CIRCUMFIX_ATTR;
+		if (f == sf.compound)
+			a |= COMPOUND_ATTR;
+		if (f == sf.compound_begin)
+			a |= COMPOUND_BEGIN_ATTR;
+		if (f == sf.compound_middle)
+			a |= COMPOUND_MIDDLE_ATTR;
+		if (f == sf.compound_last)
+			a |= COMPOUND_LAST_ATTR;
+		if (f == sf.compound_permit)
+			a |= COMPOUND_PERMIT_ATTR;
+		if (f == sf.compound_forbid)
+			a |= COMPOUND_FORBID_ATTR;
+	}
+	return a;
+}
+
 template <class CharT>
 class Substr_Replacer {
       public:
@@ -340,6 +489,7 @@ class Substr_Replacer {
 		replace(s);
 		return s;
 	}
+	auto& data() const { return table; }
 };
 template <class CharT>
 auto Substr_Replacer<CharT>::sort_uniq() -> void
@@ -481,6 +631,24 @@ class Break_Table {
 	{
 		return {begin(table) + end_word_breaks_last_idx, end(table)};
 	}
+
+	/**
+	 * @brief Assigns already ordered entries.
+	 *
+	 * The entries must be laid out as returned by start_word_breaks(),
+	 * end_word_breaks() and middle_word_breaks(), without the markers ^
+	 * and $. Used when restoring a table that was ordered before.
+	 */
+	auto assign_ordered(Table_Str&& v, size_t start_word_breaks_cnt,
+	                    size_t end_word_breaks_cnt) -> void
+	{
+		if (start_word_breaks_cnt + end_word_breaks_cnt > v.size())
+			throw std::out_of_range("break table counts too big");
+		table = move(v);
+		start_word_breaks_last_idx = start_word_breaks_cnt;
+		end_word_breaks_last_idx =
+		    start_word_breaks_cnt + end_word_breaks_cnt;
+	}
 };
 template <class CharT>
 auto Break_Table<CharT>::order_entries() -> void
@@ -516,19 +684,208 @@ struct identity {
 	}
 };
 
+/**
+ * @brief Bit masks of matching control bytes in a group of 16 of them.
+ *
+ * Used by Hash_Multiset. Uses SSE2 when available.
+ */
+struct Ctrl_Group {
+	static constexpr size_t width = 16;
+	enum : unsigned char { empty_ctrl = 0x80 };
+
+	/**
+	 * @brief Returns bit mask with bits set where control byte equals tag.
+	 */
+	auto static match(const unsigned char* g, unsigned char tag) noexcept
+	    -> unsigned
+	{
+#ifdef NUSPELL_HAVE_SSE2
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g));
+		auto t = _mm_set1_epi8(static_cast<char>(tag));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(v, t));
+#else
+		unsigned m = 0;
+		for (size_t i = 0; i != width; ++i)
+			m |= unsigned(g[i] == tag) << i;
+		return m;
+#endif
+	}
+
+	/**
+	 * @brief Returns bit mask with bits set where slots are empty.
+	 */
+	auto static match_empty(const unsigned char* g) noexcept -> unsigned
+	{
+#ifdef NUSPELL_HAVE_SSE2
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(g));
+		return _mm_movemask_epi8(v);
+#else
+		unsigned m = 0;
+		for (size_t i = 0; i != width; ++i)
+			m |= unsigned(g[i] >> 7) << i;
+		return m;
+#endif
+	}
+
+	auto static lowest_bit_index(unsigned m) noexcept -> size_t
+	{
+#if defined(__GNUC__)
+		return __builtin_ctz(m);
+#elif defined(_MSC_VER)
+		unsigned long i;
+		_BitScanForward(&i, m);
+		return i;
+#else
+		size_t i = 0;
+		for (; !(m & 1); m >>= 1)
+			++i;
+		return i;
+#endif
+	}
+};
+
+/**
+ * @brief Hints the CPU to load the cache line with the address p.
+ */
+inline auto prefetch_memory(const void* p) -> void
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(p);
+	// GCC sees no side effect in the builtin and deletes calls to
+	// functions that only prefetch before they are inlined, the empty
+	// volatile asm prevents that.
+	asm volatile("");
+#elif defined(NUSPELL_HAVE_SSE2)
+	_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+	(void)p;
+#endif
+}
+
+/**
+ * @brief Hash multiset with open addressing.
+ *
+ * Elements are stored in a flat array of slots, next to it is an array of
+ * control bytes, one per slot. A control byte is either empty or holds
+ * seven bits of the hash of the element in the slot, so a lookup rarely
+ * compares a key that is not equal. Control bytes are scanned in groups of
+ * 16.
+ *
+ * Collisions are resolved with linear probing without wrap-around. After the
+ * last home slot there is a tail of slots reached only by probing. When an
+ * insertion would need a slot after the end of the tail, e.g. for a long run
+ * of equal keys near the end, the tail is made longer. The number of home
+ * slots only grows with the load factor. Elements with equal keys are always
+ * kept in contiguous slots, so equal_range() returns a range of pointers.
+ * There is no erase.
+ */
 template <class Value, class Key = Value, class KeyExtract = identity,
           class Hash = std::hash<Key>, class KeyEqual = std::equal_to<>>
 class Hash_Multiset {
       private:
-	using bucket_type = boost::container::small_vector<Value, 1>;
 	static constexpr float max_load_fact = 7.0 / 8.0;
-	std::vector<bucket_type> data;
+	// initial number of slots past the last home slot
+	static constexpr size_t min_tail_slots = 32;
+	enum : unsigned char { empty_ctrl = Ctrl_Group::empty_ctrl };
+
+	// number of home slots, power of two
+	size_t capacity = 0;
+	// slots past the last home slot, reached only by probing
+	size_t tail_slots = 0;
+	// size is capacity + tail_slots + Ctrl_Group::width, the last group is
+	// always empty and stops all scans
+	std::vector<unsigned char> ctrl;
+	// size is capacity + tail_slots
+	std::vector<Value> slots;
 	size_t sz = 0;
 	size_t max_load_factor_capacity = 0;
 	KeyExtract key_extract = {};
 	Hash hash = {};
 	KeyEqual equal = {};
 
+	auto static tag_of(size_t h) -> unsigned char
+	{
+		return h >> (sizeof(size_t) * CHAR_BIT - 7);
+	}
+
+	template <class K>
+	auto find_first(const K& key, size_t h) const -> size_t
+	{
+		auto tag = tag_of(h);
+		auto i = h & (capacity - 1);
+		for (;; i += Ctrl_Group::width) {
+			auto g = &ctrl[i];
+			auto m = Ctrl_Group::match(g, tag);
+			auto e = Ctrl_Group::match_empty(g);
+			if (e)
+				m &= e ^ (e - 1); // only before first empty
+			for (; m; m &= m - 1) {
+				auto j = i + Ctrl_Group::lowest_bit_index(m);
+				if (equal(key, key_extract(slots[j])))
+					return j;
+			}
+			if (e)
+				return -1;
+		}
+	}
+
+	auto find_empty(size_t i) const -> size_t
+	{
+		for (;; i += Ctrl_Group::width) {
+			auto e = Ctrl_Group::match_empty(&ctrl[i]);
+			if (e)
+				return i + Ctrl_Group::lowest_bit_index(e);
+		}
+	}
+
+	template <class K>
+	auto end_of_equal(const K& key, size_t i, unsigned char tag) const
+	{
+		auto n = slots.size();
+		for (++i; i != n && ctrl[i] == tag; ++i)
+			if (!equal(key, key_extract(slots[i])))
+				break;
+		return i;
+	}
+
+	/**
+	 * @brief Adds at least n slots to the tail, doubles it at least.
+	 */
+	auto grow_tail(size_t n) -> void
+	{
+		n = std::max(n, tail_slots);
+		tail_slots += n;
+		slots.resize(slots.size() + n);
+		ctrl.resize(ctrl.size() + n, empty_ctrl);
+	}
+
+	template <class V>
+	auto insert_priv(V&& value) -> Value*
+	{
+		if (sz == max_load_factor_capacity)
+			reserve(sz + 1);
+		auto&& key = key_extract(value);
+		auto h = hash(key);
+		auto tag = tag_of(h);
+		auto pos = find_first(key, h);
+		if (pos != size_t(-1))
+			pos = end_of_equal(key, pos, tag);
+		else
+			pos = find_empty(h & (capacity - 1));
+		auto e = find_empty(pos);
+		if (e >= slots.size())
+			grow_tail(e + 1 - slots.size());
+		// shift right to make place, keeps all runs contiguous
+		for (; e != pos; --e) {
+			slots[e] = std::move(slots[e - 1]);
+			ctrl[e] = ctrl[e - 1];
+		}
+		slots[pos] = std::forward<V>(value);
+		ctrl[pos] = tag;
+		++sz;
+		return &slots[pos];
+	}
+
       public:
 	using key_type = Key;
 	using value_type = Value;
@@ -537,39 +894,36 @@ class Hash_Multiset {
 	using hasher = Hash;
 	using reference = value_type&;
 	using const_reference = const value_type&;
-	using pointer = typename bucket_type::pointer;
-	using const_pointer = typename bucket_type::const_pointer;
-	using local_iterator = typename bucket_type::iterator;
-	using local_const_iterator = typename bucket_type::const_iterator;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+	using local_iterator = pointer;
+	using local_const_iterator = const_pointer;
 
-	Hash_Multiset() : data(16) {}
+	Hash_Multiset() = default;
 
 	auto size() const { return sz; }
 	auto empty() const { return size() == 0; }
 
 	auto rehash(size_t count)
 	{
-		if (empty()) {
-			size_t capacity = 16;
-			while (capacity <= count)
-				capacity <<= 1;
-			data.resize(capacity);
-			max_load_factor_capacity =
-			    std::ceil(capacity * max_load_fact);
-			return;
-		}
 		if (count < size() / max_load_fact)
 			count = size() / max_load_fact;
+		size_t new_capacity = 16;
+		while (new_capacity <= count)
+			new_capacity <<= 1;
 		auto n = Hash_Multiset();
-		n.rehash(count);
-		for (auto& b : data) {
-			for (auto& x : b) {
-				n.insert(x);
-			}
+		n.capacity = new_capacity;
+		n.tail_slots = min_tail_slots;
+		n.ctrl.assign(new_capacity + n.tail_slots + Ctrl_Group::width,
+		              empty_ctrl);
+		n.slots.resize(new_capacity + n.tail_slots);
+		n.max_load_factor_capacity =
+		    std::ceil(new_capacity * max_load_fact);
+		for (size_t i = 0; i != slots.size(); ++i) {
+			if (ctrl[i] != empty_ctrl)
+				n.insert_priv(std::move(slots[i]));
 		}
-		data.swap(n.data);
-		sz = n.sz;
-		max_load_factor_capacity = n.max_load_factor_capacity;
+		*this = std::move(n);
 	}
 
 	auto reserve(size_t count) -> void
@@ -577,35 +931,10 @@ class Hash_Multiset {
 		rehash(std::ceil(count / max_load_fact));
 	}
 
-	auto insert(const_reference value)
+	auto insert(const_reference value) { return insert_priv(value); }
+	auto insert(value_type&& value)
 	{
-		using namespace std;
-		if (sz == max_load_factor_capacity) {
-			reserve(sz + 1);
-		}
-		auto&& key = key_extract(value);
-		auto h = hash(key);
-		auto h_mod = h & (data.size() - 1);
-		auto& bucket = data[h_mod];
-		if (bucket.size() == 0 || bucket.size() == 1 ||
-		    equal(key, key_extract(bucket.back()))) {
-			bucket.push_back(value);
-			++sz;
-			return end(bucket) - 1;
-		}
-		auto last =
-		    std::find_if(rbegin(bucket), rend(bucket), [&](auto& x) {
-			    return equal(key, key_extract(x));
-		    });
-		if (last != rend(bucket)) {
-			auto ret = bucket.insert(last.base(), value);
-			++sz;
-			return ret;
-		}
-
-		bucket.push_back(value);
-		++sz;
-		return end(bucket) - 1;
+		return insert_priv(std::move(value));
 	}
 	template <class... Args>
 	auto emplace(Args&&... a)
@@ -613,105 +942,250 @@ class Hash_Multiset {
 		return insert(value_type(std::forward<Args>(a)...));
 	}
 
+	template <class Func>
+	auto for_each(Func f) const -> void
+	{
+		for_each_in_slots(0, slots.size(), f);
+	}
+
+	/**
+	 * @brief Calls f for the elements in the slots [first, last).
+	 *
+	 * Splitting [0, slot_count()) in ranges allows the set to be scanned
+	 * in parallel. Elements are visited in the order of their addresses.
+	 */
+	template <class Func>
+	auto for_each_in_slots(size_t first, size_t last, Func f) const -> void
+	{
+		for (size_t i = first; i != last; ++i)
+			if (ctrl[i] != empty_ctrl)
+				f(slots[i]);
+	}
+	auto slot_count() const { return slots.size(); }
+	auto bucket_count() const { return capacity; }
+
+	/**
+	 * @brief Hints the CPU to load the memory where a key with the hash h
+	 * would be.
+	 *
+	 * Issuing this for several keys before looking any of them up lets
+	 * the cache misses overlap.
+	 */
+	auto prefetch(size_t h) const -> void
+	{
+		if (sz == 0)
+			return;
+		auto i = h & (capacity - 1);
+		prefetch_memory(&ctrl[i]);
+		prefetch_memory(&slots[i]);
+	}
+
+	/**
+	 * @brief Returns the first element in the home group of a key with
+	 * the hash h whose control byte matches, without comparing the key.
+	 *
+	 * It is likely the element that equal_range() finds, so it is what
+	 * to prefetch next after prefetch(). Reads the memory that
+	 * prefetch() loads.
+	 *
+	 * @return pointer to the element or nullptr if there is none.
+	 */
+	auto candidate(size_t h) const -> const_pointer
+	{
+		if (sz == 0)
+			return nullptr;
+		auto i = h & (capacity - 1);
+		auto m = Ctrl_Group::match(&ctrl[i], tag_of(h));
+		if (!m)
+			return nullptr;
+		return &slots[i + Ctrl_Group::lowest_bit_index(m)];
+	}
+
 	// Note, leaks non-const iterator. do not modify
 	// the key part of the returned value(s).
-	auto equal_range_nonconst_unsafe(const key_type& key)
+	//
+	// The key can be of any type accepted by the Hash and KeyEqual
+	// objects, e.g. for heterogeneous lookup without conversion. Both must
+	// give results equivalent to those for key_type.
+	template <class K>
+	auto equal_range_nonconst_unsafe(const K& key)
 	    -> std::pair<local_iterator, local_iterator>
 	{
-		using namespace std;
-		if (data.empty())
-			return {};
-		auto h = hash(key);
-		auto h_mod = h & (data.size() - 1);
-		auto& bucket = data[h_mod];
-		if (bucket.empty())
-			return {};
-		if (bucket.size() == 1) {
-			if (equal(key, key_extract(bucket.front())))
-				return {begin(bucket), end(bucket)};
-			return {};
-		}
-		auto first =
-		    std::find_if(begin(bucket), end(bucket), [&](auto& x) {
-			    return equal(key, key_extract(x));
-		    });
-		if (first == end(bucket))
-			return {};
-		auto next = first + 1;
-		if (next == end(bucket) || !equal(key, key_extract(*next)))
-			return {first, next};
-		auto last =
-		    std::find_if(rbegin(bucket), rend(bucket), [&](auto& x) {
-			    return equal(key, key_extract(x));
-		    });
-		return {first, last.base()};
+		auto r = equal_range(key);
+		return {const_cast<pointer>(r.first),
+		        const_cast<pointer>(r.second)};
 	}
 
-	auto equal_range(const key_type& key) const
+	template <class K>
+	auto equal_range(const K& key) const
 	    -> std::pair<local_const_iterator, local_const_iterator>
 	{
-		using namespace std;
-		if (data.empty())
+		if (sz == 0)
 			return {};
 		auto h = hash(key);
-		auto h_mod = h & (data.size() - 1);
-		auto& bucket = data[h_mod];
-		if (bucket.empty())
-			return {};
-		if (bucket.size() == 1) {
-			if (equal(key, key_extract(bucket.front())))
-				return {begin(bucket), end(bucket)};
-			return {};
-		}
-		auto first =
-		    std::find_if(begin(bucket), end(bucket), [&](auto& x) {
-			    return equal(key, key_extract(x));
-		    });
-		if (first == end(bucket))
+		auto first = find_first(key, h);
+		if (first == size_t(-1))
 			return {};
-		auto next = first + 1;
-		if (next == end(bucket) || !equal(key, key_extract(*next)))
-			return {first, next};
-		auto last =
-		    std::find_if(rbegin(bucket), rend(bucket), [&](auto& x) {
-			    return equal(key, key_extract(x));
-		    });
-		return {first, last.base()};
+		auto last = end_of_equal(key, first, tag_of(h));
+		return {&slots[first], &slots[last]};
 	}
 };
 
+/**
+ * @brief Stack of reusable objects that keep their capacity, e.g. strings.
+ *
+ * A Ref takes the next free object, cleared, and gives it back when it goes
+ * out of scope, so Refs must be destroyed in reverse order of creation,
+ * which local variables are. Objects are allocated only when more of them
+ * are in use at once than ever before, and they grow only when they need
+ * more capacity than ever before. Thus code that takes its temporaries from
+ * a pool does not allocate once warmed up. The objects never move.
+ *
+ * A pool is not thread-safe, use one per thread.
+ */
+template <class T>
+class Scratch_Pool {
+	std::vector<std::unique_ptr<T>> objects;
+	size_t used = 0;
+
+      public:
+	class Ref {
+		Scratch_Pool& pool;
+		T& obj;
+
+	      public:
+		explicit Ref(Scratch_Pool& p) : pool(p), obj(p.acquire()) {}
+		Ref(const Ref&) = delete;
+		auto operator=(const Ref&) -> Ref& = delete;
+		~Ref() { pool.release(); }
+		auto& operator*() const { return obj; }
+		auto operator-> () const { return &obj; }
+	};
+
+	auto acquire() -> T&
+	{
+		if (used == objects.size())
+			objects.push_back(std::make_unique<T>());
+		auto& x = *objects[used++];
+		x.clear();
+		return x;
+	}
+	auto release() -> void { --used; }
+};
+
 /**
  * @brief Limited regular expression matching used in affix entries.
  *
  * This implementation increases performance over the regex implementation in
- * the standard library.
+ * the standard library. The condition is compiled at construction into one
+ * character class per position. Short conditions of plain characters and
+ * dots are matched with a single masked comparison. Copies share the
+ * compiled data.
  */
 template <class CharT>
 class Condition {
       public:
-	enum Span_Type {
-		NORMAL /**< normal character */,
-		DOT /**< wildcard character */,
-		ANY_OF /**< set of possible characters */,
-		NONE_OF /**< set of excluding characters */
-	};
 	using StrT = std::basic_string<CharT>;
 
       private:
-	StrT cond;
-	std::vector<std::tuple<size_t, size_t, Span_Type>>
-	    spans; // pos, len, type
+	using UCharT = std::make_unsigned_t<CharT>;
+
+	/**
+	 * @brief The characters accepted at one position.
+	 *
+	 * Code units below 256 are looked up in a bitmap, the others are
+	 * searched in a sorted list, which lists the rejected ones when the
+	 * class is negated.
+	 */
+	struct Char_Class {
+		uint64_t bits[4] = {};
+		uint32_t others_begin = 0;
+		uint32_t others_end = 0;
+		bool negated = false;
+	};
+	enum Kind : unsigned char {
+		ANY /**< only dots, matches any string of the length */,
+		MASKED /**< dots and plain characters, one masked comparison */,
+		CLASSES /**< has bracket expressions or is longer */
+	};
+	struct Compiled {
+		StrT cond;
+		// aligned to the start and to the end of 16 bytes
+		unsigned char pattern[2][16] = {};
+		unsigned char mask[2][16] = {};
+		std::vector<Char_Class> classes;
+		StrT others;
+	};
+	std::shared_ptr<const Compiled> data;
 	size_t length = 0;
+	Kind kind = ANY;
 
-	auto construct() -> void; // implemented in cxx
+	auto static constexpr max_masked = 16 / sizeof(CharT);
+
+	auto construct(StrT&& condition) -> void; // implemented below
+	auto match_classes(const CharT* s) const -> bool
+	{
+		auto& d = *data;
+		for (size_t i = 0; i != length; ++i) {
+			auto& cl = d.classes[i];
+			auto u = static_cast<UCharT>(s[i]);
+			if (u < 256) {
+				if (!(cl.bits[u >> 6] >> (u & 63) & 1))
+					return false;
+				continue;
+			}
+			auto first = d.others.data() + cl.others_begin;
+			auto last = d.others.data() + cl.others_end;
+			auto found = std::binary_search(first, last, s[i]);
+			if (found == cl.negated)
+				return false;
+		}
+		return true;
+	}
+	auto masked_equal(const CharT* s, int align) const -> bool
+	{
+		auto& d = *data;
+#ifdef NUSPELL_HAVE_SSE2
+		auto load = [](const void* p) {
+			return _mm_loadu_si128(
+			    reinterpret_cast<const __m128i*>(p));
+		};
+		auto x = _mm_xor_si128(load(s), load(d.pattern[align]));
+		x = _mm_and_si128(x, load(d.mask[align]));
+		x = _mm_cmpeq_epi8(x, _mm_setzero_si128());
+		return _mm_movemask_epi8(x) == 0xFFFF;
+#else
+		uint64_t x[2], p[2], m[2];
+		std::memcpy(x, s, 16);
+		std::memcpy(p, d.pattern[align], 16);
+		std::memcpy(m, d.mask[align], 16);
+		return (((x[0] ^ p[0]) & m[0]) | ((x[1] ^ p[1]) & m[1])) == 0;
+#endif
+	}
+	auto match_masked(const StrT& s, size_t pos) const -> bool
+	{
+		// Loads the 16 bytes from the matched part onwards, or the 16
+		// bytes that end with it, whichever stays within the string.
+		if (s.size() - pos >= max_masked)
+			return masked_equal(&s[pos], 0);
+		if (pos + length >= max_masked)
+			return masked_equal(&s[pos + length - max_masked], 1);
+		CharT b[max_masked] = {};
+		std::copy_n(&s[pos], length, b);
+		return masked_equal(b, 0);
+	}
 
       public:
-	Condition() = default;
-	Condition(const StrT& condition) : cond(condition) { construct(); }
-	Condition(StrT&& condition) : cond(move(condition)) { construct(); }
+	Condition() : Condition(StrT()) {}
+	Condition(const StrT& condition) { construct(StrT(condition)); }
+	Condition(StrT&& condition) { construct(move(condition)); }
 	auto match(const StrT& s, size_t pos = 0, size_t len = StrT::npos) const
-	    -> bool; // implemented in cxx
-	auto match_prefix(const StrT& s) const { return match(s, 0, length); }
+	    -> bool; // implemented below
+	auto match_prefix(const StrT& s) const
+	{
+		return match(s, 0, length);
+	}
+	auto& str() const { return data->cond; }
 	auto match_suffix(const StrT& s) const
 	{
 		if (length > s.size())
@@ -720,24 +1194,52 @@ class Condition {
 	}
 };
 template <class CharT>
-auto Condition<CharT>::construct() -> void
+auto Condition<CharT>::construct(StrT&& condition) -> void
 {
+	auto d = std::make_shared<Compiled>();
+	d->cond = move(condition);
+	auto& cond = d->cond;
+	auto& classes = d->classes;
+	auto plain = true;
+	auto all_dots = true;
+	auto set_bit = [](Char_Class& cl, UCharT u) {
+		cl.bits[u >> 6] |= uint64_t(1) << (u & 63);
+	};
+	auto add_class = [&](my_string_view<CharT> chars, bool negated) {
+		classes.emplace_back();
+		auto& cl = classes.back();
+		auto others = StrT();
+		for (auto c : chars) {
+			auto u = static_cast<UCharT>(c);
+			if (u < 256)
+				set_bit(cl, u);
+			else
+				others += c;
+		}
+		if (negated)
+			for (auto& b : cl.bits)
+				b = ~b;
+		std::sort(begin(others), end(others));
+		others.erase(std::unique(begin(others), end(others)),
+		             end(others));
+		cl.others_begin = d->others.size();
+		d->others += others;
+		cl.others_end = d->others.size();
+		cl.negated = negated;
+	};
 	size_t i = 0;
 	for (; i != cond.size();) {
 		size_t j = cond.find_first_of(NUSPELL_LITERAL(CharT, "[]."), i);
-		if (i != j) {
-			if (j == cond.npos) {
-				spans.emplace_back(i, cond.size() - i, NORMAL);
-				length += cond.size() - i;
-				break;
-			}
-			spans.emplace_back(i, j - i, NORMAL);
-			length += j - i;
-			i = j;
+		if (j == cond.npos)
+			j = cond.size();
+		for (; i != j; ++i) {
+			add_class(my_string_view<CharT>(&cond[i], 1), false);
+			all_dots = false;
 		}
+		if (i == cond.size())
+			break;
 		if (cond[i] == '.') {
-			spans.emplace_back(i, 1, DOT);
-			++length;
+			add_class({}, true);
 			++i;
 			continue;
 		}
@@ -753,14 +1255,9 @@ auto Condition<CharT>::construct() -> void
 				            "closing bracket";
 				throw std::invalid_argument(what);
 			}
-			Span_Type type;
-			if (cond[i] == '^') {
-				type = NONE_OF;
+			auto negated = cond[i] == '^';
+			if (negated)
 				++i;
-			}
-			else {
-				type = ANY_OF;
-			}
 			j = cond.find(']', i);
 			if (j == i) {
 				auto what = "empty bracket expression";
@@ -771,11 +1268,39 @@ auto Condition<CharT>::construct() -> void
 				            "closing bracket";
 				throw std::invalid_argument(what);
 			}
-			spans.emplace_back(i, j - i, type);
-			++length;
+			add_class(my_string_view<CharT>(&cond[i], j - i),
+			          negated);
+			plain = false;
+			all_dots = false;
 			i = j + 1;
 		}
 	}
+	length = classes.size();
+	kind = CLASSES;
+	if (all_dots) {
+		kind = ANY;
+		d->classes.clear();
+		d->classes.shrink_to_fit();
+	}
+	else if (plain && length <= max_masked) {
+		// Dots have an all zero mask, any pattern matches them.
+		for (size_t k = 0; k != length; ++k) {
+			if (cond[k] == '.')
+				continue;
+			for (auto align : {0, 1}) {
+				auto a = align ? max_masked - length + k : k;
+				auto i = a * sizeof(CharT);
+				std::memcpy(&d->pattern[align][i], &cond[k],
+				            sizeof(CharT));
+				std::fill_n(&d->mask[align][i], sizeof(CharT),
+				            0xFF);
+			}
+		}
+		kind = MASKED;
+		d->classes.clear();
+		d->classes.shrink_to_fit();
+	}
+	data = move(d);
 }
 
 /**
@@ -798,39 +1323,15 @@ auto Condition<CharT>::match(const StrT& s, size_t pos, size_t len) const
 		len = s.size() - pos;
 	if (len != length)
 		return false;
-
-	size_t i = pos;
-	for (auto& x : spans) {
-		auto x_pos = std::get<0>(x);
-		auto x_len = std::get<1>(x);
-		auto x_type = std::get<2>(x);
-
-		using tr = typename StrT::traits_type;
-		switch (x_type) {
-		case NORMAL:
-			if (tr::compare(&s[i], &cond[x_pos], x_len) == 0)
-				i += x_len;
-			else
-				return false;
-			break;
-		case DOT:
-			++i;
-			break;
-		case ANY_OF:
-			if (tr::find(&cond[x_pos], x_len, s[i]))
-				++i;
-			else
-				return false;
-			break;
-		case NONE_OF:
-			if (tr::find(&cond[x_pos], x_len, s[i]))
-				return false;
-			else
-				++i;
-			break;
-		}
-	}
-	return true;
+	switch (kind) {
+	case ANY:
+		return true;
+	case MASKED:
+		return match_masked(s, pos);
+	case CLASSES:
+		break;
+	}
+	return match_classes(&s[pos]);
 }
 
 template <class CharT>
@@ -846,6 +1347,7 @@ class Prefix {
 	StrT appending;
 	Flag_Set cont_flags;
 	CondT condition;
+	mutable Flag_Attributes cont_attrs = 0; // set by Affix_Table
 
 	Prefix() = default;
 	Prefix(char16_t flag, bool cross_product, const StrT& strip,
@@ -895,6 +1397,7 @@ class Suffix {
 	StrT appending;
 	Flag_Set cont_flags;
 	CondT condition;
+	mutable Flag_Attributes cont_attrs = 0; // set by Affix_Table
 
 	Suffix() = default;
 	Suffix(char16_t flag, bool cross_product, const StrT& strip,
@@ -935,29 +1438,133 @@ class Suffix {
 
 using boost::multi_index::member;
 
+/**
+ * @brief Table of affix entries, prefixes or suffixes.
+ *
+ * Entries are kept in insertion order. Next to them is a trie of the
+ * appending strings, built from the start for prefixes and from the end for
+ * suffixes. Each node of the trie lists the entries whose appending ends in
+ * it. All entries matching a word are found with one walk over the trie,
+ * see trie_child() and trie_entries().
+ */
 template <class CharT, class AffixT>
-using Affix_Table_Base =
-    Hash_Multiset<AffixT, my_string_view<CharT>,
-                  member<AffixT, std::basic_string<CharT>, &AffixT::appending>>;
-
-template <class CharT, class AffixT>
-class Affix_Table : private Affix_Table_Base<CharT, AffixT> {
+class Affix_Table {
       private:
+	struct Trie_Node {
+		// sorted by the character
+		std::vector<std::pair<CharT, uint32_t>> children;
+		// indexes in table, in insertion order
+		std::vector<uint32_t> entries;
+	};
+	std::vector<AffixT> table;
+	std::vector<Trie_Node> trie = std::vector<Trie_Node>(1);
 	Flag_Set all_cont_flags;
+	// first entry with the given condition, entries share it
+	std::unordered_map<std::basic_string<CharT>, uint32_t> conditions;
+	mutable Special_Flags special_flags;
+
+	auto static constexpr is_suffix()
+	{
+		return std::is_same<AffixT, Suffix<CharT>>::value;
+	}
+	auto find_child(size_t node, CharT c) const
+	{
+		auto& ch = trie[node].children;
+		return std::lower_bound(
+		    begin(ch), end(ch), c,
+		    [](auto& x, CharT c) { return x.first < c; });
+	}
+	template <class It>
+	auto insert_in_trie(It first, It last, uint32_t idx)
+	{
+		size_t node = 0;
+		for (; first != last; ++first) {
+			auto c = *first;
+			auto it = find_child(node, c);
+			if (it != end(trie[node].children) && it->first == c) {
+				node = it->second;
+				continue;
+			}
+			auto child = uint32_t(trie.size());
+			trie[node].children.emplace(it, c, child);
+			trie.emplace_back();
+			node = child;
+		}
+		trie[node].entries.push_back(idx);
+	}
 
       public:
-	using base = Affix_Table_Base<CharT, AffixT>;
-	using iterator = typename base::local_const_iterator;
+	using const_iterator = typename std::vector<AffixT>::const_iterator;
+	using iterator =
+	    boost::permutation_iterator<const_iterator,
+	                                std::vector<uint32_t>::const_iterator>;
+
 	template <class... Args>
 	auto emplace(Args&&... a)
 	{
-		auto it = base::emplace(std::forward<Args>(a)...);
-		all_cont_flags += it->cont_flags;
-		return it;
+		table.emplace_back(std::forward<Args>(a)...);
+		auto& e = table.back();
+		auto idx = uint32_t(table.size() - 1);
+		if (is_suffix())
+			insert_in_trie(rbegin(e.appending), rend(e.appending),
+			               idx);
+		else
+			insert_in_trie(begin(e.appending), end(e.appending),
+			               idx);
+		for (auto f : e.cont_flags)
+			all_cont_flags.insert(f);
+		e.cont_attrs = flag_attributes(e.cont_flags, special_flags);
+		auto c = conditions.emplace(e.condition.str(), idx);
+		if (!c.second)
+			e.condition = table[c.first->second].condition;
+		return end(table) - 1;
 	}
-	auto equal_range(my_string_view<CharT> appending) const
+	auto size() const { return table.size(); }
+	template <class Func>
+	auto for_each(Func f) const -> void
 	{
-		return base::equal_range(appending);
+		std::for_each(begin(table), end(table), f);
+	}
+
+	/**
+	 * @brief Returns the root node of the trie, it holds the entries with
+	 * empty appending.
+	 */
+	auto trie_root() const -> size_t { return 0; }
+
+	/**
+	 * @brief Returns the child node for the next character.
+	 *
+	 * For prefixes the characters are given from the start of the word,
+	 * for suffixes from the end.
+	 *
+	 * @return the child node or the root node (0) if there is none.
+	 */
+	auto trie_child(size_t node, CharT c) const -> size_t
+	{
+		auto it = find_child(node, c);
+		if (it != end(trie[node].children) && it->first == c)
+			return it->second;
+		return 0;
+	}
+	auto trie_entries(size_t node) const -> std::pair<iterator, iterator>
+	{
+		auto& e = trie[node].entries;
+		return {iterator(begin(table), begin(e)),
+		        iterator(begin(table), end(e))};
+	}
+	auto equal_range(my_string_view<CharT> appending) const
+	    -> std::pair<iterator, iterator>
+	{
+		auto node = trie_root();
+		for (size_t i = 0; i != appending.size(); ++i) {
+			auto c = is_suffix() ? appending.end()[-1 - i]
+			                     : appending[i];
+			node = trie_child(node, c);
+			if (node == 0)
+				return {};
+		}
+		return trie_entries(node);
 	}
 	auto has_continuation_flags() const
 	{
@@ -967,6 +1574,21 @@ class Affix_Table : private Affix_Table_Base<CharT, AffixT> {
 	{
 		return all_cont_flags.contains(flag);
 	}
+
+	/**
+	 * @brief Computes the attributes of the continuation flags of every
+	 * entry, see Flag_Attribute.
+	 *
+	 * Entries added later get their attributes from the same flags. The
+	 * attributes are kept in the entries next to the flags they are
+	 * derived from, so this is const.
+	 */
+	auto set_attribute_flags(const Special_Flags& sf) const -> void
+	{
+		special_flags = sf;
+		for (auto& e : table)
+			e.cont_attrs = flag_attributes(e.cont_flags, sf);
+	}
 };
 
 template <class CharT>
@@ -1039,42 +1661,71 @@ struct Compound_Pattern {
 	bool match_first_only_unaffixed_or_zero_affixed = false;
 };
 
+/**
+ * @brief Table of compound rules, COMPOUNDRULE.
+ *
+ * Each rule is a simple regular expression over flags, a flag optionally
+ * followed by ? or *. All rules are compiled into one position automaton
+ * (Glushkov) which is simulated with bitsets. A state is a set of positions
+ * in the rules, and bit 0 is the start position. Advancing a state with the
+ * flags of one word advances all rules at once, and an empty state means no
+ * rule can match anymore.
+ */
 class Compound_Rule_Table {
+      public:
+	using State = boost::container::small_vector<unsigned, 8>;
+
+      private:
 	std::vector<std::u16string> rules;
 	Flag_Set all_flags;
+	size_t state_size = 0; // number of blocks of 32 bits in State
+	std::vector<unsigned> follow;     // set of next positions, per position
+	std::vector<unsigned> flag_masks; // positions of flag, per all_flags
+	std::vector<unsigned> accepting;
 
 	auto fill_all_flags() -> void;
+	auto compile() -> void;
 
       public:
 	Compound_Rule_Table() = default;
 	Compound_Rule_Table(const std::vector<std::u16string>& tbl) : rules(tbl)
 	{
 		fill_all_flags();
+		compile();
 	}
 	Compound_Rule_Table(std::vector<std::u16string>&& tbl)
 	    : rules(move(tbl))
 	{
 		fill_all_flags();
+		compile();
 	}
 	auto operator=(const std::vector<std::u16string>& tbl)
 	{
 		rules = tbl;
 		fill_all_flags();
+		compile();
 		return *this;
 	}
 	auto operator=(std::vector<std::u16string>&& tbl)
 	{
 		rules = move(tbl);
 		fill_all_flags();
+		compile();
 		return *this;
 	}
 	auto empty() const { return rules.empty(); }
+	auto& data() const { return rules; }
 	auto has_any_of_flags(const Flag_Set& f) const -> bool;
+	auto start_state() const -> State;
+	auto advance(const State& in, const Flag_Set& f, State& out) const
+	    -> bool;
+	auto is_accepting(const State& s) const -> bool;
 	auto match_any_rule(const std::vector<const Flag_Set*> data) const
 	    -> bool;
 };
 auto inline Compound_Rule_Table::fill_all_flags() -> void
 {
+	all_flags.clear();
 	for (auto& f : rules) {
 		all_flags += f;
 	}
@@ -1082,6 +1733,63 @@ auto inline Compound_Rule_Table::fill_all_flags() -> void
 	all_flags.erase(u'*');
 }
 
+auto inline Compound_Rule_Table::compile() -> void
+{
+	using std::begin;
+	auto is_quantifier = [](char16_t c) { return c == '?' || c == '*'; };
+	auto num_pos = size_t(1);
+	for (auto& r : rules)
+		for (auto c : r)
+			num_pos += !is_quantifier(c);
+	state_size = (num_pos + 31) / 32;
+	follow.assign(num_pos * state_size, 0);
+	flag_masks.assign(all_flags.size() * state_size, 0);
+	accepting.assign(state_size, 0);
+
+	auto set_bit = [&](unsigned* set, size_t p) {
+		set[p / 32] |= 1u << (p % 32);
+	};
+	auto pos = size_t(1);
+	for (auto& r : rules) {
+		// atoms of this rule: position, flag, quantifier
+		auto first_pos = pos;
+		auto atoms = std::vector<std::pair<char16_t, char16_t>>();
+		for (size_t i = 0; i != r.size(); ++i) {
+			if (is_quantifier(r[i]))
+				continue;
+			auto q = char16_t();
+			if (i + 1 != r.size() && is_quantifier(r[i + 1]))
+				q = r[i + 1];
+			atoms.emplace_back(r[i], q);
+		}
+		pos += atoms.size();
+
+		// from position p (or the start for p = -1) we can go to the
+		// next atoms until and including the first non-optional one
+		auto link_next = [&](unsigned* set, size_t i) {
+			for (; i != atoms.size(); ++i) {
+				set_bit(set, first_pos + i);
+				if (atoms[i].second == 0)
+					return false;
+			}
+			return true; // reached the end of the rule
+		};
+		if (link_next(&follow[0], 0))
+			set_bit(&accepting[0], 0);
+		for (size_t i = 0; i != atoms.size(); ++i) {
+			auto p = first_pos + i;
+			auto set = &follow[p * state_size];
+			if (atoms[i].second == '*')
+				set_bit(set, p);
+			if (link_next(set, i + 1))
+				set_bit(&accepting[0], p);
+			auto f = all_flags.lower_bound(atoms[i].first);
+			auto f_idx = size_t(f - begin(all_flags));
+			set_bit(&flag_masks[f_idx * state_size], p);
+		}
+	}
+}
+
 auto inline Compound_Rule_Table::has_any_of_flags(const Flag_Set& f) const
     -> bool
 {
@@ -1105,20 +1813,88 @@ auto inline Compound_Rule_Table::has_any_of_flags(const Flag_Set& f) const
 	return has_intersection;
 }
 
-auto inline match_compund_rule(const std::vector<const Flag_Set*>& words_data,
-                               const std::u16string& pattern)
+auto inline Compound_Rule_Table::start_state() const -> State
 {
-	return match_simple_regex(
-	    words_data, pattern,
-	    [](const Flag_Set* d, char16_t p) { return d->contains(p); });
+	auto s = State(std::max(state_size, size_t(1)));
+	s[0] = 1;
+	return s;
+}
+
+/**
+ * @brief Advances all rules with one word of the compound.
+ * @param in current state.
+ * @param f flags of the word.
+ * @param out the new state.
+ * @return false if no rule can match anymore.
+ */
+auto inline Compound_Rule_Table::advance(const State& in, const Flag_Set& f,
+                                         State& out) const -> bool
+{
+	using std::begin;
+	using std::end;
+	out.assign(state_size, 0);
+	auto reachable = false;
+	for (size_t i = 0; i != state_size; ++i) {
+		for (auto m = in[i]; m; m &= m - 1) {
+			auto p = i * 32 + Ctrl_Group::lowest_bit_index(m);
+			auto next = &follow[p * state_size];
+			for (size_t j = 0; j != state_size; ++j)
+				out[j] |= next[j];
+			reachable = true;
+		}
+	}
+	if (!reachable)
+		return false;
+
+	// keep only the positions whose flag the word has
+	auto allowed = State(state_size);
+	auto a = begin(all_flags);
+	auto b = begin(f);
+	while (a != end(all_flags) && b != end(f)) {
+		if (*a < *b) {
+			++a;
+		}
+		else if (*b < *a) {
+			++b;
+		}
+		else {
+			auto mask = &flag_masks[(a - begin(all_flags)) *
+			                        state_size];
+			for (size_t j = 0; j != state_size; ++j)
+				allowed[j] |= mask[j];
+			++a;
+			++b;
+		}
+	}
+	auto any = 0u;
+	for (size_t j = 0; j != state_size; ++j) {
+		out[j] &= allowed[j];
+		any |= out[j];
+	}
+	return any != 0;
+}
+
+auto inline Compound_Rule_Table::is_accepting(const State& s) const -> bool
+{
+	for (size_t j = 0; j != state_size; ++j)
+		if (s[j] & accepting[j])
+			return true;
+	return false;
 }
 
 auto inline Compound_Rule_Table::match_any_rule(
     const std::vector<const Flag_Set*> data) const -> bool
 {
-	return any_of(begin(rules), end(rules), [&](const std::u16string& p) {
-		return match_compund_rule(data, p);
-	});
+	if (rules.empty())
+		return false;
+	auto s = start_state();
+	auto next = State();
+	for (auto f : data) {
+		if (!advance(s, *f, next))
+			return false;
+		s.swap(next);
+	}
+	return is_accepting(s);
 }
 
 /**
@@ -1557,6 +2333,28 @@ class Replacement_Table {
 	{
 		return {begin(table) + end_word_reps_last_idx, end(table)};
 	}
+
+	/**
+	 * @brief Assigns already ordered entries.
+	 *
+	 * The entries must be laid out in the order of the four groups
+	 * returned by the accessors above, without the markers ^ and $.
+	 */
+	auto assign_ordered(Table_Str&& v, size_t whole_word_reps_cnt,
+	                    size_t start_word_reps_cnt,
+	                    size_t end_word_reps_cnt) -> void
+	{
+		if (whole_word_reps_cnt + start_word_reps_cnt +
+		        end_word_reps_cnt >
+		    v.size())
+			throw std::out_of_range("replacement counts too big");
+		table = move(v);
+		whole_word_reps_last_idx = whole_word_reps_cnt;
+		start_word_reps_last_idx =
+		    whole_word_reps_last_idx + start_word_reps_cnt;
+		end_word_reps_last_idx =
+		    start_word_reps_last_idx + end_word_reps_cnt;
+	}
 };
 template <class CharT>
 auto Replacement_Table<CharT>::order_entries() -> void
@@ -1650,6 +2448,7 @@ class Phonetic_Table {
 	Phonetic_Table() = default;
 	Phonetic_Table(const std::vector<Pair_StrT>& v) : table(v) { order(); }
 	Phonetic_Table(std::vector<Pair_StrT>&& v) : table(move(v)) { order(); }
+	auto empty() const { return table.empty(); }
 	auto& operator=(const std::vector<Pair_StrT>& v)
 	{
 		table = v;
@@ -1670,6 +2469,7 @@ class Phonetic_Table {
 		return *this;
 	}
 	auto replace(StrT& word) const -> bool;
+	auto& data() const { return table; }
 };
 
 template <class CharT>
@@ -1824,5 +2624,114 @@ auto Phonetic_Table<CharT>::replace(StrT& word) const -> bool
 	}
 	return ret;
 }
+
+/**
+ * @brief Bounded map with LRU eviction, safe for concurrent use.
+ *
+ * The entries are split in shards by the hash of the key. Each shard has its
+ * own mutex and LRU list, so threads that look up different keys rarely wait
+ * for each other. Lookups count hits and misses.
+ */
+template <class Key, class Value, class Hash = std::hash<Key>>
+class Sharded_Lru_Cache {
+	using List = std::list<std::pair<Key, Value>>;
+	struct Shard {
+		std::mutex mtx;
+		List entries; // most recently used first
+		std::unordered_map<Key, typename List::iterator, Hash> index;
+	};
+	std::unique_ptr<Shard[]> shards;
+	size_t num_shards;
+	size_t shard_capacity;
+	Hash hash;
+	std::atomic<size_t> hit_cnt{0};
+	std::atomic<size_t> miss_cnt{0};
+
+	auto& shard_for(const Key& key) const
+	{
+		return shards[hash(key) % num_shards];
+	}
+
+      public:
+	/**
+	 * @param capacity maximal number of entries in all shards
+	 * @param num_shards number of shards
+	 */
+	Sharded_Lru_Cache(size_t capacity, size_t num_shards = 16)
+	    : shards(new Shard[std::max(num_shards, size_t(1))]),
+	      num_shards(std::max(num_shards, size_t(1))),
+	      shard_capacity(std::max(capacity / this->num_shards, size_t(1)))
+	{
+	}
+
+	/**
+	 * @brief Looks up a key and marks it as most recently used.
+	 * @param key
+	 * @param[out] out gets the value if the key is found
+	 * @return true if found
+	 */
+	auto find(const Key& key, Value& out) -> bool
+	{
+		auto& s = shard_for(key);
+		std::lock_guard<std::mutex> lock(s.mtx);
+		auto it = s.index.find(key);
+		if (it == end(s.index)) {
+			miss_cnt.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		s.entries.splice(begin(s.entries), s.entries, it->second);
+		out = it->second->second;
+		hit_cnt.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/**
+	 * @brief Inserts or updates a value. When the shard is full its least
+	 * recently used entry is evicted.
+	 */
+	auto insert(const Key& key, const Value& value) -> void
+	{
+		auto& s = shard_for(key);
+		std::lock_guard<std::mutex> lock(s.mtx);
+		auto it = s.index.find(key);
+		if (it != end(s.index)) {
+			it->second->second = value;
+			s.entries.splice(begin(s.entries), s.entries,
+			                 it->second);
+			return;
+		}
+		s.entries.emplace_front(key, value);
+		s.index.emplace(key, begin(s.entries));
+		if (s.index.size() > shard_capacity) {
+			s.index.erase(s.entries.back().first);
+			s.entries.pop_back();
+		}
+	}
+
+	auto clear() -> void
+	{
+		for (size_t i = 0; i != num_shards; ++i) {
+			auto& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mtx);
+			s.index.clear();
+			s.entries.clear();
+		}
+	}
+	auto size() const -> size_t
+	{
+		auto ret = size_t(0);
+		for (size_t i = 0; i != num_shards; ++i) {
+			auto& s = shards[i];
+			std::lock_guard<std::mutex> lock(s.mtx);
+			ret += s.index.size();
+		}
+		return ret;
+	}
+	auto hits() const { return hit_cnt.load(std::memory_order_relaxed); }
+	auto misses() const
+	{
+		return miss_cnt.load(std::memory_order_relaxed);
+	}
+};
 } // namespace nuspell
 #endif // NUSPELL_STRUCTURES_HXX
@@ -0,0 +1,71 @@
+/* Copyright 2019 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file
+ * @brief Replaces the global allocation functions to count allocations.
+ *
+ * All forms of the replaceable allocation and deallocation functions are
+ * replaced, so every allocation is counted and each pair stays matched. They
+ * are kept in their own file, away from the tests that use them.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace {
+atomic<size_t> counter(0);
+
+auto counted_malloc(size_t n) noexcept -> void*
+{
+	++counter;
+	return malloc(n ? n : 1);
+}
+auto checked_malloc(size_t n) -> void*
+{
+	auto p = counted_malloc(n);
+	if (!p)
+		throw bad_alloc();
+	return p;
+}
+} // namespace
+
+/**
+ * @brief Gets the number of heap allocations done by the test program.
+ */
+auto allocation_count() -> size_t { return counter.load(); }
+
+void* operator new(size_t n) { return checked_malloc(n); }
+void* operator new[](size_t n) { return checked_malloc(n); }
+void* operator new(size_t n, const nothrow_t&) noexcept
+{
+	return counted_malloc(n);
+}
+void* operator new[](size_t n, const nothrow_t&) noexcept
+{
+	return counted_malloc(n);
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { free(p); }
@@ -252,3 +252,52 @@ TEST_CASE("Condition<wchar_t> real-life examples", "[condition]")
 
 	CHECK(false == c7.match(L"жерти"));
 }
+
+TEST_CASE("Condition<wchar_t> long and mixed", "[condition]")
+{
+	// longer than one masked comparison
+	auto c1 = Condition<wchar_t>(L"abcd.fgh");
+	CHECK(true == c1.match(L"abcdefgh"));
+	CHECK(true == c1.match(L"abcdxfgh"));
+	CHECK(false == c1.match(L"abcdefgi"));
+	CHECK(true == c1.match_suffix(L"zabcd\u0416fgh"));
+
+	auto c2 = Condition<wchar_t>(L"ж.ä");
+	CHECK(true == c2.match(L"жaä"));
+	CHECK(true == c2.match(L"жжä"));
+	CHECK(false == c2.match(L"зaä"));
+	CHECK(false == c2.match(L"жaa"));
+	CHECK(false == c2.match(L"жä"));
+
+	auto c3 = Condition<wchar_t>(L"[^a\u0436\u00E4\U0001F600]");
+	CHECK(true == c3.match(L"б"));
+	CHECK(true == c3.match(L"b"));
+	CHECK(true == c3.match(L"\U0001F601"));
+	CHECK(false == c3.match(L"a"));
+	CHECK(false == c3.match(L"ж"));
+	CHECK(false == c3.match(L"ä"));
+	CHECK(false == c3.match(L"\U0001F600"));
+
+	auto c4 = Condition<wchar_t>(L"[жaä][^b]");
+	CHECK(true == c4.match(L"жж"));
+	CHECK(true == c4.match(L"aж"));
+	CHECK(false == c4.match(L"ab"));
+	CHECK(false == c4.match(L"бa"));
+
+	// as long as one masked comparison
+	auto c5 = Condition<wchar_t>(L"a.cd");
+	CHECK(true == c5.match_suffix(L"abcd"));
+	CHECK(true == c5.match_suffix(L"xaxcd"));
+	CHECK(false == c5.match_suffix(L"xaxce"));
+	CHECK(true == c5.match_prefix(L"abcdefgh"));
+	CHECK(false == c5.match_prefix(L"bbcdefgh"));
+	auto c6 = Condition<char>("abcdefghijklmno.");
+	CHECK(true == c6.match_suffix("abcdefghijklmnop"));
+	CHECK(true == c6.match_suffix("xabcdefghijklmnoq"));
+	CHECK(false == c6.match_suffix("xabcdefghijklmmoq"));
+
+	c5 = c4;
+	CHECK(&c5.str() == &c4.str());
+	CHECK(true == c5.match(L"äa"));
+	CHECK(false == c5.match(L"äb"));
+}
@@ -20,9 +20,15 @@
 
 #include <catch2/catch.hpp>
 
+#include <sstream>
+#include <thread>
+
 using namespace std;
 using namespace nuspell;
 
+// heap allocations of the whole test program, see allocation_counter.cxx
+auto allocation_count() -> size_t;
+
 struct Dict_Test : public nuspell::Dict_Base {
 	using Dict_Base::spell_priv;
 	auto spell_priv(std::wstring&& s) { return Dict_Base::spell_priv(s); }
@@ -110,6 +116,62 @@ TEST_CASE("Dictionary::spell_priv extra_stripping", "[dictionary]")
 	CHECK(d.spell_priv(L"31b2") == true);
 }
 
+TEST_CASE("Dict_Base::update_derived_data", "[dictionary]")
+{
+	auto d = Dict_Test();
+	d.words.emplace("drink", u"X");
+	d.suffixes.emplace(u'Y', true, L"", L"s", Flag_Set(), L".");
+	d.suffixes.emplace(u'X', true, L"", L"able", Flag_Set(u"Y"), L".");
+	CHECK(d.features() == (d.HAS_SUFFIXES | d.HAS_CONT_FLAGS));
+	d.update_derived_data();
+	CHECK(d.spell_priv(L"drinkables") == true);
+	CHECK(d.spell_priv(L"undrinkable") == false);
+
+	// the checker is selected again after the tables change
+	d.prefixes.emplace(u'U', true, L"", L"un", Flag_Set(), L".");
+	d.words.emplace("drink", u"XU");
+	d.update_derived_data();
+	CHECK(d.features() == (d.HAS_PREFIXES | d.HAS_SUFFIXES |
+	                       d.HAS_CROSS_PRODUCT | d.HAS_CONT_FLAGS));
+	CHECK(d.spell_priv(L"undrinkable") == true);
+	CHECK(d.spell_priv(L"undrinkables") == true);
+	CHECK(d.spell_priv(L"undrink") == true);
+
+	// and after the options change
+	d.compound_flag = u'Z';
+	d.words.emplace("water", u"Z");
+	d.words.emplace("proof", u"Z");
+	d.update_derived_data();
+	CHECK(d.spell_priv(L"waterproof") == true);
+
+	d.complex_prefixes = true;
+	CHECK(d.features() ==
+	      (d.HAS_PREFIXES | d.HAS_SUFFIXES | d.HAS_CROSS_PRODUCT |
+	       d.HAS_CONT_FLAGS | d.HAS_COMPLEX_PREFIXES | d.HAS_COMPOUNDING));
+}
+
+TEST_CASE("Dict_Base special flags changed after adding words",
+          "[dictionary]")
+{
+	auto d = Dict_Test();
+	d.words.emplace("table", u"F");
+	d.suffixes.emplace(u'S', true, L"", L"s", Flag_Set(u"F"), L".");
+	d.words.emplace("chair", u"S");
+	d.update_derived_data();
+	CHECK(d.spell_priv(L"table") == true);
+	CHECK(d.spell_priv(L"chairs") == true);
+
+	// the attributes of the words and affixes follow without calling
+	// update_derived_data()
+	d.compound_onlyin_flag = u'F';
+	CHECK(d.spell_priv(L"table") == false);
+	CHECK(d.spell_priv(L"chairs") == false);
+
+	d.compound_onlyin_flag = 0;
+	CHECK(d.spell_priv(L"table") == true);
+	CHECK(d.spell_priv(L"chairs") == true);
+}
+
 TEST_CASE("Dictionary::spell_priv break_pattern", "[dictionary]")
 {
 	auto d = Dict_Test();
@@ -134,6 +196,41 @@ TEST_CASE("Dictionary::spell_priv break_pattern", "[dictionary]")
 		CHECK(d.spell_priv(w) == false);
 }
 
+TEST_CASE("Dictionary::spell_priv break_pattern depth", "[dictionary]")
+{
+	auto d = Dict_Test();
+
+	d.forbiddenword_flag = 'F';
+
+	d.words.emplace("user", u"");
+	d.words.emplace("face", u"");
+	d.words.emplace("user-face", u"F");
+
+	d.break_table = {L"-", L"^-", L"-$"};
+
+	auto join = [](size_t n) {
+		auto s = std::wstring(L"user");
+		for (size_t i = 1; i != n; ++i)
+			s += L"-user";
+		return s;
+	};
+	// middle breaks go at most 9 levels deep, start and end breaks do
+	// not count
+	CHECK(d.spell_priv(join(10)) == true);
+	CHECK(d.spell_priv(join(11)) == false);
+	CHECK(d.spell_priv(L"--" + join(10) + L"--") == true);
+
+	CHECK(d.spell_priv(L"--user-face--") == true);
+	CHECK(d.spell_priv(L"user-face-user") == true);
+	CHECK(d.spell_priv(L"user-face") == false);
+	CHECK(d.spell_priv(L"-user-face") == false);
+
+	// each part is checked once, not once per path of start and end breaks
+	auto dashes = std::wstring(40, '-');
+	CHECK(d.spell_priv(dashes + L"user-userx-user" + dashes) == false);
+	CHECK(d.spell_priv(dashes + L"user-face-user" + dashes) == true);
+}
+
 TEST_CASE("Dictionary::spell_priv spell_casing_upper", "[dictionary]")
 {
 	auto d = Dict_Test();
@@ -189,6 +286,30 @@ TEST_CASE("Dictionary::spell_priv compounding compound_middle", "[dictionary]")
 		CHECK(d.spell_priv(w) == false);
 }
 
+TEST_CASE("Dictionary::spell_priv compounding many parts", "[dictionary]")
+{
+	auto d = Dict_Test();
+	d.compound_flag = 'C';
+	d.compound_min_length = 1;
+	d.words.emplace("a", u"C");
+	d.words.emplace("aa", u"C");
+	d.words.emplace("aaa", u"C");
+	d.words.emplace("b", u"C");
+
+	auto good = {L"aab", L"aaaab", L"aaaaaaab", L"babab", L"ababab"};
+	for (auto& g : good)
+		CHECK(d.spell_priv(g) == true);
+	auto wrong = {L"aac", L"abc", L"caaa"};
+	for (auto& w : wrong)
+		CHECK(d.spell_priv(w) == false);
+
+	// every split is tried, without memoization this takes forever
+	auto w = wstring(200, 'a') + L'b';
+	CHECK(d.spell_priv(w) == true);
+	w.back() = 'c';
+	CHECK(d.spell_priv(w) == false);
+}
+
 TEST_CASE("Dictionary::spell_priv compounding triple", "[dictionary]")
 {
 	auto d = Dict_Test();
@@ -636,6 +757,80 @@ TEST_CASE("Dictionary suggestions suggest_priv", "[dictionary]")
 	CHECK(words.size() == out_sug.size());
 }
 
+TEST_CASE("Dictionary suggestions ngram_suggest", "[dictionary]")
+{
+	auto d = Dict_Test();
+	d.max_ngram_suggestions = 4;
+	d.max_diff_factor = 5;
+
+	for (auto& x : {"hello", "yellow", "help", "hell", "mellow", "hollow"})
+		d.words.emplace(x, u"");
+	d.words.emplace("Helsinki", u"");
+	d.words.emplace("house", u"S");
+	d.suffixes.emplace(u'S', true, L"", L"s", u"", L".");
+
+	auto sugs = [&](wstring w) {
+		auto out_sug = List_WStrings();
+		d.suggest_priv(w, out_sug);
+		return out_sug;
+	};
+	CHECK(sugs(L"hlelo") == List_WStrings{L"hello"});
+	CHECK(sugs(L"Hlelo") == List_WStrings{L"Hello"});
+	CHECK(sugs(L"HLELO") == List_WStrings{L"HELLO"});
+	CHECK(sugs(L"hueses") == List_WStrings{L"houses"});
+	// capitalized words are not suggested for lower case words
+	CHECK(sugs(L"hlesinki").empty());
+
+	d.max_diff_factor = 10;
+	// mellow and yellow have equal scores, they are ordered by the word
+	auto expected =
+	    List_WStrings{L"hello", L"mellow", L"yellow", L"hollow"};
+	CHECK(sugs(L"helllowo") == expected);
+	d.max_ngram_suggestions = 2;
+	expected = {L"hello", L"mellow"};
+	CHECK(sugs(L"helllowo") == expected);
+	d.max_ngram_suggestions = 0;
+	CHECK(sugs(L"helllowo").empty());
+
+	d.max_ngram_suggestions = 4;
+	d.max_diff_factor = 5;
+	d.only_max_diff = true;
+	CHECK(sugs(L"hlelo").empty());
+	CHECK(sugs(L"helllowo") == List_WStrings{L"hello"});
+}
+
+TEST_CASE("Dictionary suggestions ngram_suggest word stores",
+          "[dictionary]")
+{
+	auto d = Dict_Test();
+	d.max_ngram_suggestions = 4;
+	d.max_diff_factor = 10;
+
+	for (auto& x : {"9th", "7th", "0th", "6th", "5th", "4th", "8th", "1st",
+	                "2nd", "3rd", "yellow", "mellow", "hollow", "hello"})
+		d.words.emplace(x, u"");
+	d.words.emplace("mellow", u"S");
+	d.suffixes.emplace(u'S', true, L"", L"s", u"", L".");
+
+	auto wrong = {L"1th", L"2th", L"3th", L"helllowo", L"ellowm"};
+	auto sugs = [&]() {
+		auto ret = vector<List_WStrings>();
+		for (auto& w : wrong) {
+			auto word = wstring(w);
+			ret.emplace_back();
+			d.suggest_priv(word, ret.back());
+		}
+		return ret;
+	};
+	auto expected = sugs();
+	CHECK(expected[0].at(0) == L"0th");
+	for (auto s : {Word_Store::DAWG, Word_Store::PERFECT_HASH,
+	               Word_Store::HASH_TABLE}) {
+		d.words.set_word_store(s);
+		CHECK(sugs() == expected);
+	}
+}
+
 #if 0
 TEST_CASE("suggest_priv_max", "[dictionary]")
 {
@@ -675,3 +870,661 @@ TEST_CASE("suggest_priv_max", "[dictionary]")
 	CHECK(d.words.size() == out_sug.size());
 }
 #endif
+
+TEST_CASE("Aff_Data binary save and load", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SET UTF-8\n"
+	    "TRY esianrtolcdugmphbyfvkwzESIANRTOLCDUGMPHBYFVKWZ\n"
+	    "BREAK 2\n"
+	    "^-\n"
+	    "-\n"
+	    "REP 2\n"
+	    "REP ^alot$ a_lot\n"
+	    "REP f ph\n"
+	    "COMPOUNDFLAG C\n"
+	    "SFX S Y 2\n"
+	    "SFX S 0 s [^sxzhy]\n"
+	    "SFX S y ies [^aeiou]y\n"
+	    "PFX U Y 1\n"
+	    "PFX U 0 un .\n");
+	auto dic = istringstream(
+	    "5\n"
+	    "table/S\n"
+	    "berry/SC\n"
+	    "do/U\n"
+	    "Paris\n"
+	    "black/C\n");
+	auto d1 = Dict_Test();
+	REQUIRE(d1.parse_aff_dic(aff, dic));
+
+	auto out = ostringstream();
+	REQUIRE(d1.save_binary(out));
+	auto bin = out.str();
+
+	auto d2 = Dict_Test();
+	REQUIRE(d2.load_binary(bin.data(), bin.size()));
+	CHECK(d2.words.size() == d1.words.size());
+	// the hash table is saved as a perfect hash, used in place
+	CHECK(d2.words.word_store() == Word_Store::PERFECT_HASH);
+	for (auto w : {L"table", L"tables", L"berries", L"undo", L"Paris",
+	               L"PARIS", L"blackberry", L"black-berry", L"-table",
+	               L"tabels", L"paris", L"berryblack", L"unberry"}) {
+		CHECK(d2.spell_priv(w) == d1.spell_priv(w));
+	}
+	CHECK(d2.spell_priv(L"blackberry"));
+	CHECK(d2.spell_priv(L"berries"));
+	CHECK_FALSE(d2.spell_priv(L"paris"));
+
+	auto out2 = ostringstream();
+	REQUIRE(d2.save_binary(out2));
+	CHECK(out2.str().size() == bin.size());
+
+	auto d3 = Dict_Test();
+	CHECK_FALSE(d3.load_binary(bin.data(), bin.size() - 1));
+	auto d4 = Dict_Test();
+	bin[0] = 'X';
+	CHECK_FALSE(d4.load_binary(bin.data(), bin.size()));
+}
+
+TEST_CASE("Aff_Data binary load of corrupted data", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SFX S Y 1\n"
+	    "SFX S 0 s .\n"
+	    "COMPOUNDFLAG C\n"
+	    "REP 1\n"
+	    "REP f ph\n");
+	auto dic = istringstream(
+	    "6\n"
+	    "table/S\n"
+	    "table/C\n"
+	    "black/C\n"
+	    "berry/CS\n"
+	    "Paris\n"
+	    "čaša/S\n");
+	auto d1 = Dict_Test();
+	REQUIRE(d1.parse_aff_dic(aff, dic));
+	for (auto store : {Word_Store::PERFECT_HASH, Word_Store::DAWG}) {
+		d1.words.set_word_store(store);
+		auto out = ostringstream();
+		REQUIRE(d1.save_binary(out));
+		auto bin = out.str();
+		for (size_t n = 0; n != bin.size(); ++n) {
+			auto d2 = Dict_Test();
+			CHECK_FALSE(d2.load_binary(bin.data(), n));
+		}
+		// a changed byte is either rejected or gives a dictionary
+		// that can be used, e.g. when it is in a word
+		auto rejected = size_t(0);
+		for (size_t i = 0; i != bin.size(); ++i) {
+			for (auto x : {0x01, 0x80, 0xFF}) {
+				auto bad = bin;
+				bad[i] ^= char(x);
+				auto d2 = Dict_Test();
+				if (!d2.load_binary(bad.data(), bad.size())) {
+					++rejected;
+					continue;
+				}
+				d2.update_derived_data();
+				for (auto w : {L"tables", L"blackberry",
+				               L"Paris", L"čaše", L"tabel"})
+					d2.spell_priv(w);
+			}
+		}
+		CHECK(rejected > bin.size());
+	}
+}
+
+TEST_CASE("Aff_Data parse from memory", "[dictionary]")
+{
+	auto aff = string(
+	    "\xEF\xBB\xBF"
+	    "SET UTF-8\r\n"
+	    "FLAG num\r\n"
+	    "COMPOUNDMIN 2\r\n"
+	    "SFX 1 Y 1\r\n"
+	    "SFX 1 0 s/300 . po:plural\r\n"
+	    "SFX 300 Y 1\r\n"
+	    "SFX 300 0 x .");
+	auto dic = string(
+	    "3\r\n"
+	    "table/1,70000\r\n"
+	    "chair/1\r\n"
+	    "a\\/b/300 po:noun");
+	auto d1 = Dict_Test();
+	REQUIRE(d1.parse_aff(nuspell::string_view(aff)));
+	REQUIRE(d1.parse_dic(nuspell::string_view(dic)));
+	CHECK(d1.compound_min_length == 2);
+	CHECK(d1.suffixes.size() == 2);
+	CHECK(d1.words.size() == 2);
+	CHECK(d1.spell_priv(L"chairs"));
+	CHECK(d1.spell_priv(L"a/bx"));
+	CHECK_FALSE(d1.spell_priv(L"table"));
+
+	auto aff_stream = istringstream(aff);
+	auto dic_stream = istringstream(dic);
+	auto d2 = Dict_Test();
+	REQUIRE(d2.parse_aff_dic(aff_stream, dic_stream));
+	CHECK(d2.words.size() == d1.words.size());
+	CHECK(d2.spell_priv(L"chairs"));
+}
+
+TEST_CASE("Word_List lookup with wide strings", "[dictionary]")
+{
+	auto words = Word_List();
+	words.emplace("table", u"A");
+	words.emplace("table", u"B");
+	words.emplace("čaša", u"");
+	words.emplace("日本", u"");
+	words.emplace("\U0001F600x", u"");
+
+	auto h = Word_Hash();
+	for (auto w : {"table", "čaša", "日本", "\U0001F600x", ""})
+		CHECK(h(nuspell::string_view(w)) ==
+		      h(nuspell::wstring_view(utf8_to_wide(w))));
+
+	auto r = words.equal_range(wstring(L"table"));
+	CHECK(distance(r.first, r.second) == 2);
+	r = words.equal_range(wstring(L"čaša"));
+	CHECK(distance(r.first, r.second) == 1);
+	r = words.equal_range(wstring(L"日本"));
+	CHECK(distance(r.first, r.second) == 1);
+	r = words.equal_range(wstring(L"\U0001F600x"));
+	CHECK(distance(r.first, r.second) == 1);
+	r = words.equal_range(wstring(L"čaš"));
+	CHECK(r.first == r.second);
+	r = words.equal_range(wstring(L"tablE"));
+	CHECK(r.first == r.second);
+}
+
+TEST_CASE("Word_List interns flag sets", "[dictionary]")
+{
+	auto words = Word_List();
+	words.emplace("walk", u"AB");
+	words.emplace("talk", u"BA");
+	words.emplace("talks", u"XY");
+	words.emplace("and", u"");
+	auto& pool = words.flag_set_pool();
+	CHECK(pool.size() == 3);
+
+	auto w1 = words.equal_range(nuspell::string_view("walk")).first;
+	auto w2 = words.equal_range(nuspell::string_view("talk")).first;
+	auto w3 = words.equal_range(nuspell::string_view("talks")).first;
+	auto w4 = words.equal_range(nuspell::string_view("and")).first;
+	CHECK(*w1 == *w2);
+	CHECK(*w1 != *w3);
+	CHECK(*w4 == 0);
+	CHECK(words.flags(*w1) == u"AB");
+	CHECK(words.flags(*w3) == u"XY");
+	CHECK(words.flags(*w4).empty());
+
+	CHECK(words.attributes(*w1) == 0);
+	auto sf = Special_Flags();
+	sf.forbiddenword = u'X';
+	sf.nosuggest = u'B';
+	sf.need_affix = u'Y';
+	words.flag_set_pool().set_attribute_flags(sf);
+	CHECK(words.attributes(*w1) == NO_SUGGEST_ATTR);
+	CHECK(words.attributes(*w3) == (FORBIDDEN_WORD_ATTR | NEED_AFFIX_ATTR));
+	CHECK(words.attributes(*w4) == 0);
+	words.emplace("walks", u"\uFFFF");
+	auto w5 = words.equal_range(nuspell::string_view("walks")).first;
+	CHECK(words.attributes(*w5) == HIDDEN_HOMONYM_ATTR);
+}
+
+TEST_CASE("Word_List stores words in an arena", "[dictionary]")
+{
+	auto words = make_unique<Word_List>();
+	words->emplace("table", u"A");
+	words->emplace("table", u"B");
+	words->emplace(string(1000, 'x'), u"");
+	auto t =
+	    words->table_store().equal_range(nuspell::string_view("table"));
+	REQUIRE(distance(t.first, t.second) == 2);
+	CHECK(t.first[0].data == t.first[1].data);
+
+	auto copy = *words;
+	words.reset();
+	CHECK(copy.size() == 3);
+	auto r = copy.equal_range(nuspell::string_view("table"));
+	REQUIRE(distance(r.first, r.second) == 2);
+	CHECK(copy.flags(*r.first) == u"A");
+	CHECK(copy.flags(*next(r.first)) == u"B");
+	CHECK(copy.word(*r.first) == "table");
+	r = copy.equal_range(nuspell::string_view(string(1000, 'x')));
+	CHECK(distance(r.first, r.second) == 1);
+}
+
+TEST_CASE("Word_List with DAWG store", "[dictionary]")
+{
+	auto words = Word_List();
+	words.emplace("walks", u"A");
+	words.emplace("walk", u"B");
+	words.emplace("talks", u"C");
+	words.emplace("walk", u"D");
+	words.emplace("čaša", u"");
+	words.emplace("", u"E");
+	words.set_word_store(Word_Store::DAWG);
+	REQUIRE(words.word_store() == Word_Store::DAWG);
+	CHECK(words.size() == 6);
+	auto& dawg = words.dawg_store();
+
+	auto r = words.equal_range(nuspell::string_view("walk"));
+	REQUIRE(distance(r.first, r.second) == 2);
+	CHECK(words.flags(*r.first) == u"B");
+	CHECK(words.flags(*next(r.first)) == u"D");
+	CHECK(words.word(*r.first) == "walk");
+	r = words.equal_range(wstring(L"čaša"));
+	REQUIRE(distance(r.first, r.second) == 1);
+	CHECK(words.word(*r.first) == "čaša");
+	r = words.equal_range(wstring(L"talks"));
+	REQUIRE(distance(r.first, r.second) == 1);
+	CHECK(words.flags(*r.first) == u"C");
+	r = words.equal_range(nuspell::string_view(""));
+	CHECK(distance(r.first, r.second) == 1);
+	r = words.equal_range(wstring(L"wal"));
+	CHECK(r.first == r.second);
+	r = words.equal_range(nuspell::string_view("walkss"));
+	CHECK(r.first == r.second);
+
+	auto all = vector<string>();
+	words.for_each([&](auto w, auto&) { all.emplace_back(w); });
+	CHECK(all == vector<string>{"", "talks", "walk", "walk", "walks",
+	                            "čaša"});
+	auto with_prefix = vector<string>();
+	dawg.for_each_with_prefix("wa", [&](auto w, auto first, auto last) {
+		with_prefix.emplace_back(w);
+		CHECK(words.equal_range(w).first == first);
+		CHECK(words.equal_range(w).second == last);
+	});
+	CHECK(with_prefix == vector<string>{"walk", "walks"});
+	for (size_t i = 0; i != dawg.size(); ++i)
+		CHECK(dawg.word_at(i) == all[i]);
+	auto part = vector<string>();
+	words.for_each_in_slots(2, 5,
+	                        [&](auto w, auto&) { part.emplace_back(w); });
+	CHECK(part == vector<string>{"walk", "walk", "walks"});
+
+	// words that differ only in the first letter share the rest
+	auto w = vector<pair<nuspell::string_view, Word_Dawg::Handle>>{
+	    {"talks", 1}, {"walks", 2}};
+	CHECK(Word_Dawg(w).state_count() == 6);
+
+	words.emplace("talk", u"F");
+	CHECK(words.word_store() == Word_Store::HASH_TABLE);
+	CHECK(words.size() == 7);
+	r = words.equal_range(nuspell::string_view("walk"));
+	REQUIRE(distance(r.first, r.second) == 2);
+	CHECK(words.flags(*next(r.first)) == u"D");
+}
+
+TEST_CASE("Word_List with perfect hash store", "[dictionary]")
+{
+	auto words = Word_List();
+	words.emplace("walks", u"A");
+	words.emplace("walk", u"B");
+	words.emplace("talks", u"C");
+	words.emplace("walk", u"D");
+	words.emplace("čaša", u"");
+	words.emplace("", u"E");
+	for (int i = 0; i != 1000; ++i)
+		words.emplace("w" + to_string(i), u"F");
+	words.set_word_store(Word_Store::PERFECT_HASH);
+	REQUIRE(words.word_store() == Word_Store::PERFECT_HASH);
+	CHECK(words.size() == 1006);
+	auto& ph = words.perfect_hash_store();
+	CHECK(ph.word_count() == 1005);
+	CHECK(ph.pilot_data().size() < ph.word_count() / 2);
+
+	auto r = words.equal_range(nuspell::string_view("walk"));
+	REQUIRE(distance(r.first, r.second) == 2);
+	CHECK(words.flags(*r.first) == u"B");
+	CHECK(words.flags(*next(r.first)) == u"D");
+	CHECK(words.word(*next(r.first)) == "walk");
+	r = words.equal_range(wstring(L"čaša"));
+	REQUIRE(distance(r.first, r.second) == 1);
+	CHECK(words.word(*r.first) == "čaša");
+	r = words.equal_range(nuspell::string_view(""));
+	CHECK(distance(r.first, r.second) == 1);
+	r = words.equal_range(wstring(L"wal"));
+	CHECK(r.first == r.second);
+	for (int i = 0; i != 1000; ++i) {
+		auto w = "w" + to_string(i);
+		r = words.equal_range(nuspell::string_view(w));
+		REQUIRE(distance(r.first, r.second) == 1);
+		CHECK(words.word(*r.first) == w);
+	}
+	auto n = size_t(0);
+	words.for_each([&](auto w, auto& h) {
+		CHECK(words.word(h) == w);
+		++n;
+	});
+	CHECK(n == 1006);
+
+	// the pilots are enough to build it again from the words in order
+	auto entries =
+	    vector<pair<nuspell::string_view, Word_Perfect_Hash::Handle>>();
+	words.for_each([&](auto w, auto& h) { entries.emplace_back(w, h); });
+	auto ph2 = Word_Perfect_Hash();
+	CHECK(ph2.build(entries, ph.pilot_data()));
+	CHECK(ph2.word_count() == 1005);
+	swap(entries[0], entries.back());
+	CHECK_FALSE(ph2.build(entries, ph.pilot_data()));
+
+	words.set_word_store(Word_Store::DAWG);
+	CHECK(words.size() == 1006);
+	words.set_word_store(Word_Store::PERFECT_HASH);
+	words.emplace("talk", u"G");
+	CHECK(words.word_store() == Word_Store::HASH_TABLE);
+	CHECK(words.size() == 1007);
+	r = words.equal_range(nuspell::string_view("walk"));
+	REQUIRE(distance(r.first, r.second) == 2);
+	CHECK(words.flags(*next(r.first)) == u"D");
+}
+
+TEST_CASE("Aff_Data binary save and load with perfect hash", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SFX S Y 1\n"
+	    "SFX S 0 s .\n"
+	    "COMPOUNDFLAG C\n");
+	auto dic = istringstream(
+	    "4\n"
+	    "table/S\n"
+	    "black/C\n"
+	    "berry/C\n"
+	    "Paris\n");
+	auto d1 = Dict_Test();
+	REQUIRE(d1.parse_aff_dic(aff, dic));
+	d1.words.set_word_store(Word_Store::PERFECT_HASH);
+	auto out = ostringstream();
+	REQUIRE(d1.save_binary(out));
+	auto bin = out.str();
+
+	auto d2 = Dict_Test();
+	REQUIRE(d2.load_binary(bin.data(), bin.size()));
+	REQUIRE(d2.words.word_store() == Word_Store::PERFECT_HASH);
+	CHECK(d2.words.perfect_hash_store().pilot_data() ==
+	      d1.words.perfect_hash_store().pilot_data());
+	for (auto w : {L"table", L"tables", L"blackberry", L"Paris", L"PARIS",
+	               L"paris", L"tabels", L"berryblack"}) {
+		CHECK(d2.spell_priv(w) == d1.spell_priv(w));
+	}
+	CHECK(d2.spell_priv(L"tables"));
+	CHECK(d2.spell_priv(L"blackberry"));
+}
+
+TEST_CASE("Aff_Data binary save and load with DAWG", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SFX S Y 1\n"
+	    "SFX S 0 s .\n"
+	    "COMPOUNDFLAG C\n");
+	auto dic = istringstream(
+	    "5\n"
+	    "table/S\n"
+	    "table/C\n"
+	    "black/C\n"
+	    "berry/C\n"
+	    "Paris\n");
+	auto d1 = Dict_Test();
+	REQUIRE(d1.parse_aff_dic(aff, dic));
+	d1.words.set_word_store(Word_Store::DAWG);
+	auto out = ostringstream();
+	REQUIRE(d1.save_binary(out));
+	auto bin = out.str();
+
+	auto d2 = Dict_Test();
+	REQUIRE(d2.load_binary(bin.data(), bin.size()));
+	REQUIRE(d2.words.word_store() == Word_Store::DAWG);
+	CHECK(d2.words.size() == 5);
+	CHECK(d2.words.dawg_store().state_count() ==
+	      d1.words.dawg_store().state_count());
+	for (auto w : {L"table", L"tables", L"blackberry", L"tableberry",
+	               L"Paris", L"paris", L"tabels", L"berryblack"}) {
+		CHECK(d2.spell_priv(w) == d1.spell_priv(w));
+	}
+	CHECK(d2.spell_priv(L"tableberry"));
+
+	// a copy of the data, not aligned, is loaded too
+	auto unaligned = "x" + bin;
+	auto d3 = Dict_Test();
+	REQUIRE(d3.load_binary(unaligned.data() + 1, bin.size()));
+	CHECK(d3.spell_priv(L"tables"));
+
+	d2.words.emplace("chair", u"S");
+	CHECK(d2.words.word_store() == Word_Store::HASH_TABLE);
+	CHECK(d2.spell_priv(L"chairs"));
+	CHECK(d2.spell_priv(L"blackberry"));
+}
+
+TEST_CASE("Dictionary with DAWG store", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SFX S Y 1\n"
+	    "SFX S 0 s .\n"
+	    "FORBIDDENWORD F\n"
+	    "COMPOUNDFLAG C\n");
+	auto dic = istringstream(
+	    "5\n"
+	    "table/S\n"
+	    "chair/SC\n"
+	    "man/C\n"
+	    "tables/F\n"
+	    "Paris\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	d.set_word_store(Word_Store::DAWG);
+	CHECK(d.spell("table"));
+	CHECK(d.spell("chairs"));
+	CHECK(d.spell("chairman"));
+	CHECK(d.spell("PARIS"));
+	CHECK_FALSE(d.spell("tables"));
+	CHECK_FALSE(d.spell("paris"));
+	auto sugs = vector<string>();
+	d.suggest("tabel", sugs);
+	CHECK(find(begin(sugs), end(sugs), "table") != end(sugs));
+}
+
+TEST_CASE("Dictionary::spell_batch", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SFX S Y 1\n"
+	    "SFX S 0 s .\n"
+	    "SFX Y Y 2\n"
+	    "SFX Y y ies [^aeiou]y\n"
+	    "SFX Y 0 s [aeiou]y\n"
+	    "COMPOUNDFLAG C\n");
+	auto dic = istringstream(
+	    "4\n"
+	    "table/S\n"
+	    "black/C\n"
+	    "berry/CY\n"
+	    "day/Y\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = vector<string>{"table", "tables", "Table",
+	                            "TABLES", "tabel", "blackberry",
+	                            "",      "berries", string(200, 'a'),
+	                            "berry", "berryblack", "days",
+	                            "daies", "Berries", "blackberries",
+	                            "berrys", "day.", "tables..."};
+	auto views = vector<nuspell::string_view>(begin(words), end(words));
+	auto out = unique_ptr<bool[]>(new bool[words.size()]);
+	auto check_all = [&] {
+		fill_n(out.get(), words.size(), false);
+		d.spell_batch(views, {out.get(), words.size()});
+		for (size_t i = 0; i != words.size(); ++i)
+			CHECK(out[i] == d.spell(words[i]));
+	};
+	check_all();
+	CHECK(out[0]);
+	CHECK(out[5]);
+	CHECK(out[7]);
+	CHECK_FALSE(out[4]);
+	CHECK_FALSE(out[8]);
+	CHECK_FALSE(out[12]);
+
+	d.enable_expanded_forms();
+	check_all();
+	d.disable_expanded_forms();
+	d.set_word_store(Word_Store::PERFECT_HASH);
+	check_all();
+	d.set_word_store(Word_Store::DAWG);
+	check_all();
+
+	out[0] = false;
+	d.spell_batch(views, {out.get(), 1});
+	CHECK(out[0]);
+	d.spell_batch({}, {});
+}
+
+TEST_CASE("Dictionary cache", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SFX S Y 1\n"
+	    "SFX S 0 s .\n"
+	    "TRY abelt\n");
+	auto dic = istringstream(
+	    "2\n"
+	    "table/S\n"
+	    "label\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = vector<string>{"table", "tables", "Table", "tabel",
+	                            "lable", "label",  "labels"};
+	auto expected = vector<bool>();
+	auto expected_sugs = vector<vector<string>>();
+	auto sugs = vector<string>();
+	for (auto& w : words) {
+		expected.push_back(d.spell(w));
+		d.suggest(w, sugs);
+		expected_sugs.push_back(sugs);
+	}
+	CHECK(d.cache_stats().spell_misses == 0);
+
+	d.enable_cache(100);
+	for (int k = 0; k != 3; ++k) {
+		for (size_t i = 0; i != words.size(); ++i) {
+			CHECK(d.spell(words[i]) == expected[i]);
+			d.suggest(words[i], sugs);
+			CHECK(sugs == expected_sugs[i]);
+		}
+	}
+	auto stats = d.cache_stats();
+	CHECK(stats.spell_misses == words.size());
+	CHECK(stats.spell_hits == 2 * words.size());
+	CHECK(stats.suggest_misses == words.size());
+	CHECK(stats.suggest_hits == 2 * words.size());
+
+	auto threads = vector<thread>();
+	auto results = vector<int>(4);
+	for (size_t t = 0; t != results.size(); ++t) {
+		threads.emplace_back([&, t] {
+			for (int k = 0; k != 100; ++k)
+				for (size_t i = 0; i != words.size(); ++i)
+					results[t] +=
+					    d.spell(words[i]) == expected[i];
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	for (auto r : results)
+		CHECK(r == 100 * int(words.size()));
+
+	d.disable_cache();
+	CHECK(d.cache_stats().spell_hits == 0);
+	CHECK(d.spell("tables"));
+}
+
+TEST_CASE("Dictionary with expanded forms", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "PFX U Y 1\n"
+	    "PFX U 0 un .\n"
+	    "SFX S Y 1\n"
+	    "SFX S 0 s .\n"
+	    "SFX D Y 2\n"
+	    "SFX D y ied [^aeiou]y\n"
+	    "SFX D 0 ed [^y]\n"
+	    "FORBIDDENWORD F\n"
+	    "KEEPCASE K\n"
+	    "COMPOUNDFLAG C\n");
+	auto dic = istringstream(
+	    "6\n"
+	    "lock/USD\n"
+	    "carry/D\n"
+	    "key/SC\n"
+	    "board/C\n"
+	    "unlocks/F\n"
+	    "iPod/K\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = vector<string>{
+	    "lock",    "locks",    "locked",   "unlock",  "unlocked",
+	    "unlocks", "carried",  "carryed",  "keys",    "keyboard",
+	    "UNLOCK",  "Unlocked", "iPod",     "IPOD",    "ipod",
+	    "unkey",   "lockeds",  "keyboards"};
+	auto expected = vector<bool>();
+	for (auto& w : words)
+		expected.push_back(d.spell(w));
+	d.enable_expanded_forms();
+	for (size_t i = 0; i != words.size(); ++i)
+		CHECK(d.spell(words[i]) == expected[i]);
+	CHECK(d.spell("unlocked"));
+	CHECK(d.spell("carried"));
+	CHECK(d.spell("keyboard"));
+	CHECK_FALSE(d.spell("unlocks"));
+	CHECK_FALSE(d.spell("IPOD"));
+	d.disable_expanded_forms();
+	for (size_t i = 0; i != words.size(); ++i)
+		CHECK(d.spell(words[i]) == expected[i]);
+}
+
+TEST_CASE("Dictionary::spell does not allocate", "[dictionary]")
+{
+	auto aff = istringstream(
+	    "SET UTF-8\n"
+	    "BREAK 1\n"
+	    "BREAK -\n"
+	    "KEEPCASE K\n"
+	    "COMPOUNDFLAG C\n"
+	    "COMPOUNDMIN 2\n"
+	    "PFX U Y 1\n"
+	    "PFX U 0 un .\n"
+	    "SFX S Y 2\n"
+	    "SFX S 0 s [^y]\n"
+	    "SFX S y ies y\n");
+	auto dic = istringstream(
+	    "7\n"
+	    "table/S\n"
+	    "berry/SC\n"
+	    "black/C\n"
+	    "do/U\n"
+	    "Paris\n"
+	    "Sant'Elia\n"
+	    "iPod/K\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = vector<string>{
+	    "table",       "Tables",     "TABLES",      "berries",
+	    "undo",        "UNDO",       "blackberry",  "Blackberries",
+	    "BLACKBERRY",  "black-berry", "table-do-berry", "Paris",
+	    "PARIS",       "paris",       "SANT'ELIA",   "iPod",
+	    "IPOD",        "tabel",       "blackbery",   "čaša",
+	    "ČAŠA",        "Čaša",        "1234",        "table.",
+	    string(60, 'a')};
+	auto expected = vector<bool>();
+	for (auto& w : words)
+		expected.push_back(d.spell(w));
+	CHECK(expected[6]);
+	CHECK(expected[9]);
+	CHECK(expected[14]);
+
+	auto results = vector<bool>();
+	results.reserve(words.size() * 3);
+	auto before = allocation_count();
+	for (int k = 0; k != 3; ++k)
+		for (auto& w : words)
+			results.push_back(d.spell(w));
+	auto allocations = allocation_count() - before;
+	CHECK(allocations == 0);
+	for (size_t i = 0; i != results.size(); ++i)
+		CHECK(results[i] == expected[i % words.size()]);
+}
@@ -31,7 +31,37 @@ TEST_CASE("validate_utf8", "[locale_utils]")
 	CHECK(validate_utf8(""));
 	CHECK(validate_utf8("the brown fox~"));
 	CHECK(validate_utf8("Ӥ日本に"));
-	// need counter example too
+	CHECK(validate_utf8("the quick brown fox jumps over the lazy dog Ӥ"));
+	CHECK_FALSE(
+	    validate_utf8("the quick brown fox jumps\xFF over the dog"));
+	CHECK_FALSE(
+	    validate_utf8("the quick brown fox jumps over the dog\xC3"));
+	CHECK_FALSE(
+	    validate_utf8("\xC3the quick brown fox jumps over the dog"));
+	CHECK_FALSE(validate_utf8("\xC0\x80"));
+	CHECK_FALSE(validate_utf8("\xE0\x80\x80"));
+	CHECK_FALSE(validate_utf8("\xED\xA0\x80"));
+}
+
+TEST_CASE("utf8_to_wide and wide_to_utf8", "[locale_utils]")
+{
+	auto ascii = string("The quick brown fox jumps over the lazy dog.");
+	auto wide = wstring(begin(ascii), end(ascii));
+	for (size_t i = 0; i != ascii.size(); ++i) {
+		auto in = ascii;
+		in.insert(i, "ßӤ日\U0010FFFF");
+		auto exp = wide;
+		exp.insert(i, L"ßӤ日\U0010FFFF");
+		auto out = wstring();
+		CHECK(utf8_to_wide(in, out));
+		CHECK(exp == out);
+		CHECK(in == wide_to_utf8(exp));
+	}
+	CHECK(wide == utf8_to_wide(ascii));
+	CHECK(ascii == wide_to_utf8(wide));
+	auto out = wstring();
+	CHECK_FALSE(utf8_to_wide(ascii + "\xFF" + ascii, out));
+	CHECK(wide + wide == out);
 }
 
 TEST_CASE("is_ascii", "[locale_utils]")
@@ -155,6 +185,25 @@ TEST_CASE("classify_casing", "[locale_utils]")
 	CHECK(Casing::PASCAL == classify_casing(L"InitCamelCase"));
 	CHECK(Casing::PASCAL == classify_casing(L"InitCamelCase "));
 	CHECK(Casing::INIT_CAPITAL == classify_casing(L"İstanbul"));
+	CHECK(Casing::INIT_CAPITAL == classify_casing(L"Ελλάδα"));
+	CHECK(Casing::ALL_CAPITAL == classify_casing(L"МОСКВА"));
+	CHECK(Casing::CAMEL == classify_casing(L"\U0001D41Aa\U0001D400"));
+
+	auto counts = Casing_Counts();
+	CHECK(Casing::CAMEL ==
+	      classify_casing(L"the_quick-brown@Fox`", counts));
+	CHECK(counts.upper == 1);
+	CHECK(counts.lower == 15);
+	CHECK(counts.first_capital == 16);
+	CHECK(Casing::PASCAL ==
+	      classify_casing(L"IJsselmeer{en}[Zuiderzee]Grüße", counts));
+	CHECK(counts.upper == 4);
+	CHECK(counts.lower == 22);
+	CHECK(counts.first_capital == 0);
+	CHECK(Casing::SMALL == classify_casing(L"1234", counts));
+	CHECK(counts.upper == 0);
+	CHECK(counts.lower == 0);
+	CHECK(counts.first_capital == wstring::npos);
 }
 
 TEST_CASE("to_upper", "[locale_utils]")
@@ -321,6 +370,51 @@ TEST_CASE("to_title", "[locale_utils]")
 	CHECK(L"Ĳsselmeer" == to_title(L"ĲSSELMEER", l));
 }
 
+auto icu_case_map(nuspell::wstring_view in, const icu::Locale& loc, char c)
+    -> wstring
+{
+	auto s = icu::UnicodeString::fromUTF32(
+	    reinterpret_cast<const UChar32*>(in.data()), in.size());
+	if (c == 'u')
+		s.toUpper(loc);
+	else if (c == 'l')
+		s.toLower(loc);
+	else
+		s.toTitle(nullptr, loc);
+	auto out = wstring(s.length(), L'\0');
+	auto err = U_ZERO_ERROR;
+	auto len = s.toUTF32(reinterpret_cast<UChar32*>(&out[0]), out.size(),
+	                     err);
+	out.resize(len);
+	return out;
+}
+
+TEST_CASE("case mapping of table matches ICU", "[locale_utils]")
+{
+	auto l = icu::Locale("en_US");
+	auto out = wstring();
+	for (wchar_t c = 1; c != 0x2000; ++c) {
+		if (U_IS_SURROGATE(c))
+			continue;
+		for (auto w : {wstring{c}, wstring{c, L'a'}, wstring{L'A', c},
+		               wstring{c, c, c}}) {
+			to_upper(w, l, out);
+			if (out != icu_case_map(w, l, 'u'))
+				FAIL_CHECK("to_upper of U+" << hex << int(c));
+			to_lower(w, l, out);
+			if (out != icu_case_map(w, l, 'l'))
+				FAIL_CHECK("to_lower of U+" << hex << int(c));
+			to_title(w, l, out);
+			if (out != icu_case_map(w, l, 't'))
+				FAIL_CHECK("to_title of U+" << hex << int(c));
+		}
+	}
+	CHECK(L"ΣΊΓΜΑ" == to_upper(L"σίγμας", l).substr(0, 5));
+	CHECK(L"σίγμας" == to_lower(L"ΣΊΓΜΑΣ", l));
+	CHECK(L"STRASSE" == to_upper(L"straße", l));
+	CHECK(L"Москва" == to_title(L"МОСКВА", l));
+}
+
 TEST_CASE("Encoding", "[locale_utils]")
 {
 	auto e = Encoding();
@@ -97,6 +97,54 @@ TEST_CASE("Suffix", "[structures]")
 	CHECK(false == sfx_tests.check_condition("wries"));
 }
 
+TEST_CASE("Affix_Table", "[structures]")
+{
+	auto t = Suffix_Table<wchar_t>();
+	t.emplace(u'A', true, L"", L"s", u"", L".");
+	t.emplace(u'B', true, L"", L"", u"", L".");
+	t.emplace(u'C', true, L"y", L"ies", u"", L".");
+	t.emplace(u'D', true, L"", L"es", u"", L".");
+	t.emplace(u'E', true, L"", L"s", u"X", L".");
+	CHECK(t.size() == 5);
+	CHECK(t.has_continuation_flag(u'X'));
+
+	auto r = t.equal_range(L"s");
+	REQUIRE(distance(r.first, r.second) == 2);
+	CHECK(r.first->flag == u'A');
+	CHECK((++r.first)->flag == u'E');
+	r = t.equal_range(L"ies");
+	REQUIRE(distance(r.first, r.second) == 1);
+	CHECK(r.first->flag == u'C');
+	r = t.equal_range(L"ie");
+	CHECK(r.first == r.second);
+
+	// walk from the end of "berries", all entries that are suffixes
+	auto word = wstring(L"berries");
+	auto flags = u16string();
+	auto node = t.trie_root();
+	for (size_t i = 0;; ++i) {
+		for (auto& e : boost::make_iterator_range(t.trie_entries(node)))
+			flags += e.flag;
+		if (i == word.size())
+			break;
+		node = t.trie_child(node, word[word.size() - 1 - i]);
+		if (node == t.trie_root())
+			break;
+	}
+	CHECK(flags == u"BAEDC");
+
+	// entries with equal conditions share them
+	t.emplace(u'F', true, L"", L"t", u"", L"[^y]");
+	t.emplace(u'G', true, L"", L"u", u"", L"[^y]");
+	auto f = t.equal_range(L"t").first;
+	auto g = t.equal_range(L"u").first;
+	CHECK(&f->condition.str() == &g->condition.str());
+	auto a = t.equal_range(L"s").first;
+	auto c = t.equal_range(L"ies").first;
+	CHECK(&f->condition.str() != &a->condition.str());
+	CHECK(&a->condition.str() == &c->condition.str());
+}
+
 TEST_CASE("String_Set::String_Set", "[structures]")
 {
 	auto ss1 = String_Set<char16_t>();
@@ -247,6 +295,63 @@ TEST_CASE("Break_Table", "[structures]")
 	a = d;
 }
 
+TEST_CASE("Hash_Multiset", "[structures]")
+{
+	using Pair = pair<string, int>;
+	auto m = Hash_Multiset<Pair, string, member<Pair, string, &Pair::first>,
+	                       hash<string>>();
+	CHECK(m.empty());
+	auto r = m.equal_range(string("a"));
+	CHECK(r.first == r.second);
+
+	// many homonyms, inserted interleaved with other keys and rehashes
+	for (int i = 0; i != 1000; ++i) {
+		m.emplace(to_string(i % 100), i);
+		m.emplace("x" + to_string(i), i);
+	}
+	CHECK(m.size() == 2000);
+	for (int k = 0; k != 100; ++k) {
+		r = m.equal_range(to_string(k));
+		REQUIRE(distance(r.first, r.second) == 10);
+		auto expected = k;
+		for (auto& x : boost::make_iterator_range(r)) {
+			CHECK(x.first == to_string(k));
+			CHECK(x.second == expected); // insertion order is kept
+			expected += 100;
+		}
+	}
+	for (int i = 0; i != 1000; ++i) {
+		r = m.equal_range("x" + to_string(i));
+		REQUIRE(distance(r.first, r.second) == 1);
+		CHECK(r.first->second == i);
+	}
+	r = m.equal_range(string("100"));
+	CHECK(r.first == r.second);
+
+	auto cnt = size_t(0);
+	m.for_each([&](auto&) { ++cnt; });
+	CHECK(cnt == m.size());
+}
+
+TEST_CASE("Hash_Multiset long run at the end", "[structures]")
+{
+	// every key lands in the last home slot
+	struct Last_Slot_Hash {
+		auto operator()(int) const { return size_t(-1); }
+	};
+	auto m = Hash_Multiset<int, int, identity, Last_Slot_Hash>();
+	for (int i = 0; i != 200; ++i)
+		m.insert(7);
+	m.insert(8);
+	CHECK(m.size() == 201);
+	// grows only with the load factor, not with the length of the run
+	CHECK(m.bucket_count() <= 256);
+	auto r = m.equal_range(7);
+	CHECK(distance(r.first, r.second) == 200);
+	r = m.equal_range(8);
+	CHECK(distance(r.first, r.second) == 1);
+}
+
 TEST_CASE("String_Pair", "[structures]")
 {
 	auto x = String_Pair<char>();
@@ -356,6 +461,62 @@ TEST_CASE("Similarity_Group", "[structures]")
 	CHECK(v == s1.strings);
 }
 
+TEST_CASE("Compound_Rule_Table", "[structures]")
+{
+	auto t = Compound_Rule_Table();
+	t = vector<u16string>{u"ab?c", u"d*e"};
+	auto a = Flag_Set(u"a");
+	auto b = Flag_Set(u"b");
+	auto c = Flag_Set(u"c");
+	auto d = Flag_Set(u"d");
+	auto e = Flag_Set(u"ae");
+	auto x = Flag_Set(u"x");
+
+	CHECK(t.match_any_rule({&a, &c}));
+	CHECK(t.match_any_rule({&a, &b, &c}));
+	CHECK(t.match_any_rule({&e}));
+	CHECK(t.match_any_rule({&e, &c}));
+	CHECK(t.match_any_rule({&d, &d, &d, &e}));
+	CHECK_FALSE(t.match_any_rule({}));
+	CHECK_FALSE(t.match_any_rule({&a, &b, &b, &c}));
+	CHECK_FALSE(t.match_any_rule({&d, &d}));
+	CHECK_FALSE(t.match_any_rule({&d, &e, &e}));
+
+	auto s1 = t.start_state();
+	auto s2 = Compound_Rule_Table::State();
+	CHECK(t.advance(s1, d, s2));
+	CHECK_FALSE(t.is_accepting(s2));
+	CHECK(t.advance(s2, d, s1));
+	CHECK(t.advance(s1, e, s2));
+	CHECK(t.is_accepting(s2));
+	CHECK_FALSE(t.advance(s2, x, s1));
+	CHECK_FALSE(t.advance(t.start_state(), c, s1));
+}
+
+TEST_CASE("Sharded_Lru_Cache", "[structures]")
+{
+	Sharded_Lru_Cache<string, int> c(2, 1);
+	auto x = 0;
+	CHECK_FALSE(c.find("a", x));
+	c.insert("a", 1);
+	c.insert("b", 2);
+	CHECK(c.find("a", x));
+	CHECK(x == 1);
+	c.insert("c", 3); // evicts b, a was used more recently
+	CHECK(c.size() == 2);
+	CHECK_FALSE(c.find("b", x));
+	CHECK(c.find("c", x));
+	CHECK(x == 3);
+	c.insert("a", 4);
+	CHECK(c.find("a", x));
+	CHECK(x == 4);
+	CHECK(c.hits() == 3);
+	CHECK(c.misses() == 2);
+	c.clear();
+	CHECK(c.size() == 0);
+	CHECK_FALSE(c.find("a", x));
+}
+
 TEST_CASE("List_Strings", "[structures]")
 {
 	auto l = List_Strings();